@@ -827,6 +827,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include "dimacs.h"
 
 /******************************************************************************
  * DPLL SAT Solver for Part 1
@@ -1093,14 +1094,10 @@ static int checkAllClauses(void) {
  * main
  ******************************************************************************/
 int main(int argc, char **argv) {
-    // Skip comment lines
-    for (char c; (c = getc(stdin)) == 'c'; ) {
-        while (getc(stdin) != '\n');
-    }
-
-    // read p cnf
-    assert(scanf(" cnf %u %u\n", &N_VARS, &N_CLAUSES) == 2);
-    N_VARS++;
+    dimacs_t dimacs;
+    if (!dimacs_read(&dimacs, NULL)) return 1;
+    N_VARS = dimacs.n_vars + 1;
+    N_CLAUSES = dimacs.n_clauses;
 
     // allocate
     ASSIGNMENT     = malloc(N_VARS * sizeof(*ASSIGNMENT));
@@ -1112,64 +1109,42 @@ int main(int argc, char **argv) {
         ASSIGNMENT[i] = UNASSIGNED;
     }
 
-    // read clauses
+    // read clauses: each one is its slice of the parser's literals with
+    // duplicates squeezed out in place
     for (unsigned i = 0; i < N_CLAUSES; i++) {
-        // parse until '0'
-        int L;
-        int arrayCap = 8;
-        int arrayLen = 0;
-        int *temp = malloc(arrayCap * sizeof(int));
-
-        while (1) {
-            assert(scanf("%d", &L) == 1);
-            if (!L) break;
+        int n;
+        int *lits = dimacs_clause(&dimacs, i, &n);
+        CLAUSES[i].literals   = lits;
+        CLAUSES[i].n_literals = 0;
+        CLAUSES[i].n_zeros    = 0;   // nothing is assigned yet
 
+        for (int k = 0; k < n; k++) {
             // skip duplicates
             int repeat = 0;
-            for (int x = 0; x < arrayLen && !repeat; x++) {
-                if (temp[x] == L) {
+            for (int x = 0; x < CLAUSES[i].n_literals && !repeat; x++) {
+                if (lits[x] == lits[k]) {
                     repeat = 1;
                 }
             }
             if (repeat) continue;
 
-            if (arrayLen == arrayCap) {
-                arrayCap *= 2;
-                temp = realloc(temp, arrayCap * sizeof(int));
-            }
-            temp[arrayLen++] = L;
-        }
-
-        // store in CLAUSES[i]
-        CLAUSES[i].literals   = malloc(arrayLen * sizeof(int));
-        CLAUSES[i].n_literals = arrayLen;
-        CLAUSES[i].n_zeros    = 0;
-
-        for (int j = 0; j < arrayLen; j++) {
-            CLAUSES[i].literals[j] = temp[j];
-        }
-        free(temp);
-
-        // populate LIT_TO_CLAUSES
-        for (int j = 0; j < arrayLen; j++) {
-            int idx = literal_to_id(CLAUSES[i].literals[j]);
-            struct clause_list *cl = &LIT_TO_CLAUSES[idx];
-            cl->clauses = realloc(cl->clauses, (cl->n_clauses+1)*sizeof(struct clause*));
-            cl->clauses[cl->n_clauses] = &CLAUSES[i];
-            cl->n_clauses++;
+            lits[CLAUSES[i].n_literals++] = lits[k];
+            LIT_TO_CLAUSES[literal_to_id(lits[k])].n_clauses++;
         }
+    }
 
-        // compute initial n_zeros
-        for (int j = 0; j < arrayLen; j++) {
-            int var = (CLAUSES[i].literals[j] < 0) ? -CLAUSES[i].literals[j] : CLAUSES[i].literals[j];
-            if (ASSIGNMENT[var] != UNASSIGNED) {
-                // if sign mismatch => increment n_zeros
-                int assignedVal = (ASSIGNMENT[var] == TRUE) ? 1 : 0;
-                int wantVal     = (CLAUSES[i].literals[j] > 0) ? 1 : 0;
-                if (assignedVal != wantVal) {
-                    CLAUSES[i].n_zeros++;
-                }
-            }
+    // populate LIT_TO_CLAUSES: size every list from the counts above and
+    // hand out slices of a single array
+    struct clause **occurs = malloc((dimacs.n_lits + 1) * sizeof(struct clause*));
+    for (unsigned idx = 0; idx < 2*N_VARS; idx++) {
+        LIT_TO_CLAUSES[idx].clauses = occurs;
+        occurs += LIT_TO_CLAUSES[idx].n_clauses;
+        LIT_TO_CLAUSES[idx].n_clauses = 0;
+    }
+    for (unsigned i = 0; i < N_CLAUSES; i++) {
+        for (int j = 0; j < CLAUSES[i].n_literals; j++) {
+            struct clause_list *cl = &LIT_TO_CLAUSES[literal_to_id(CLAUSES[i].literals[j])];
+            cl->clauses[cl->n_clauses++] = &CLAUSES[i];
         }
     }
 
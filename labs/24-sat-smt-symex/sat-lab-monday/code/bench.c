@@ -0,0 +1,484 @@
+/**********************************************************
+ * Benchmark driver for the SAT solvers in this directory
+ *
+ *      ./bench [options] [files or dirs...] [-- solver args...]
+ *
+ * Runs the solver on every instance (default: everything in
+ * ../test_inputs), each one -repeat times, each run killed after
+ * -timeout seconds. A SAT answer's model is checked against the CNF.
+ * Anything the solver prints to stderr as "c <name> <value>" (cdcl -s)
+ * is picked up: conflicts, decisions, propagations, props_per_sec and
+ * the parse/preprocess/solve times. Wall time is the median over the
+ * repeats; peak RSS comes from wait4().
+ *
+ * Options:
+ *      -solver=PATH     solver binary (default ./cdcl)
+ *      -timeout=SEC     per-run wall-clock limit (default 60)
+ *      -repeat=N        runs per instance (default 3)
+ *      -csv=FILE        write the results as CSV
+ *      -json=FILE       write the results as JSON
+ *      -baseline=FILE   compare against a CSV from an earlier run
+ *      -slowdown=PCT    flag instances this much slower (default 10)
+ *      -noise=SEC       ... and slower by at least this much (default 0.05)
+ *
+ * Exits 1 if a model was wrong, an answer changed from the baseline's, a
+ * run crashed, or an instance got slower than the baseline allows.
+ *
+ *  e.g.
+ *      make bench-cdcl                     # writes bench.csv
+ *      cp bench.csv bench_baseline.csv     # after a good run
+ *      ... change cdcl.c ...
+ *      make bench-cdcl                     # diffs against the baseline
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "dimacs.h"
+
+typedef struct {
+    char name[256];         // basename; what the baseline is keyed on
+    char status[16];        // SAT, UNSAT, TIMEOUT, CRASH, ?
+    int verified;           // 1 model checked, 0 not SAT, -1 bad model
+    int timeouts;
+    double wall, wall_min;
+    double parse_s, pre_s, solve_s;
+    long long conflicts, decisions, propagations;
+    double props_per_sec;
+    long rss_kb;
+} result_t;
+
+static const char *SOLVER = "./cdcl";
+static int TIMEOUT = 60, REPEAT = 3;
+static double SLOWDOWN = 10, NOISE = 0.05;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/***************************************************/
+/* RUNNING THE SOLVER                              */
+/***************************************************/
+
+// Runs the solver once on @path with its stdout/stderr going to @out/@err.
+// Returns 0 if it exited, 1 if it hit the timeout, -1 if it crashed.
+static int run_once(char **argv, const char *path, FILE *out, FILE *err,
+                    double *wall, long *rss_kb) {
+    fflush(stdout);
+    double t0 = now_seconds();
+    pid_t pid = fork();
+    if(pid < 0) {
+        perror("bench: fork");
+        exit(1);
+    }
+    // its own process group, so that whatever it forks (cdcl -cube=N
+    // workers) can be killed with it; both sides set it, to avoid a race
+    setpgid(pid, pid);
+    if(!pid) {
+        int fd = open(path, O_RDONLY);
+        if(fd < 0) {
+            perror(path);
+            _exit(127);
+        }
+        dup2(fd, 0);
+        dup2(fileno(out), 1);
+        dup2(fileno(err), 2);
+        // the timer survives exec; SIGALRM's default action kills the solver
+        alarm(TIMEOUT);
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage ru;
+    while(wait4(pid, &status, 0, &ru) < 0) {
+        if(errno != EINTR) {
+            perror("bench: wait4");
+            exit(1);
+        }
+    }
+    *wall = now_seconds() - t0;
+    *rss_kb = ru.ru_maxrss;
+    // the alarm only kills the solver itself; take down anything it left
+    kill(-pid, SIGKILL);
+    if(WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) return 1;
+    if(WIFSIGNALED(status) || WEXITSTATUS(status) == 127) return -1;
+    return 0;
+}
+
+// Reads the answer from the solver's stdout and, for SAT, checks that the
+// model satisfies every clause. A variable the model leaves out makes
+// neither of its literals true.
+static void check_answer(result_t *r, FILE *out, const dimacs_t *cnf) {
+    char word[16] = "";
+    rewind(out);
+    if(fscanf(out, "%15s", word) != 1) {
+        strcpy(r->status, "?");
+        return;
+    }
+    if(strcmp(word, "SAT") && strcmp(word, "UNSAT")) {
+        strcpy(r->status, "?");
+        return;
+    }
+    strcpy(r->status, word);
+    r->verified = 0;
+    if(strcmp(word, "SAT")) return;
+
+    signed char *val = (signed char*) calloc(cnf->n_vars + 1, 1);
+    for(int lit; fscanf(out, "%d", &lit) == 1 && lit; ) {
+        unsigned v = (lit < 0) ? -lit : lit;
+        if(v <= cnf->n_vars) val[v] = (lit < 0) ? -1 : 1;
+    }
+    r->verified = 1;
+    for(unsigned i = 0; i < cnf->n_clauses && r->verified == 1; i++) {
+        int n, sat = 0;
+        int *lits = dimacs_clause(cnf, i, &n);
+        for(int j = 0; j < n && !sat; j++) {
+            int v = (lits[j] < 0) ? -lits[j] : lits[j];
+            sat = (lits[j] < 0) ? (val[v] < 0) : (val[v] > 0);
+        }
+        if(!sat) r->verified = -1;
+    }
+    free(val);
+}
+
+// Picks the "c <name> <value>" statistics out of the solver's stderr.
+static void read_stats(result_t *r, FILE *err) {
+    char line[256], name[64];
+    double x;
+    rewind(err);
+    while(fgets(line, sizeof(line), err)) {
+        if(sscanf(line, "c %63s %lf", name, &x) != 2) continue;
+        if(!strcmp(name, "conflicts")) r->conflicts = x;
+        else if(!strcmp(name, "decisions")) r->decisions = x;
+        else if(!strcmp(name, "propagations")) r->propagations = x;
+        else if(!strcmp(name, "props_per_sec")) r->props_per_sec = x;
+        else if(!strcmp(name, "parse_seconds")) r->parse_s = x;
+        else if(!strcmp(name, "pre_seconds")) r->pre_s = x;
+        else if(!strcmp(name, "solve_seconds")) r->solve_s = x;
+    }
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static void bench_one(result_t *r, const char *path, char **argv) {
+    memset(r, 0, sizeof(*r));
+    const char *base = strrchr(path, '/');
+    snprintf(r->name, sizeof(r->name), "%s", base ? base + 1 : path);
+    r->conflicts = r->decisions = r->propagations = -1;
+    r->parse_s = r->pre_s = r->solve_s = r->props_per_sec = -1;
+
+    // Run everything before loading the CNF ourselves: a forked child starts
+    // out sharing our pages, and they'd show up in its peak RSS.
+    double *walls = (double*) malloc(sizeof(double) * REPEAT);
+    FILE **outs = (FILE**) calloc(REPEAT, sizeof(FILE*));
+    int n_walls = 0, crashed = 0;
+    for(int i = 0; i < REPEAT; i++) {
+        FILE *out = tmpfile(), *err = tmpfile();
+        double wall;
+        long rss;
+        int rc = run_once(argv, path, out, err, &wall, &rss);
+        if(rss > r->rss_kb) r->rss_kb = rss;
+        if(rc == 0) {
+            read_stats(r, err);
+            walls[n_walls] = wall;
+            outs[n_walls++] = out;
+        } else {
+            fclose(out);
+            if(rc == 1) r->timeouts++;
+            else crashed = 1;
+        }
+        fclose(err);
+        // one timeout is enough; don't burn another -timeout seconds each
+        if(rc == 1) break;
+    }
+
+    dimacs_t cnf;
+    int have_cnf = dimacs_read(&cnf, path);
+    for(int i = 0; i < n_walls; i++) {
+        if(have_cnf) {
+            result_t run = *r;
+            check_answer(&run, outs[i], &cnf);
+            // keep the first answer; a different one later is a bug too
+            if(!i) strcpy(r->status, run.status);
+            else if(strcmp(r->status, run.status)) strcpy(r->status, "FLAKY");
+            if(run.verified < 0 || !i) r->verified = run.verified;
+        }
+        fclose(outs[i]);
+    }
+    if(have_cnf) dimacs_free(&cnf);
+    else strcpy(r->status, "BADCNF");
+    if(crashed) strcpy(r->status, "CRASH");
+    else if(!n_walls) strcpy(r->status, "TIMEOUT");
+
+    if(n_walls) {
+        qsort(walls, n_walls, sizeof(double), cmp_double);
+        r->wall = walls[n_walls / 2];
+        r->wall_min = walls[0];
+    } else if(r->timeouts) {
+        r->wall = r->wall_min = TIMEOUT;
+    }
+    free(walls);
+    free(outs);
+}
+
+/***************************************************/
+/* INPUTS                                          */
+/***************************************************/
+
+static int is_cnf_name(const char *name) {
+    const char *exts[] = { ".cnf", ".dimacs", ".cnf.gz", ".dimacs.gz" };
+    size_t n = strlen(name);
+    for(unsigned i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+        size_t e = strlen(exts[i]);
+        if(n > e && !strcmp(name + n - e, exts[i])) return 1;
+    }
+    return 0;
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char *const*) a, *(char *const*) b);
+}
+
+// Appends @path, or the CNF files in it if it's a directory, to @files.
+static void add_input(const char *path, char ***files, int *n_files) {
+    struct stat st;
+    if(stat(path, &st) < 0) {
+        perror(path);
+        exit(1);
+    }
+    if(!S_ISDIR(st.st_mode)) {
+        *files = (char**) realloc(*files, sizeof(char*) * (*n_files + 1));
+        (*files)[(*n_files)++] = strdup(path);
+        return;
+    }
+    DIR *dir = opendir(path);
+    int first = *n_files;
+    for(struct dirent *de; (de = readdir(dir)); ) {
+        if(!is_cnf_name(de->d_name)) continue;
+        char *full = (char*) malloc(strlen(path) + strlen(de->d_name) + 2);
+        sprintf(full, "%s/%s", path, de->d_name);
+        *files = (char**) realloc(*files, sizeof(char*) * (*n_files + 1));
+        (*files)[(*n_files)++] = full;
+    }
+    closedir(dir);
+    qsort(*files + first, *n_files - first, sizeof(char*), cmp_str);
+}
+
+/***************************************************/
+/* OUTPUT                                          */
+/***************************************************/
+
+#define CSV_HEADER "instance,status,verified,wall_s,wall_min_s,timeouts,parse_s,pre_s,solve_s," \
+                   "conflicts,decisions,propagations,props_per_sec,peak_rss_kb"
+
+// Writes @s as a CSV field, quoted (with "" for ") if it has to be.
+static void csv_field(FILE *f, const char *s) {
+    if(!strpbrk(s, ",\"\r\n")) {
+        fputs(s, f);
+        return;
+    }
+    fputc('"', f);
+    for(; *s; s++) {
+        if(*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Splits a CSV line into at most @max fields in place, undoing
+// csv_field's quoting. Returns the number of fields.
+static int csv_split(char *line, char **field, int max) {
+    int nf = 0;
+    char *p = line;
+    while(nf < max) {
+        char *out = p;
+        field[nf++] = out;
+        if(*p == '"') {
+            for(p++; *p; ) {
+                if(*p == '"' && p[1] != '"') {
+                    p++;
+                    break;
+                }
+                if(*p == '"') p++;
+                *out++ = *p++;
+            }
+        }
+        while(*p && *p != ',' && *p != '\n') *out++ = *p++;
+        int more = (*p == ',');
+        *out = 0;
+        if(!more) break;
+        p++;
+    }
+    return nf;
+}
+
+// Writes @s as a JSON string.
+static void json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for(; *s; s++) {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if(c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void write_csv(const char *file, const result_t *rs, int n) {
+    FILE *f = fopen(file, "w");
+    if(!f) {
+        perror(file);
+        return;
+    }
+    fprintf(f, "%s\n", CSV_HEADER);
+    for(int i = 0; i < n; i++) {
+        const result_t *r = &rs[i];
+        csv_field(f, r->name);
+        fprintf(f, ",%s,%d,%.6f,%.6f,%d,%.6f,%.6f,%.6f,%lld,%lld,%lld,%.0f,%ld\n",
+                r->status, r->verified, r->wall, r->wall_min, r->timeouts,
+                r->parse_s, r->pre_s, r->solve_s, r->conflicts, r->decisions,
+                r->propagations, r->props_per_sec, r->rss_kb);
+    }
+    fclose(f);
+}
+
+static void write_json(const char *file, const result_t *rs, int n, char **argv) {
+    FILE *f = fopen(file, "w");
+    if(!f) {
+        perror(file);
+        return;
+    }
+    fprintf(f, "{\n  \"solver\": ");
+    json_string(f, argv[0]);
+    fprintf(f, ",\n  \"args\": [");
+    for(int i = 1; argv[i]; i++) {
+        if(i > 1) fprintf(f, ", ");
+        json_string(f, argv[i]);
+    }
+    fprintf(f, "],\n  \"timeout\": %d,\n  \"repeat\": %d,\n  \"results\": [\n", TIMEOUT, REPEAT);
+    for(int i = 0; i < n; i++) {
+        const result_t *r = &rs[i];
+        fprintf(f, "    {\"instance\": ");
+        json_string(f, r->name);
+        fprintf(f, ", \"status\": \"%s\", \"verified\": %d, "
+                   "\"wall_s\": %.6f, \"wall_min_s\": %.6f, \"timeouts\": %d, "
+                   "\"parse_s\": %.6f, \"pre_s\": %.6f, \"solve_s\": %.6f, "
+                   "\"conflicts\": %lld, \"decisions\": %lld, \"propagations\": %lld, "
+                   "\"props_per_sec\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+                r->status, r->verified, r->wall, r->wall_min, r->timeouts,
+                r->parse_s, r->pre_s, r->solve_s, r->conflicts, r->decisions,
+                r->propagations, r->props_per_sec, r->rss_kb, (i + 1 < n) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+}
+
+// Compares @rs against the CSV @file. Returns the number of regressions.
+static int diff_baseline(const char *file, const result_t *rs, int n) {
+    FILE *f = fopen(file, "r");
+    if(!f) {
+        printf("no baseline %s yet; copy a CSV there to start tracking\n", file);
+        return 0;
+    }
+    printf("\nvs %s:\n", file);
+    int bad = 0, compared = 0;
+    char line[1024];
+    if(!fgets(line, sizeof(line), f)) line[0] = 0;
+    while(fgets(line, sizeof(line), f)) {
+        result_t b;
+        memset(&b, 0, sizeof(b));
+        char *field[14];
+        if(csv_split(line, field, 14) < 14) continue;
+        const result_t *r = NULL;
+        for(int i = 0; i < n && !r; i++)
+            if(!strcmp(rs[i].name, field[0])) r = &rs[i];
+        if(!r) continue;
+        compared++;
+        snprintf(b.status, sizeof(b.status), "%s", field[1]);
+        b.wall = atof(field[3]);
+        b.conflicts = atoll(field[9]);
+
+        const char *verdict = NULL;
+        int solved = !strcmp(r->status, "SAT") || !strcmp(r->status, "UNSAT");
+        int was_solved = !strcmp(b.status, "SAT") || !strcmp(b.status, "UNSAT");
+        if(solved && was_solved && strcmp(r->status, b.status)) verdict = "ANSWER CHANGED";
+        else if(was_solved && !solved) verdict = r->status;
+        else if(r->wall > b.wall * (1 + SLOWDOWN / 100) && r->wall - b.wall > NOISE) verdict = "SLOWER";
+        else if(b.wall > r->wall * (1 + SLOWDOWN / 100) && b.wall - r->wall > NOISE) verdict = "faster";
+        if(verdict && strcmp(verdict, "faster")) bad++;
+
+        if(verdict || r->conflicts != b.conflicts)
+            printf("  %-24s %8.3fs -> %8.3fs (%+5.0f%%)  conflicts %lld -> %lld  %s\n",
+                   r->name, b.wall, r->wall,
+                   b.wall > 0 ? 100 * (r->wall - b.wall) / b.wall : 0.0,
+                   b.conflicts, r->conflicts, verdict ? verdict : "");
+    }
+    fclose(f);
+    printf("  %d instances compared, %d regressions\n", compared, bad);
+    return bad;
+}
+
+/***************************************************/
+/* MAIN                                            */
+/***************************************************/
+int main(int argc, char **argv) {
+    const char *csv = NULL, *json = NULL, *baseline = NULL;
+    char **files = NULL;
+    int n_files = 0, i;
+    for(i = 1; i < argc && strcmp(argv[i], "--"); i++) {
+        if(!strncmp(argv[i], "-solver=", 8)) SOLVER = argv[i] + 8;
+        else if(!strncmp(argv[i], "-timeout=", 9)) TIMEOUT = atoi(argv[i] + 9);
+        else if(!strncmp(argv[i], "-repeat=", 8)) REPEAT = atoi(argv[i] + 8);
+        else if(!strncmp(argv[i], "-csv=", 5)) csv = argv[i] + 5;
+        else if(!strncmp(argv[i], "-json=", 6)) json = argv[i] + 6;
+        else if(!strncmp(argv[i], "-baseline=", 10)) baseline = argv[i] + 10;
+        else if(!strncmp(argv[i], "-slowdown=", 10)) SLOWDOWN = atof(argv[i] + 10);
+        else if(!strncmp(argv[i], "-noise=", 7)) NOISE = atof(argv[i] + 7);
+        else if(argv[i][0] == '-') {
+            fprintf(stderr, "bench: unknown option %s\n", argv[i]);
+            return 1;
+        } else add_input(argv[i], &files, &n_files);
+    }
+    if(REPEAT < 1) REPEAT = 1;
+    if(TIMEOUT < 1) TIMEOUT = 1;
+    if(!n_files) add_input("../test_inputs", &files, &n_files);
+
+    // solver argv: the binary, then everything after --
+    int n_args = (i < argc) ? argc - i - 1 : 0;
+    char **sargv = (char**) calloc(n_args + 2, sizeof(char*));
+    sargv[0] = (char*) SOLVER;
+    for(int j = 0; j < n_args; j++) sargv[j + 1] = argv[i + 1 + j];
+
+    result_t *rs = (result_t*) calloc(n_files, sizeof(result_t));
+    int bad = 0;
+    printf("%-24s %-7s %9s %9s %10s %10s %12s %9s\n", "instance", "status",
+           "wall_s", "solve_s", "conflicts", "decisions", "props/sec", "rss_kb");
+    for(int f = 0; f < n_files; f++) {
+        result_t *r = &rs[f];
+        bench_one(r, files[f], sargv);
+        printf("%-24s %-7s %9.3f %9.3f %10lld %10lld %12.0f %9ld%s\n", r->name, r->status,
+               r->wall, r->solve_s, r->conflicts, r->decisions, r->props_per_sec, r->rss_kb,
+               r->verified < 0 ? "  BAD MODEL" : "");
+        if(r->verified < 0 || !strcmp(r->status, "CRASH") || !strcmp(r->status, "FLAKY") ||
+           !strcmp(r->status, "BADCNF") || !strcmp(r->status, "?"))
+            bad++;
+    }
+
+    if(csv) write_csv(csv, rs, n_files);
+    if(json) write_json(json, rs, n_files, sargv);
+    if(baseline) bad += diff_baseline(baseline, rs, n_files);
+    return bad ? 1 : 0;
+}
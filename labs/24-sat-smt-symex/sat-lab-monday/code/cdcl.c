@@ -2,30 +2,139 @@
  * I implemented a minimal CDCL SAT solver. It has the following features and justification
  *
  * 1. Two-literal watching for efficient propagation; I chose this over
- *    naive watching to reduce the number of clause visits
+ *    naive watching to reduce the number of clause visits. Clauses live
+ *    in one flat arena (header inline with the literals) and watchers
+ *    carry a blocking literal, so a satisfied clause is usually skipped
+ *    without touching clause memory at all. Binary clauses are kept
+ *    apart as plain implication lists and run before the long clauses;
+ *    a variable they imply records the other literal as its reason
+ *    instead of a clause reference
  *
  * 2. 1-UIP (First Unique Implication Point) conflict analysis; produces higher quality
- *    learnt clauses compared to alternatives like decision-based learning
+ *    learnt clauses compared to alternatives like decision-based learning.
+ *    The learnt clause is then minimized recursively (literals implied by
+ *    the rest of the clause are dropped, MiniSat-style), and a reason
+ *    clause that the running resolvent subsumes loses its pivot literal
+ *    on the fly
+ *
+ * 2b. Learnt clause database reduction; every so often the learnt clauses
+ *    are ranked by LBD (number of distinct decision levels) and activity
+ *    and the worse half is dropped. Glue clauses (LBD <= 2) are always
+ *    kept. Dropped clauses are only flagged; watchers to them are removed
+ *    the next time propagate() walks past them, and the arena is compacted
+ *    once enough of it is garbage
  *
  * 3. VSIDS-like (**like**) variable activity heuristics; focuses
  *    search on vars involved in recent conflicts
  *
- * 4. Random restarts with increasing intervals; motivated by infinite loops in basic.c;
- *    escapes search spaces that aren't going anywhere
+ * 4. Restarts; motivated by infinite loops in basic.c; escapes search
+ *    spaces that aren't going anywhere. Three policies: the original
+ *    geometrically growing interval, the Luby sequence, and glucose-style
+ *    (restart when the recent LBD average is bad compared to the global
+ *    one; block the restart when the trail is unusually long, since we
+ *    may be close to a model). A restart only backtracks as far as it has
+ *    to: levels whose decision the heap would pick again anyway are kept
+ *    (partial trail reuse)
+ *
+ * 5. Polarity decisions; the default is random polarities, which I
+ *    originally chose over fixed polarity to avoid getting stuck in
+ *    local minima on formulas that are SAT but get stuck with
+ *    fixed-polarity solvers; this was motivated by basic.c challenges!
+ *    Phase saving (reuse the value a variable last had) is available too.
+ *    On the random uf250 instances in test_inputs the old geometric
+ *    restarts with random polarity and no trail reuse need several times
+ *    fewer conflicts than glucose restarts with saved phases, and the
+ *    structured ones are about even, so the old setting is the default
+ *
+ * 6. SatELite-style preprocessing before the search: subsumption,
+ *    self-subsuming resolution, bounded variable elimination and
+ *    failed-literal probing. Eliminated variables get their values back
+ *    from the removed clauses once a model is found
+ *
+ * 7. Portfolio mode (-threads=N); N differently configured solvers (restart
+ *    policy, polarity, seed) race on the same preprocessed formula and the
+ *    first answer wins. Learnt units and short glue clauses are passed
+ *    between them through lock-free per-thread ring buffers. All solver
+ *    state lives in a solver_t, one per thread
  *
- * 5. Random polarity decisions; I specifically chose random polarities over
- *    fixed polarity to avoid getting stuck in local minima on formulas
- *    that are SAT but get stuck with fixed-polarity solvers;
- *    this was motivated by basic.c challenges!
+ * 7b. Cube and conquer (-cube=N); a lookahead cuber splits the formula
+ *    into cubes (partial assignments) that N worker processes solve under
+ *    assumptions, taking the next unstarted cube whenever they go idle.
+ *    The failed assumptions of a refuted cube refute every queued cube
+ *    that contains them, and the first model found ends the run
+ *
+ * 8. Incremental library interface (cdcl.h, make libcdcl.a): add clauses,
+ *    solve under assumptions, read the model or the failed assumptions,
+ *    push/pop clause groups. Learnt clauses are kept between calls; groups
+ *    work through selector variables, so whatever was learnt from a popped
+ *    group is removed with it
+ *
+ * 8b. Gauss-Jordan elimination; XOR constraints encoded as clauses are
+ *    recovered after preprocessing and kept as a bit-packed GF(2) matrix.
+ *    At every propagation fixpoint the matrix is eliminated under the
+ *    current assignment; rows that force a variable or contradict it
+ *    become learnt clauses, so parity reasoning that is exponential for
+ *    resolution alone takes one elimination
+ *
+ * 9. Local search (-ls); every so often the search drops to level 0 and
+ *    a probSAT walk starts from the saved phases. Its best assignment
+ *    becomes the new saved phases, so on random SAT instances, where
+ *    local search is much faster than CDCL, the next descent often runs
+ *    straight into a model
  * *
  *  To run:
  *      make check-cdcl
- * 
+ *
  *  Alternatively, compile:
  *      cc -O2 -o cdcl_random cdcl_random.c
  *  and run, for example:
  *      ./cdcl_random < ../test_inputs/p2.dimacs
  *
+ *  The input may also be given as a file name instead of on stdin, and
+ *  may be gzip-compressed (see dimacs.h).
+ *
+ *  Pass -s to print search statistics (conflicts, propagations/sec, ...)
+ *  to stderr as "c <name> <value>" lines.
+ *
+ *  Learnt clause reduction schedule:
+ *      -reduce-first=N  first reduction after N conflicts (default 2000)
+ *      -reduce-inc=N    each later interval grows by N conflicts (default 300)
+ *      -glue=N          never delete clauses with LBD <= N (default 2)
+ *      -no-reduce       keep every learnt clause
+ *
+ *  Conflict analysis:
+ *      -no-minimize     keep learnt clauses as 1-UIP produced them
+ *      -no-otfs         don't strengthen reason clauses during analysis
+ *
+ *  XOR reasoning:
+ *      -no-gauss        don't look for XORs / run Gauss-Jordan elimination
+ *
+ *  Local search:
+ *      -ls              interleave probSAT rounds with the search (default off)
+ *      -ls-flips=N      flips per round (default 1000000)
+ *
+ *  Restarts and polarity:
+ *      -restart=geom|luby|glucose   restart policy (default geom)
+ *      -restart-unit=N              conflicts per Luby unit (default 100)
+ *      -reuse-trail                 keep levels the heap would redo on restart
+ *      -no-reuse-trail              always backtrack to level 0 (default)
+ *      -polarity=save|random|false  decision polarity (default random)
+ *
+ *  Preprocessing:
+ *      -no-pre          skip preprocessing entirely
+ *      -no-elim         no bounded variable elimination
+ *      -no-probe        no failed-literal probing
+ *
+ *  Portfolio:
+ *      -threads=N       run N solver threads (default 1)
+ *      -share-lbd=N     share learnt clauses with LBD <= N (default 2)
+ *      -share-size=N    ... and at most N literals (default 8, max 64)
+ *      -seed=N          random seed; thread i uses N + i (default: time)
+ *
+ *  Cube and conquer:
+ *      -cube=N          solve cubes in N worker processes (not with -threads)
+ *      -cube-depth=N    split N levels deep (default: ~16 cubes per worker)
+ *
  *  Outputs SAT or UNSAT
  ***********************************************************/
 
@@ -34,6 +143,19 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "cdcl.h"
+#ifndef CDCL_LIBRARY
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "dimacs.h"
+#endif
 
 /************ DEBUG; set to 1 to turn on ************/
 #define DEBUG_MAIN 0
@@ -48,69 +170,313 @@
 
 typedef enum { VAL_UNASSIGNED = -1, VAL_FALSE = 0, VAL_TRUE = 1 } val_t;
 
-// Each clause
+// A clause reference is the offset (in ints) of the clause header inside
+// ARENA. Offsets, unlike pointers, stay valid when the arena is realloc'd.
+typedef int cref_t;
+#define CREF_UNDEF (-1)
+// A variable implied by a binary clause doesn't point at the clause: its
+// reason is the clause's other literal, encoded below CREF_UNDEF (see
+// bin_reason()), so analysis never has to load the clause.
+
+// Each clause; the header sits directly in front of its literals in ARENA.
+// lits[0] and lits[1] are the two watched literals.
 typedef struct {
-    int size;      // #literals
-    int *lits;      // array of int-literals (pos => var, neg => -var)
-    int learnt;
-    int watch0;    // 1st watched literal in .lits; index
-    int watch1;    // 2nd watched literal in .lits; index
+    int size;               // #literals
+    unsigned learnt : 1;
+    unsigned deleted : 1;   // dropped by reduce_db; watchers removed lazily
+    unsigned reloced : 1;   // moved by garbage_collect; new cref in lits[0]
+    unsigned lbd : 29;      // literal block distance (learnt only)
+    float activity;         // bumped when used in conflict analysis
+    int lits[];             // int-literals (pos => var, neg => -var)
 } clause_t;
 
+#define CLAUSE_HDR_INTS ((int) (sizeof(clause_t) / sizeof(int)))
+
 typedef struct {
     val_t value;
     int level;
-    clause_t *reason;  // NULL if decision
+    cref_t reason;  // CREF_UNDEF if decision; < CREF_UNDEF for binary clauses
 } varinfo_t;
 
+// A watcher: the clause plus a "blocking" literal from that clause. If the
+// blocker is already TRUE the clause is satisfied and we never load it.
+typedef struct {
+    cref_t cref;
+    int blocker;
+} watcher_t;
+
 // array of "watchers[list]" for each literal index */
 typedef struct {
-    clause_t **data;
+    watcher_t *data;
     int cap;
     int size;
 } watchlist_t;
 
-// "trail" array in order of assignment; array "trail_lim" for index at each decision level
-static int *trail = NULL;
-static int trail_sz = 0;
+typedef enum { RESTART_GEOM, RESTART_LUBY, RESTART_GLUCOSE } restart_policy_t;
+typedef enum { POLARITY_SAVE, POLARITY_RANDOM, POLARITY_FALSE } polarity_mode_t;
+
+// glucose restarts: fast LBD average vs. global average, blocked by trail size
+#define GLUCOSE_LBD_WINDOW 50
+#define GLUCOSE_TRAIL_WINDOW 5000
+#define GLUCOSE_K 0.8
+#define GLUCOSE_R 1.4
+#define GLUCOSE_BLOCK_AFTER 10000
+
+// fixed-size window of the most recent values with a running sum
+typedef struct {
+    int *data;
+    int cap;
+    int size;
+    int head;
+    long long sum;
+} bqueue_t;
+
+// preprocessing; see preprocess() and probe()
+#define PRE_OCC_LIMIT 10            // skip elimination if both polarities occur more often
+#define PRE_RESOLVENT_LIMIT 20      // nor if some resolvent would be longer
+#define PRE_STEP_LIMIT 100000000LL  // subsumption checks + resolutions
+#define PROBE_BUDGET 10000000LL     // propagations spent on failed literals
+
+typedef struct {
+    int *data;
+    int size;
+    int cap;
+} ivec_t;
+
+// XOR constraints found among the problem clauses, as rows of a GF(2)
+// matrix over the variables they mention; see gauss_propagate()
+typedef struct {
+    int n_rows, n_cols;
+    int words;              // uint64_t per row
+    uint64_t *rows;         // row r is rows[r * words ..]; bit j = column j
+    char *rhs;              // row r: xor of its variables == rhs[r]
+    int *col_var;           // column -> variable
+    int *var_col;           // variable -> column, or -1
+    // the rows after elimination; a pivot column appears in no other row
+    uint64_t *m;
+    char *m_rhs;
+    int *pivot;             // row -> pivot column, -1 if none
+    uint64_t *unassigned;   // column mask of the unassigned variables
+    uint64_t *truth;        // ... and of the ones assigned TRUE
+    int *expl;              // scratch for one explanation clause
+    int qhead;              // trail entries looked at for XOR variables
+    int dirty;              // some XOR variable was assigned since the last run
+    int active;
+} gauss_t;
+
+// Clause sharing between portfolio threads. Every thread owns one ring
+// buffer and is the only one writing it; the others each keep their own
+// read position. Entries are [size, lbd, lits...]. A reader that was
+// lapped by the writer throws away what it copied; see import_clauses().
+#define SHARE_BUF_INTS (1 << 16)
+#define SHARE_MAX_SIZE 64
+
+typedef struct {
+    atomic_int data[SHARE_BUF_INTS];
+    atomic_ullong head;     // ints written so far; stored after the entry
+} share_buf_t;
 
-static int *trail_lim = NULL; 
-static int trail_lim_sz = 0;  // current decision level
+// state common to all threads of a portfolio run
+typedef struct {
+    int n_threads;
+    share_buf_t *bufs;      // one per thread
+    atomic_int winner;      // -1 until some thread has an answer
+    int result;             // the winner's answer (1 SAT, 0 UNSAT)
+} portfolio_t;
 
-static int current_dl = 0; // current decision level
-static int conflict_ct = 0;
-static int restart_ct = 0;
+// Search configuration; the portfolio gives every thread a different one.
+typedef struct {
+    restart_policy_t restart_policy;
+    polarity_mode_t polarity;
+    int restart_unit;       // conflicts per Luby unit
+    int reuse_trail;
+    int reduce;             // learnt clause database reduction; see reduce_db()
+    int reduce_first;       // conflicts before the first reduction
+    int reduce_inc;         // growth of the interval after each one
+    int glue_lbd;           // clauses with lbd <= this are never dropped
+    int preprocess;
+    int elim;
+    int probe;
+    int minimize;           // recursive learnt clause minimization
+    int otfs;               // on-the-fly strengthening of reasons in analyze()
+    int ls;                 // probSAT rounds between restarts; see local_search()
+    int ls_flips;           // flips per round
+    int gauss;              // Gauss-Jordan elimination over detected XORs
+    int share_lbd;          // export learnt clauses with lbd <= this ...
+    int share_size;         // ... and at most this many literals
+    unsigned seed;
+} opts_t;
 
-// I fix the undeclared RESTART_INTERVAL
-static int RESTART_INTERVAL = 50; // smaller forces more random restarts
+static const opts_t DEFAULT_OPTS = {
+    .restart_policy = RESTART_GEOM,
+    .polarity = POLARITY_RANDOM,
+    .restart_unit = 100,
+    .reuse_trail = 0,
+    .reduce = 1,
+    .reduce_first = 2000,
+    .reduce_inc = 300,
+    .glue_lbd = 2,
+    .preprocess = 1,
+    .elim = 1,
+    .probe = 1,
+    .minimize = 1,
+    .otfs = 1,
+    .ls = 0,
+    .ls_flips = 1000000,
+    .gauss = 1,
+    .share_lbd = 2,
+    .share_size = 8,
+};
 
 /************************************************/
-/*     GLOBALS from input and data structures      */
+/*     SOLVER STATE: input and data structures     */
 /***************************************************/
+// Everything one search needs. The portfolio runs one of these per thread;
+// nothing in here is shared. The library hands it out as a cdcl_t.
+typedef struct cdcl {
+    opts_t opts;
+    int id;                 // thread index in the portfolio
+    unsigned rng;           // state for solver_rand
+    portfolio_t *pf;        // NULL when running single-threaded
+    unsigned long long *import_pos; // thread -> ints of its buffer already read
+
+    unsigned n_vars, n_clauses;
+    unsigned var_cap;       // per-variable arrays have room for this many
+    int lim_cap;            // ... and trail_lim / level_stamp for this many levels
+    int ok;                 // 0 once the clauses alone are UNSAT
+
+    // every clause (original and learnt) lives in this one int array
+    int *arena;
+    unsigned arena_sz;
+    unsigned arena_cap;
+    unsigned arena_wasted;  // ints held by deleted clauses
+
+    // every live learnt clause, for reduce_db
+    cref_t *learnts;
+    int n_learnts;
+    int learnts_cap;
+    double cla_inc;
+    double cla_decay;
+
+    varinfo_t *varinfo;     // var -> {value, level, reason}
+    watchlist_t *watches;   // watch for each literal index
+    watchlist_t *bin_watches; // binary clauses; the blocker is the other literal
+    double *activity;       // var -> activity
+    char *saved_phase;      // var -> last value (VAL_FALSE/VAL_TRUE)
+    double var_inc;
+    double var_decay;
+
+    int *order_heap;        // array of variable indices
+    int heap_size;
+    int *heap_index;        // var -> index in the heap
+
+    // "trail" array in order of assignment; array "trail_lim" for index at each decision level
+    int *trail;
+    int trail_sz;
+    int *trail_lim;
+    int current_dl;         // current decision level
+    int propQ;              // index into trail for BFS-like propagation
+
+    int conflict_ct;
+    int restart_ct;
+    int restart_interval;   // geometric; smaller forces more restarts
+    bqueue_t lbd_queue;
+    bqueue_t trail_queue;
+    long long lbd_sum;
+    long long next_reduce;
+    int reduce_interval;
+    long long next_ls;      // conflicts before the next local search round
+    long long ls_interval;
+    gauss_t gauss;
+
+    // conflict analysis
+    char *seen;             // var -> bool
+    int *an_stack;          // stack for unmark
+    int an_stack_sz;
+    int *min_stack;         // DFS stack of lit_redundant
+    ivec_t otfs;            // (cref, pivot) of reasons to strengthen after the backjump
+    int *learnt_arr;
+    int learnt_sz;
+    int learnt_lbd;
+    int *level_stamp;       // level -> stamp; a level counts once per compute_lbd call
+    int lbd_stamp;
+
+    // garbage collection target; see reloc()
+    int *gc_to;
+    unsigned gc_sz;
 
-static unsigned N_VARS = 0, N_CLAUSES = 0;
-static clause_t *CLAUSES = NULL;
-static unsigned CLAUSE_CAP = 0;
-static unsigned TOT_CLAUSES = 0;
+    // preprocessing
+    ivec_t pre_clauses;     // every problem clause (input and resolvents)
+    ivec_t *occs;           // var -> crefs of clauses on it; deleted ones dropped lazily
+    ivec_t subsume_queue;   // clauses to run backward subsumption from
+    ivec_t elim_stack;      // per removed clause: pivot, other lits..., size
+    ivec_t elim_pos, elim_neg;
+    char *lit_mark;         // lit index -> in the clause being merged
+    int *resolvent;
+    int pre_qhead;          // trail entries already applied to the clause set
+    long long pre_steps;
+    long long *elim_cost;   // var -> cost of eliminating it; see elim_cmp
+    char *eliminated;       // var -> removed by preprocessing; see extend_model
 
-static varinfo_t *VARINFO = NULL; // var -> {value, level, reason}
-static watchlist_t *WATCHES = NULL; // watch for each literal index
-static double *activity = NULL; // var -> activity
-static double var_inc = 1.0;
-static double var_decay = 0.8;
+    // incremental use through cdcl.h
+    ivec_t clauses;         // problem clauses added by cdcl_add_clause
+    ivec_t groups;          // selector variable of each open cdcl_push group
+    ivec_t assumps;         // decided first, one level each; see search_inner
+    ivec_t core;            // failed assumptions; see analyze_final
+    char *model;            // var -> VAL_TRUE/VAL_FALSE after SAT
+    unsigned model_sz;
+    int *ext2int;           // caller's variable -> ours (0: not seen yet)
+    unsigned ext_cap;
+    int *int2ext;           // ours -> caller's (0: group selector)
 
-static int *order_heap = NULL; // array of variable indices
-static int heap_size = 0;
-static int *heap_index = NULL; // var -> index in the heap
+    // statistics; printed with -s
+    long long stat_conflicts;
+    long long stat_decisions;
+    long long stat_propagations;
+    long long stat_learnt;
+    long long stat_learnt_lits;     // after minimization
+    long long stat_minimized_lits;  // removed by minimization
+    long long stat_otfs;            // reasons strengthened in analyze()
+    long long stat_ls_rounds;
+    long long stat_ls_flips;
+    int stat_ls_best;               // fewest unsatisfied clauses in the last round
+    double stat_ls_seconds;
+    long long stat_gauss_calls;
+    long long stat_gauss_props;
+    long long stat_gauss_conflicts;
+    long long stat_reductions;
+    long long stat_reduce_kept;
+    long long stat_reduce_dropped;
+    long long stat_reduce_glue;
+    long long stat_gcs;
+    long long stat_gc_bytes;
+    long long stat_blocked_restarts;
+    long long stat_reused_levels;
+    long long stat_pre_eliminated;
+    long long stat_pre_subsumed;
+    long long stat_pre_strengthened;
+    long long stat_pre_failed;
+    long long stat_pre_probe_units;
+    int stat_pre_clauses_before;
+    int stat_pre_clauses_after;
+    double stat_pre_seconds;
+    long long stat_exported;
+    long long stat_imported;
+    int cube_workers;               // -cube; see cube_solve()
+    long long stat_cubes;
+    long long stat_cubes_refuted;   // by the cuber itself
+    long long stat_cubes_pruned;    // by a failed-assumption core
+    double stat_cube_seconds;
+} solver_t;
 
-static int propQ = 0; // index into trail for BFS-like propagation
+static int PRINT_STATS = 0;
 
 /************************************************/
 /* LITERAL <-> INDEX, sign, var_of                */
 /*************************************************/
 static inline int var_of(int lit) { return (lit > 0) ? lit : -lit; }
 static inline int sign_of(int lit) { return (lit > 0) ? 0 : 1; }  // 0=pos,1=neg
-// prev map literal -> index: 
+// prev map literal -> index:
 //   index( v>0 ) = 2 * v
 //   index( v<0 ) = 2 * |v| + 1
 static inline int lit_index(int lit) {
@@ -124,540 +490,2796 @@ static inline int index_to_lit(int idx) {
     int s = (idx & 1);
     return (s ? -v : v);
 }
+
+static inline cref_t bin_reason(int other) { return CREF_UNDEF - 1 - lit_index(other); }
+static inline int is_bin_reason(cref_t r) { return r < CREF_UNDEF; }
+static inline int bin_reason_lit(cref_t r) { return index_to_lit(CREF_UNDEF - 1 - r); }
 static inline int negate_lit(int lit) { return -lit; }
 
+/***************************************************/
+/*                 CLAUSE ARENA                      */
+/***************************************************/
+static inline clause_t *clause_at(solver_t *S, cref_t cr) { return (clause_t*) (S->arena + cr); }
+
+// Copies @lits into the arena and returns the new clause's offset. NOTE: this
+// may move the arena, so any clause_t* held across the call is stale.
+static cref_t clause_alloc(solver_t *S, const int *lits, int size, int learnt) {
+    unsigned need = S->arena_sz + CLAUSE_HDR_INTS + size;
+    if(need > S->arena_cap) {
+        while(S->arena_cap < need) S->arena_cap = (S->arena_cap < 1024) ? 2048 : (S->arena_cap * 2);
+        S->arena = realloc(S->arena, sizeof(int) * S->arena_cap);
+        assert(S->arena);
+    }
+    cref_t cr = S->arena_sz;
+    clause_t *c = clause_at(S, cr);
+    c->size = size;
+    c->learnt = learnt;
+    c->deleted = 0;
+    c->reloced = 0;
+    c->lbd = 0;
+    c->activity = 0;
+    memcpy(c->lits, lits, sizeof(int) * size);
+    S->arena_sz = need;
+    return cr;
+}
+
+static void ivec_push(ivec_t *v, int x) {
+    if(v->size == v->cap) {
+        v->cap = (v->cap < 4) ? 8 : (v->cap * 2);
+        v->data = realloc(v->data, sizeof(int) * v->cap);
+    }
+    v->data[v->size++] = x;
+}
+
+static void learnts_push(solver_t *S, cref_t cr) {
+    if(S->n_learnts == S->learnts_cap) {
+        S->learnts_cap = (S->learnts_cap < 8) ? 16 : (S->learnts_cap * 2);
+        S->learnts = realloc(S->learnts, sizeof(cref_t) * S->learnts_cap);
+    }
+    S->learnts[S->n_learnts++] = cr;
+}
+
+static inline void clause_bump_activity(solver_t *S, clause_t *c) {
+    if((c->activity += S->cla_inc) > 1e20) {
+        // rescale
+        for(int i = 0; i < S->n_learnts; i++) clause_at(S, S->learnts[i])->activity *= 1e-20;
+        S->cla_inc *= 1e-20;
+    }
+}
+static inline void clause_decay_activity(solver_t *S) { S->cla_inc *= (1.0/S->cla_decay); }
+
 /***************************************************/
 /*                 WATCHLIST GROWTH                  */
 /***************************************************/
-static void watchlist_push(int idx, clause_t* c) {
-    watchlist_t *wl = &WATCHES[idx];
+static void watchlist_push(watchlist_t *wl, cref_t cr, int blocker) {
     if(wl->size == wl->cap) {
         wl->cap = (wl->cap < 4) ? 8 : (wl->cap * 2);
-        wl->data = realloc(wl->data, sizeof(clause_t*) * wl->cap);
+        wl->data = realloc(wl->data, sizeof(watcher_t) * wl->cap);
     }
-    wl->data[wl->size++] = c;
+    wl->data[wl->size++] = (watcher_t){ .cref = cr, .blocker = blocker };
+}
+
+// each watched literal uses the other watched literal as its blocker;
+// binary clauses go to their own lists, where that is all there is
+static void attach_clause(solver_t *S, cref_t cr) {
+    clause_t *c = clause_at(S, cr);
+    assert(c->size >= 2);
+    watchlist_t *ws = (c->size == 2) ? S->bin_watches : S->watches;
+    watchlist_push(&ws[lit_index(c->lits[0])], cr, c->lits[1]);
+    watchlist_push(&ws[lit_index(c->lits[1])], cr, c->lits[0]);
+}
+
+// The reason to record for lits[0] of @cr when the clause implies it.
+static inline cref_t reason_of(solver_t *S, cref_t cr) {
+    clause_t *c = clause_at(S, cr);
+    return (c->size == 2) ? bin_reason(c->lits[1]) : cr;
 }
 
 /***************************************************/
 /*        VALUE_OF lit, set literal, etc.             */
 /***************************************************/
-static inline val_t value_lit(int lit) {
-    int v = var_of(lit);
-    val_t val = VARINFO[v].value;
+static inline val_t value_lit(solver_t *S, int lit) {
+    val_t val = S->varinfo[var_of(lit)].value;
     if(val == VAL_UNASSIGNED) return VAL_UNASSIGNED;
-    int isNeg = (lit < 0);
     // if assigned=TRUE but isNeg -> false, etc
-    if(val == VAL_TRUE) return (isNeg ? VAL_FALSE : VAL_TRUE);
-    if(val == VAL_FALSE) return (isNeg ? VAL_TRUE : VAL_FALSE);
-    return VAL_UNASSIGNED; 
+    return (val_t) (val ^ (lit < 0));
 }
 
-static inline void var_bump_activity(int v) {
-    activity[v] += var_inc;
-    if(activity[v] > 1e100) {
+static void heap_sift_up(solver_t *S, int i);
+static void heap_insert_var(solver_t *S, int v);
+
+static inline void var_bump_activity(solver_t *S, int v) {
+    S->activity[v] += S->var_inc;
+    if(S->activity[v] > 1e100) {
         // rescale
-        for(unsigned i = 1; i <= N_VARS; i++) activity[i] *= 1e-100;
-        var_inc *= 1e-100;
+        for(unsigned i = 1; i <= S->n_vars; i++) S->activity[i] *= 1e-100;
+        S->var_inc *= 1e-100;
     }
+    if(S->heap_index[v] >= 0) heap_sift_up(S, S->heap_index[v]);
 }
-static inline void var_decay_activity(void) { var_inc *= (1.0/var_decay); }
+static inline void var_decay_activity(solver_t *S) { S->var_inc *= (1.0/S->var_decay); }
 
-static int enqueue(int lit, clause_t* reason) {
+static int enqueue(solver_t *S, int lit, cref_t reason) {
     int v = var_of(lit);
-    val_t val = VARINFO[v].value;
-    if(val != -1) return (value_lit(lit) == 0) ? 0 : 1;
-    VARINFO[v].value = (lit > 0 ? VAL_TRUE : VAL_FALSE);
-    VARINFO[v].level = current_dl;
-    VARINFO[v].reason = reason;
-    trail[trail_sz++] = v;
+    val_t val = S->varinfo[v].value;
+    if(val != -1) return (value_lit(S, lit) == 0) ? 0 : 1;
+    S->varinfo[v].value = (lit > 0 ? VAL_TRUE : VAL_FALSE);
+    S->varinfo[v].level = S->current_dl;
+    S->varinfo[v].reason = reason;
+    S->trail[S->trail_sz++] = v;
     return 1;
 }
 
 /***********************************************/
 /* CANCEL (backtrack)                          */
 /***********************************************/
-static void cancel_until(int level) {
-    while(current_dl > level) {
-        for(int c = trail_lim[current_dl]; c < trail_sz; c++) {
-            int v = trail[c];
-            VARINFO[v].value = VAL_UNASSIGNED;
-            VARINFO[v].reason = NULL;
+static void cancel_until(solver_t *S, int level) {
+    while(S->current_dl > level) {
+        for(int c = S->trail_lim[S->current_dl]; c < S->trail_sz; c++) {
+            int v = S->trail[c];
+            S->saved_phase[v] = S->varinfo[v].value;
+            S->varinfo[v].value = VAL_UNASSIGNED;
+            S->varinfo[v].reason = CREF_UNDEF;
+            heap_insert_var(S, v);
         }
-        trail_sz = trail_lim[current_dl];
-        current_dl--;
+        S->trail_sz = S->trail_lim[S->current_dl];
+        S->current_dl--;
     }
-    if(propQ > trail_sz) propQ = trail_sz; //ensures no out-of-bounds
+    if(S->propQ > S->trail_sz) S->propQ = S->trail_sz; //ensures no out-of-bounds
+    if(S->gauss.qhead > S->trail_sz) S->gauss.qhead = S->trail_sz;
 }
 
 /***********************************/
 /* ORDER HEAP                             */
 /***************************************/
-static inline void heap_swap(int i, int j) {
-    int va = order_heap[i];
-    int vb = order_heap[j];
-    order_heap[i] = vb;
-    order_heap[j] = va;
-    heap_index[vb] = i;
-    heap_index[va] = j;
-}
-static void heap_sift_up(int i) {
-    int v = order_heap[i];
-    double act = activity[v];
+// Max-heap on activity; ties go to the lower variable index, which is the
+// order the old linear decideVar() scan produced (dubois22 depends on it).
+static inline int heap_before(solver_t *S, int a, int b) {
+    return S->activity[a] > S->activity[b] || (S->activity[a] == S->activity[b] && a < b);
+}
+static inline void heap_swap(solver_t *S, int i, int j) {
+    int va = S->order_heap[i];
+    int vb = S->order_heap[j];
+    S->order_heap[i] = vb;
+    S->order_heap[j] = va;
+    S->heap_index[vb] = i;
+    S->heap_index[va] = j;
+}
+static void heap_sift_up(solver_t *S, int i) {
+    int v = S->order_heap[i];
     while(i > 0) {
         int p = (i - 1) >> 1;
-        int vp = order_heap[p];
-        if(activity[vp] >= act) break;
-        heap_swap(p, i);
+        int vp = S->order_heap[p];
+        if(!heap_before(S, v, vp)) break;
+        heap_swap(S, p, i);
         i = p;
     }
 }
-static void heap_sift_down(int i) {
+static void heap_sift_down(solver_t *S, int i) {
     while(1) {
         int left = (i << 1) + 1;
         int right = (i << 1) + 2;
         int largest = i;
-        if(left < heap_size) {
-            int lv = order_heap[left];
-            if(activity[lv] > activity[order_heap[largest]]) largest = left;
+        if(left < S->heap_size) {
+            int lv = S->order_heap[left];
+            if(heap_before(S, lv, S->order_heap[largest])) largest = left;
         }
-        if(right < heap_size) {
-            int rv = order_heap[right];
-            if(activity[rv] > activity[order_heap[largest]]) largest = right;
+        if(right < S->heap_size) {
+            int rv = S->order_heap[right];
+            if(heap_before(S, rv, S->order_heap[largest])) largest = right;
         }
         if(largest == i) break;
-        heap_swap(i, largest);
+        heap_swap(S, i, largest);
         i = largest;
     }
 }
-static void heap_insert_var(int v) {
-    if(heap_index[v] >= 0) return; 
-    int i = heap_size++;
-    order_heap[i] = v;
-    heap_index[v] = i;
-    heap_sift_up(i);
-}
-static int heap_pop(void) {
-    if(!heap_size) return 0;
-    int v = order_heap[0];
-    heap_size--;
-    order_heap[0] = order_heap[heap_size];
-    heap_index[order_heap[0]] = 0;
-    heap_index[v] = -1;
-    heap_sift_down(0);
+static void heap_insert_var(solver_t *S, int v) {
+    if(S->heap_index[v] >= 0) return;
+    int i = S->heap_size++;
+    S->order_heap[i] = v;
+    S->heap_index[v] = i;
+    heap_sift_up(S, i);
+}
+static int heap_pop(solver_t *S) {
+    if(!S->heap_size) return 0;
+    int v = S->order_heap[0];
+    S->heap_size--;
+    S->order_heap[0] = S->order_heap[S->heap_size];
+    S->heap_index[S->order_heap[0]] = 0;
+    S->heap_index[v] = -1;
+    heap_sift_down(S, 0);
     return v;
 }
 
-// /***************************************************/
-// /* PROPAGATION: INITIAL TWO_LITERAL WATDCH              */
-// /***************************************************/
-// static clause_t* propagate(void){
-//     while(propQ< trail_sz){
-//         int v = trail[propQ++];
-//         val_t val = VARINFO[v].value;
-//         int lit = (val==VAL_TRUE)? v : -v;
-//         int idx = lit_index(-lit); // watchers of  opposite
-//         watchlist_t *wl = &WATCHES[idx];
-//         int j = 0;
-//         for(int i=0;i< wl->size; i++){
-//             clause_t* c = wl->data[i];
-//             int w0 = c->watch0;
-//             int w1 = c->watch1;
-//             int L0 = c->lits[w0];
-//             int L1 = c->lits[w1];
-//             if(L0== -lit){
-//                 // swap watchers
-//                 c->watch0 = w1; c->watch1 = w0;
-//                 L0 = c->lits[c->watch0];
-//                 L1 = c->lits[c->watch1];
-//             }
-//             //if L0 is satisfied do nothing
-//             if(value_lit(L0)==VAL_TRUE){
-//                 wl->data[j++] = c;
-//                 continue;
-//             }
-//             // find new lit to watch
-//             int found = 0;
-//             for(int k=0;k< c->size;k++){
-//                 if(k== c->watch0 || k== c->watch1) continue;
-//                 int cand = c->lits[k];
-//                 if(value_lit(cand)!=VAL_FALSE){
-//                     c->watch1 = k;
-//                     watchlist_push(lit_index(cand), c);
-//                     found = 1;
-//                     break;
-//                 }
-//             }
-//             if(found) continue;
-//             // no new watch _> conflict or unit
-//             if(value_lit(L0)==VAL_FALSE){
-//                 // conflict
-//                 wl->data[j++] = c;
-//                 return c;
-//             }
-//             if(value_lit(L0)==VAL_UNASSIGNED){
-//                 if(!enqueue(L0,c)){
-//                     wl->data[j++] = c;
-//                     return c;
-//                 }
-//             }
-//             wl->data[j++] = c;
-//         }
-//         wl->size = j;
-//     }
-//     return NULL;
-// }
-
-/***************************************************/
-/* PROPAGATION: FIXED TWO_LITERAL WATDCH              */
-/***************************************************/
-static clause_t* propagate(void) {
-    while(propQ < trail_sz) {
-        int v = trail[propQ++];
-        val_t val = VARINFO[v].value;
-        int lit = (val == VAL_TRUE) ? v : -v;  
-
-        int idx = lit_index(-lit); 
-        watchlist_t *wl = &WATCHES[idx];
-
-        int writePos = 0;
-        for(int readPos = 0; readPos < wl->size; readPos++) {
-            clause_t* c = wl->data[readPos];
-
-            int w0 = c->watch0;  
-            int w1 = c->watch1;  
-            int L0 = c->lits[w0];
-            int L1 = c->lits[w1];
-
-            if(L0 == -lit) {
-                c->watch0 = w1;
-                c->watch1 = w0;
-                L0 = c->lits[c->watch0];
-                L1 = c->lits[c->watch1];
-            }
-
-            // If either watcher is TRUE, clause satisfied; watch
-            if(value_lit(L0) == VAL_TRUE || value_lit(L1) == VAL_TRUE) {
-                wl->data[writePos++] = c;
-                continue;  
-            }
-
-            // else find new lit to watch instead of L1; if L1 == -lit or L1 is false; L0 is not TRUE, L1 is not TRUE -> L1 either FALSE or UNASSIGNED.
-            int foundNewWatch = 0;
-            if(value_lit(L0) != VAL_FALSE) {
-                if(value_lit(L1) == VAL_FALSE) {
-                    // Look for new watch in c->lits
-                    for(int k = 0; k < c->size; k++) {
-                        if(k == c->watch0 || k == c->watch1) continue;
-                        int cand = c->lits[k];
-                        if(value_lit(cand) != VAL_FALSE) {
-                            // Found new watch
-                            c->watch1 = k;
-                            watchlist_push(lit_index(cand), c);
-                            foundNewWatch = 1;
-                            break;
-                        }
-                    }
-                    if(foundNewWatch) {
-                        // Clause no longer watched
-                        continue;
-                    }
-                }
-            } else {
-                // L0 false --> find new watch in place of L0 by swap
-                c->watch0 = w1;
-                c->watch1 = w0;
-                L0 = c->lits[c->watch0];
-                L1 = c->lits[c->watch1];
-                //  search for replacement for new L1 if false
-                if(value_lit(L1) == VAL_FALSE) {
-                    for(int k = 0; k < c->size; k++) {
-                        if(k == c->watch0 || k == c->watch1) continue;
-                        int cand = c->lits[k];
-                        if(value_lit(cand) != VAL_FALSE) {
-                            c->watch1 = k;
-                            watchlist_push(lit_index(cand), c);
-                            foundNewWatch = 1;
-                            break;
-                        }
-                    }
-                    if(foundNewWatch) continue;
-                }
+// Assigned variables stay in the heap until they reach the top; they are
+// put back by cancel_until when unassigned. Eliminated variables are never
+// decided on; extend_model gives them their values.
+static int heap_top_unassigned(solver_t *S) {
+    while(S->heap_size && (S->varinfo[S->order_heap[0]].value != VAL_UNASSIGNED || S->eliminated[S->order_heap[0]]))
+        heap_pop(S);
+    return S->heap_size ? S->order_heap[0] : 0;
+}
+
+/***************************************************/
+/* PROPAGATION: BLOCKING-LITERAL TWO_LITERAL WATCH    */
+/***************************************************/
+// Invariant: lits[0] and lits[1] of every clause are its watches. When a
+// watched literal goes FALSE we first check the watcher's blocker (no clause
+// access), then make sure the false literal sits in lits[1] and look for a
+// replacement among lits[2..].
+//
+// Binary clauses are implication lists: the watcher's blocker is the
+// implied literal, so they are done without touching the clause, and
+// before the long clauses of the same literal. Their watchers aren't
+// checked for deletion: reduce_db keeps binaries, and the ones cdcl_pop
+// drops are TRUE at level 0, so they can't fire.
+static cref_t propagate(solver_t *S) {
+    cref_t confl = CREF_UNDEF;
+    while(S->propQ < S->trail_sz) {
+        int v = S->trail[S->propQ++];
+        int false_lit = (S->varinfo[v].value == VAL_TRUE) ? -v : v;
+        S->stat_propagations++;
+
+        watchlist_t *bl = &S->bin_watches[lit_index(false_lit)];
+        for(watcher_t *w = bl->data, *end = bl->data + bl->size; w != end; w++) {
+            val_t val = value_lit(S, w->blocker);
+            if(val == VAL_TRUE) continue;
+            if(val == VAL_FALSE) {
+                S->propQ = S->trail_sz;
+                return w->cref;
             }
+            enqueue(S, w->blocker, bin_reason(false_lit));
+        }
 
-            // no new watch found -> unit or a conflict; all other lit false --> one of L0 / L1 may be UNASSIGNED
-            // if both false, conflict
-            if(value_lit(L0) == VAL_FALSE && value_lit(L1) == VAL_FALSE) {
-                wl->data[writePos++] = c;
-                return c;
+        watchlist_t *wl = &S->watches[lit_index(false_lit)];
+        watcher_t *i = wl->data, *j = wl->data, *end = wl->data + wl->size;
+        while(i != end) {
+            // satisfied by the blocker; clause memory untouched
+            if(value_lit(S, i->blocker) == VAL_TRUE) {
+                *j++ = *i++;
+                continue;
             }
 
-            // one UNASSIGNED
-            if(value_lit(L0) == VAL_UNASSIGNED && value_lit(L1) == VAL_FALSE) {
-                if(!enqueue(L0, c)) {
-                    wl->data[writePos++] = c;
-                    return c;
-                }
-            } else if(value_lit(L1) == VAL_UNASSIGNED && value_lit(L0) == VAL_FALSE) {
-                if(!enqueue(L1, c)) {
-                    wl->data[writePos++] = c;
-                    return c;
-                }
+            cref_t cr = i->cref;
+            clause_t *c = clause_at(S, cr);
+            if(c->deleted) { // dropped by reduce_db; forget the watcher
+                i++;
+                continue;
+            }
+            if(c->lits[0] == false_lit) {
+                c->lits[0] = c->lits[1];
+                c->lits[1] = false_lit;
+            }
+            i++;
+
+            // If the other watch is TRUE, clause satisfied; remember it as blocker
+            int first = c->lits[0];
+            watcher_t w = { .cref = cr, .blocker = first };
+            if(value_lit(S, first) == VAL_TRUE) {
+                *j++ = w;
+                continue;
             }
-            // If both UNASSIGNED, pick one to enqueu if size=2; else, pick L0
-            else if(value_lit(L0) == VAL_UNASSIGNED && value_lit(L1) == VAL_UNASSIGNED) {
-                if(!enqueue(L0, c)) {
-                    wl->data[writePos++] = c;
-                    return c;
+
+            // else find new lit to watch instead of lits[1]
+            int foundNewWatch = 0;
+            for(int k = 2; k < c->size; k++) {
+                int cand = c->lits[k];
+                if(value_lit(S, cand) != VAL_FALSE) {
+                    c->lits[1] = cand;
+                    c->lits[k] = false_lit;
+                    watchlist_push(&S->watches[lit_index(cand)], cr, first);
+                    foundNewWatch = 1;
+                    break;
                 }
             }
+            if(foundNewWatch) continue; // Clause no longer watched here
 
-            // clause in watchlist
-            wl->data[writePos++] = c;
+            // no new watch found -> unit or a conflict
+            *j++ = w;
+            if(value_lit(S, first) == VAL_FALSE) {
+                confl = cr;
+                S->propQ = S->trail_sz;
+                while(i != end) *j++ = *i++;
+            } else {
+                enqueue(S, first, cr);
+            }
         }
         // update watchlist size
-        wl->size = writePos;
+        wl->size = (int) (j - wl->data);
+        if(confl != CREF_UNDEF) break;
     }
-    return NULL;
+    return confl;
 }
 
 /*************************************************/
 /* 1-UIP CONFLICT ANALYSIS                     */
 /*************************************************/
-static char *seen = NULL;   //var -> bool
-static int *an_stack = NULL;  // stack for unmark
-static int an_stack_sz = 0;
-static int *learnt_arr = NULL;
-static int learnt_sz = 0;
 
-static void unmark_all(void) {
-    while(an_stack_sz > 0) {
-        int v = an_stack[--an_stack_sz];
-        seen[v] = 0;
+static int compute_lbd(solver_t *S, const int *lits, int n) {
+    int lbd = 0;
+    S->lbd_stamp++;
+    for(int i = 0; i < n; i++) {
+        int lvl = S->varinfo[var_of(lits[i])].level;
+        if(S->level_stamp[lvl] != S->lbd_stamp) {
+            S->level_stamp[lvl] = S->lbd_stamp;
+            lbd++;
+        }
+    }
+    return lbd;
+}
+
+static void unmark_all(solver_t *S) {
+    while(S->an_stack_sz > 0) {
+        int v = S->an_stack[--S->an_stack_sz];
+        S->seen[v] = 0;
+    }
+}
+
+// One bit per decision level (mod 32); a variable whose level has no bit in
+// a clause's abstraction can't be implied by that clause's other literals.
+static inline unsigned abstract_level(solver_t *S, int v) {
+    return 1u << (S->varinfo[v].level & 31);
+}
+
+// 1 if implied variable @v0 of the learnt clause follows from the clause's
+// other literals (the seen ones): every path back through the reasons ends
+// in a seen variable or at level 0 (MiniSat's litRedundant). Variables
+// found redundant on the way stay seen, which caches the answer for later
+// calls; on failure the marks this call added are undone.
+static int lit_redundant(solver_t *S, int v0, unsigned abs_levels) {
+    int top = S->an_stack_sz;
+    int sp = 0;
+    S->min_stack[sp++] = v0;
+    while(sp > 0) {
+        int v = S->min_stack[--sp];
+        cref_t r = S->varinfo[v].reason;
+        int other;
+        const int *lits = &other;
+        int size = 1;
+        if(is_bin_reason(r)) other = bin_reason_lit(r);
+        else {
+            lits = clause_at(S, r)->lits;
+            size = clause_at(S, r)->size;
+        }
+        for(int i = 0; i < size; i++) {
+            int u = var_of(lits[i]);
+            if(u == v || S->seen[u] || S->varinfo[u].level == 0) continue;
+            if(S->varinfo[u].reason == CREF_UNDEF || !(abstract_level(S, u) & abs_levels)) {
+                while(S->an_stack_sz > top) S->seen[S->an_stack[--S->an_stack_sz]] = 0;
+                return 0;
+            }
+            S->seen[u] = 1;
+            S->an_stack[S->an_stack_sz++] = u;
+            S->min_stack[sp++] = u;
+        }
     }
+    return 1;
 }
 
-static clause_t* analyze(clause_t* confl, int* out_btlevel) {
-    learnt_sz = 0;
+// Leaves the learnt clause in learnt_arr[0..learnt_sz) with the asserting
+// (UIP) literal in slot 0 and a literal of the backjump level in slot 1, so
+// the two can be watched directly.
+//
+// With opts.otfs, a reason clause whose resolvent is just the clause minus
+// the pivot is queued in otfs; strengthen_reasons() drops the pivot from it
+// once the backjump has unassigned it.
+static void analyze(solver_t *S, cref_t confl, int* out_btlevel) {
+    S->learnt_sz = 1; // slot 0 reserved for the UIP
     int pathC = 0;
     int p = -1;
-    clause_t* reason = confl;
-    int idx = trail_sz - 1;
+    cref_t reason = confl;
+    int idx = S->trail_sz - 1;
+    S->otfs.size = 0;
 
     do {
-        for(int i = 0; i < reason->size; i++) {
-            int q = reason->lits[i];
+        // a binary reason is just its other literal; p is seen already
+        clause_t *c = NULL;
+        int other;
+        const int *lits = &other;
+        int size = 1;
+        if(is_bin_reason(reason)) other = bin_reason_lit(reason);
+        else {
+            c = clause_at(S, reason);
+            if(c->learnt) {
+                clause_bump_activity(S, c);
+                // clauses that keep showing up in conflicts may have become glue
+                if(c->lbd > 2) {
+                    int lbd = compute_lbd(S, c->lits, c->size);
+                    if(lbd < (int) c->lbd) c->lbd = lbd;
+                }
+            }
+            lits = c->lits;
+            size = c->size;
+        }
+        int assigned = 0;   // literals above level 0
+        for(int i = 0; i < size; i++) {
+            int q = lits[i];
             int v = var_of(q);
-            if(!seen[v]) {
-                seen[v] = 1;
-                an_stack[an_stack_sz++] = v;
-                if(VARINFO[v].level == current_dl) pathC++;
-                else learnt_arr[learnt_sz++] = q;
+            if(S->varinfo[v].level > 0) assigned++;
+            if(!S->seen[v] && S->varinfo[v].level > 0) {
+                S->seen[v] = 1;
+                S->an_stack[S->an_stack_sz++] = v;
+                if(S->varinfo[v].level == S->current_dl) pathC++;
+                else S->learnt_arr[S->learnt_sz++] = q;
             }
         }
-        while(!seen[trail[idx]]) idx--;
-        p = trail[idx];
+        // the resolvent so far (pathC literals at this level plus the
+        // lower ones) is this reason without p: it subsumes the reason
+        if(S->opts.otfs && p != -1 && c && c->size > 2
+                && pathC + S->learnt_sz - 1 == assigned - 1) {
+            ivec_push(&S->otfs, reason);
+            ivec_push(&S->otfs, p);
+        }
+        while(!S->seen[S->trail[idx]]) idx--;
+        p = S->trail[idx];
         idx--;
-        reason = VARINFO[p].reason;
+        reason = S->varinfo[p].reason;
         pathC--;
     } while(pathC > 0);
 
     // UIP is p
-    learnt_arr[learnt_sz++] = (VARINFO[p].value == VAL_TRUE) ? -p : p;
-    // find 2nd highest level
+    S->learnt_arr[0] = (S->varinfo[p].value == VAL_TRUE) ? -p : p;
+
+    // Drop the literals implied by the rest of the clause. The dropped ones
+    // go behind learnt_sz so they still get their activity bump below.
+    int full_sz = S->learnt_sz;
+    if(S->opts.minimize) {
+        unsigned abs_levels = 0;
+        for(int i = 1; i < S->learnt_sz; i++) abs_levels |= abstract_level(S, var_of(S->learnt_arr[i]));
+        int j = 1;
+        for(int i = 1; i < S->learnt_sz; i++) {
+            int v = var_of(S->learnt_arr[i]);
+            if(S->varinfo[v].reason == CREF_UNDEF || !lit_redundant(S, v, abs_levels)) {
+                int tmp = S->learnt_arr[j];
+                S->learnt_arr[j++] = S->learnt_arr[i];
+                S->learnt_arr[i] = tmp;
+            }
+        }
+        S->stat_minimized_lits += S->learnt_sz - j;
+        S->learnt_sz = j;
+    }
+    S->stat_learnt_lits += S->learnt_sz;
+
+    // find 2nd highest level and move it into slot 1
     int backL = 0;
-    for(int i = 0; i < learnt_sz - 1; i++) {
-        int v = var_of(learnt_arr[i]);
-        int lvl = VARINFO[v].level;
-        if(lvl > backL && lvl < current_dl) backL = lvl;
+    for(int i = 1; i < S->learnt_sz; i++) {
+        int lvl = S->varinfo[var_of(S->learnt_arr[i])].level;
+        if(lvl > backL) {
+            backL = lvl;
+            int tmp = S->learnt_arr[1];
+            S->learnt_arr[1] = S->learnt_arr[i];
+            S->learnt_arr[i] = tmp;
+        }
     }
     *out_btlevel = backL;
+    S->learnt_lbd = compute_lbd(S, S->learnt_arr, S->learnt_sz);
 
-    // build new clause
-    clause_t* newc = (clause_t*) malloc(sizeof(clause_t));
-    newc->size = learnt_sz;
-    newc->lits = (int*) malloc(sizeof(int) * learnt_sz);
-    newc->learnt = 1;
-    for(int i = 0; i < learnt_sz; i++) {
-        newc->lits[i] = learnt_arr[i];
-        var_bump_activity(var_of(learnt_arr[i]));
-    }
-    newc->watch0 = 0;
-    newc->watch1 = (learnt_sz > 1) ? 1 : 0;
+    for(int i = 0; i < full_sz; i++) var_bump_activity(S, var_of(S->learnt_arr[i]));
+    unmark_all(S);
+}
 
-    if(TOT_CLAUSES == CLAUSE_CAP) {
-        CLAUSE_CAP = (CLAUSE_CAP < 8) ? 16 : (CLAUSE_CAP * 2);
-        CLAUSES = (clause_t*) realloc(CLAUSES, CLAUSE_CAP * sizeof(clause_t));
-    }
-    CLAUSES[TOT_CLAUSES] = *newc;
-    clause_t* ret = &CLAUSES[TOT_CLAUSES];
-    TOT_CLAUSES++;
-    free(newc);
+// Removes watcher @cr from the list of @lit.
+static void watch_remove(solver_t *S, int lit, cref_t cr) {
+    watchlist_t *wl = &S->watches[lit_index(lit)];
+    int i = 0;
+    while(wl->data[i].cref != cr) i++;
+    wl->data[i] = wl->data[--wl->size];
+}
 
-    watchlist_push(lit_index(ret->lits[ret->watch0]), ret);
-    watchlist_push(lit_index(ret->lits[ret->watch1]), ret);
+// Watch order after strengthening: unassigned/true literals first, then
+// false ones from the highest level down.
+static inline int watch_rank(solver_t *S, int lit) {
+    return (value_lit(S, lit) == VAL_FALSE) ? S->varinfo[var_of(lit)].level : INT_MAX;
+}
 
-    unmark_all();
-    return ret;
+// Drops the pivots from the reasons analyze() queued in otfs. Must run after
+// the backjump: the pivots are unassigned then, so none of the clauses is a
+// reason any more.
+static void strengthen_reasons(solver_t *S) {
+    for(int k = 0; k < S->otfs.size; k += 2) {
+        cref_t cr = S->otfs.data[k];
+        int pivot = S->otfs.data[k + 1];
+        clause_t *c = clause_at(S, cr);
+        if(c->deleted || c->size <= 2) continue;
+        watch_remove(S, c->lits[0], cr);
+        watch_remove(S, c->lits[1], cr);
+        int j = 0;
+        for(int i = 0; i < c->size; i++)
+            if(var_of(c->lits[i]) != pivot) c->lits[j++] = c->lits[i];
+        assert(j == c->size - 1);
+        c->size = j;
+        S->arena_wasted++;
+        // best two literals into the watch slots
+        for(int w = 0; w < 2; w++) {
+            for(int i = w + 1; i < c->size; i++) {
+                if(watch_rank(S, c->lits[i]) > watch_rank(S, c->lits[w])) {
+                    int tmp = c->lits[w];
+                    c->lits[w] = c->lits[i];
+                    c->lits[i] = tmp;
+                }
+            }
+        }
+        attach_clause(S, cr);
+        S->stat_otfs++;
+    }
+    S->otfs.size = 0;
+}
+
+// Assumption @p turned out FALSE. Leaves in core the assumptions that
+// imply its negation, plus @p itself (MiniSat's analyzeFinal). Every
+// decision below the current level is an assumption at this point.
+static void analyze_final(solver_t *S, int p) {
+    S->core.size = 0;
+    ivec_push(&S->core, p);
+    if(S->current_dl == 0) return;
+    S->seen[var_of(p)] = 1;
+    for(int i = S->trail_sz - 1; i >= S->trail_lim[1]; i--) {
+        int v = S->trail[i];
+        if(!S->seen[v]) continue;
+        cref_t r = S->varinfo[v].reason;
+        if(r == CREF_UNDEF) {
+            assert(S->varinfo[v].level > 0);
+            ivec_push(&S->core, (S->varinfo[v].value == VAL_TRUE) ? v : -v);
+        } else if(is_bin_reason(r)) {
+            int u = var_of(bin_reason_lit(r));
+            if(S->varinfo[u].level > 0) S->seen[u] = 1;
+        } else {
+            clause_t *c = clause_at(S, r);
+            for(int k = 1; k < c->size; k++)
+                if(S->varinfo[var_of(c->lits[k])].level > 0) S->seen[var_of(c->lits[k])] = 1;
+        }
+        S->seen[v] = 0;
+    }
+    S->seen[var_of(p)] = 0;
 }
 
 /***************************************************/
-/* DECIDE WITH RANDOM POLARTITY                       */
+/* LEARNT CLAUSE DATABASE REDUCTION                 */
 /***************************************************/
-static int decideVar(void) {
-    int bestVar = 0;
-    double bestAct = -1.0;
-    // pick var with highest activity among unassigned
-    for(unsigned i = 1; i <= N_VARS; i++) {
-        if(VARINFO[i].value == VAL_UNASSIGNED) {
-            if(activity[i] > bestAct) {
-                bestAct = activity[i];
-                bestVar = i;
-            }
+// A clause is locked while it is the reason for its (true) first literal.
+static int locked(solver_t *S, cref_t cr) {
+    clause_t *c = clause_at(S, cr);
+    int v = var_of(c->lits[0]);
+    return S->varinfo[v].reason == cr && value_lit(S, c->lits[0]) == VAL_TRUE;
+}
+
+// qsort has no context argument; the comparators below read the solver
+// being sorted for from here
+static _Thread_local solver_t *sort_solver = NULL;
+
+// worst clauses first: higher lbd, then lower activity
+static int learnt_cmp(const void *a, const void *b) {
+    clause_t *x = clause_at(sort_solver, *(const cref_t*) a);
+    clause_t *y = clause_at(sort_solver, *(const cref_t*) b);
+    if(x->lbd != y->lbd) return (x->lbd > y->lbd) ? -1 : 1;
+    if(x->activity != y->activity) return (x->activity < y->activity) ? -1 : 1;
+    return 0;
+}
+
+// Compacts the arena: copies every clause still reachable from a watch list,
+// a reason, learnts or clauses into a fresh array. The old header of a moved clause
+// is marked reloced and its lits[0] holds the new offset.
+
+static cref_t reloc(solver_t *S, cref_t cr) {
+    clause_t *c = clause_at(S, cr);
+    if(c->reloced) return c->lits[0];
+    unsigned n = CLAUSE_HDR_INTS + c->size;
+    cref_t nr = S->gc_sz;
+    memcpy(S->gc_to + S->gc_sz, c, sizeof(int) * n);
+    S->gc_sz += n;
+    c->reloced = 1;
+    c->lits[0] = nr;
+    return nr;
+}
+
+static void garbage_collect(solver_t *S) {
+    unsigned cap = S->arena_sz - S->arena_wasted;
+    cap += cap / 2 + 1024;
+    S->gc_to = malloc(sizeof(int) * cap);
+    S->gc_sz = 0;
+    assert(S->gc_to);
+
+    // watchers first so clauses end up next to the lists that visit them
+    for(unsigned idx = 0; idx < (S->n_vars + 1) * 4; idx++) {
+        watchlist_t *wl = (idx & 1) ? &S->bin_watches[idx >> 1] : &S->watches[idx >> 1];
+        int j = 0;
+        for(int i = 0; i < wl->size; i++) {
+            if(clause_at(S, wl->data[i].cref)->deleted) continue;
+            wl->data[j] = wl->data[i];
+            wl->data[j++].cref = reloc(S, wl->data[i].cref);
         }
+        wl->size = j;
     }
-    if(!bestVar) {
-        // fallback if can't find any
-        for(unsigned i = 1; i <= N_VARS; i++) {
-            if(VARINFO[i].value == VAL_UNASSIGNED) {
-                bestVar = i;
-                break;
-            }
+    for(int i = 0; i < S->trail_sz; i++) {
+        int v = S->trail[i];
+        if(S->varinfo[v].reason >= 0)
+            S->varinfo[v].reason = reloc(S, S->varinfo[v].reason);
+    }
+    for(int i = 0; i < S->n_learnts; i++) S->learnts[i] = reloc(S, S->learnts[i]);
+    for(int i = 0; i < S->clauses.size; i++) S->clauses.data[i] = reloc(S, S->clauses.data[i]);
+
+    S->stat_gcs++;
+    S->stat_gc_bytes += (long long) (S->arena_sz - S->gc_sz) * sizeof(int);
+    free(S->arena);
+    S->arena = S->gc_to;
+    S->arena_sz = S->gc_sz;
+    S->arena_cap = cap;
+    S->arena_wasted = 0;
+    S->gc_to = NULL;
+}
+
+// Drops (roughly) the worse half of the learnt clauses. Glue clauses,
+// binary clauses and clauses that are currently a reason stay.
+static void reduce_db(solver_t *S) {
+    sort_solver = S;
+    qsort(S->learnts, S->n_learnts, sizeof(cref_t), learnt_cmp);
+    int limit = S->n_learnts / 2;
+    int kept = 0, glue = 0, dropped = 0;
+    for(int i = 0; i < S->n_learnts; i++) {
+        cref_t cr = S->learnts[i];
+        clause_t *c = clause_at(S, cr);
+        if((int) c->lbd <= S->opts.glue_lbd) {
+            glue++;
+        } else if(i < limit && c->size > 2 && !locked(S, cr)) {
+            c->deleted = 1;
+            S->arena_wasted += CLAUSE_HDR_INTS + c->size;
+            dropped++;
+            continue;
         }
+        S->learnts[kept++] = cr;
     }
-    return bestVar;
+    S->n_learnts = kept;
+
+    S->stat_reductions++;
+    S->stat_reduce_kept += kept;
+    S->stat_reduce_dropped += dropped;
+    S->stat_reduce_glue += glue;
+    if(PRINT_STATS)
+        fprintf(stderr, "c reduce %lld conflicts %lld kept %d glue %d dropped %d\n",
+                S->stat_reductions, S->stat_conflicts, kept, glue, dropped);
+
+    if(S->arena_wasted > S->arena_sz / 5) garbage_collect(S);
 }
 
-static int pickPolarityRandom(int var) { return (rand() % 2 ? var : -var); }
+/***************************************************/
+/* DECIDE WITH SAVED (OR RANDOM) POLARITY             */
+/***************************************************/
+// pick var with highest activity among unassigned
+static int decideVar(solver_t *S) {
+    int v = heap_top_unassigned(S);
+    if(v) heap_pop(S);
+    return v;
+}
+
+// xorshift32; every solver has its own stream so threads don't share rand()
+static unsigned solver_rand(solver_t *S) {
+    unsigned x = S->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return S->rng = x;
+}
+
+static int pickPolarityRandom(solver_t *S, int var) { return (solver_rand(S) % 2 ? var : -var); }
+
+static int pickPolarity(solver_t *S, int var) {
+    switch(S->opts.polarity) {
+    case POLARITY_RANDOM: return pickPolarityRandom(S, var);
+    case POLARITY_FALSE: return -var;
+    case POLARITY_SAVE: break;
+    }
+    return (S->saved_phase[var] == VAL_TRUE) ? var : -var;
+}
 
 /***************************************************/
-/* MAIN SEARCH                                     */
+/* RESTARTS                                          */
 /***************************************************/
-static int search_inner(void) {
-    while(1) {
-        clause_t* confl = propagate();
-        if(confl) {
-            conflict_ct++;
-            if(current_dl == 0) return 0; // unsat
-            int btlevel = 0;
-            clause_t* c = analyze(confl, &btlevel);
-            cancel_until(btlevel);
-            if(!enqueue(c->lits[0], c)) return 0; // conflict at level0
-        } else {
-            // no conflict-> check all
-            int assigned = 1;
-            for(unsigned i = 1; i <= N_VARS; i++) {
-                if(VARINFO[i].value == VAL_UNASSIGNED) {
-                    assigned = 0;
-                    break;
-                }
-            }
-            if(assigned) return 1; // sat
+static void bq_init(bqueue_t *q, int cap) {
+    q->data = (int*) calloc(cap, sizeof(int));
+    q->cap = cap;
+    q->size = q->head = 0;
+    q->sum = 0;
+}
+static void bq_push(bqueue_t *q, int x) {
+    if(q->size == q->cap) {
+        q->sum -= q->data[q->head];
+        q->data[q->head] = x;
+        q->head = (q->head + 1) % q->cap;
+    } else {
+        q->data[(q->head + q->size++) % q->cap] = x;
+    }
+    q->sum += x;
+}
+static inline int bq_full(const bqueue_t *q) { return q->size == q->cap; }
+static inline double bq_avg(const bqueue_t *q) { return q->size ? (double) q->sum / q->size : 0; }
+static inline void bq_clear(bqueue_t *q) { q->size = q->head = 0; q->sum = 0; }
 
-            // do a decision
-            current_dl++;
-            trail_lim[current_dl] = trail_sz;
+// Finite subsequences of the Luby sequence: 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ...
+static long long luby(int x) {
+    int size, seq;
+    for(size = 1, seq = 0; size < x + 1; seq++, size = 2 * size + 1);
+    while(size - 1 != x) {
+        size = (size - 1) >> 1;
+        seq--;
+        x = x % size;
+    }
+    return 1LL << seq;
+}
 
-            // pick var +random polarity
-            int var = decideVar();
-            if(!var) return 1; //  all assigned
-            int pLit = pickPolarityRandom(var);
-            if(!enqueue(pLit, NULL)) return 0; 
-        }
-        // random restarts
-        if(conflict_ct >= RESTART_INTERVAL) {
-            conflict_ct = 0;
-            RESTART_INTERVAL = (RESTART_INTERVAL * 3) / 2 + 10;
-            cancel_until(0);
-        }
+// Called for every conflict, before backjumping, with the new clause's LBD.
+static void restart_on_conflict(solver_t *S, int lbd) {
+    if(S->opts.restart_policy != RESTART_GLUCOSE) return;
+    S->lbd_sum += lbd;
+    // a much longer trail than usual means we may be close to a model
+    if(S->stat_conflicts > GLUCOSE_BLOCK_AFTER && bq_full(&S->lbd_queue)
+            && S->trail_sz > GLUCOSE_R * bq_avg(&S->trail_queue)) {
+        bq_clear(&S->lbd_queue);
+        S->stat_blocked_restarts++;
+    }
+    bq_push(&S->trail_queue, S->trail_sz);
+    bq_push(&S->lbd_queue, lbd);
+}
+
+static int should_restart(solver_t *S) {
+    switch(S->opts.restart_policy) {
+    case RESTART_GEOM:
+        if(S->conflict_ct < S->restart_interval) return 0;
+        S->restart_interval = (S->restart_interval * 3) / 2 + 10;
+        return 1;
+    case RESTART_LUBY:
+        return S->conflict_ct >= luby(S->restart_ct) * S->opts.restart_unit;
+    case RESTART_GLUCOSE:
+        if(!bq_full(&S->lbd_queue)) return 0;
+        if(bq_avg(&S->lbd_queue) * GLUCOSE_K <= (double) S->lbd_sum / S->stat_conflicts) return 0;
+        bq_clear(&S->lbd_queue);
+        return 1;
     }
+    return 0;
+}
+
+// Partial trail reuse: the decisions of every level whose decision
+// variable is more active than the variable we would decide next would
+// be re-made right after the restart, so keep those levels. The same goes
+// for the levels of the assumptions.
+static int restart_level(solver_t *S) {
+    if(!S->opts.reuse_trail) return 0;
+    int next = heap_top_unassigned(S);
+    if(!next) return 0;
+    // assumption levels would be re-made as they are (some hold no decision)
+    int lvl = (S->assumps.size < S->current_dl) ? S->assumps.size : S->current_dl;
+    while(lvl < S->current_dl && S->activity[S->trail[S->trail_lim[lvl + 1]]] > S->activity[next])
+        lvl++;
+    return lvl;
 }
 
 /***************************************************/
-/* MAIN                                          */
+/* PREPROCESSING (SatELite-style)                   */
 /***************************************************/
-int main(int argc, char** argv) {
-    srand(time(NULL));
+// Runs once on the input clauses before any watch is attached. Occurrence
+// lists (var -> clauses) drive level-0 unit propagation, backward
+// subsumption, self-subsuming resolution and bounded variable elimination:
+// v is eliminated when the non-tautological resolvents on v are no more
+// than the clauses they replace. The clauses removed with v are kept on
+// elim_stack so extend_model can give v a value once a model is found.
+// Failed-literal probing uses propagate(), so it runs after the clauses are
+// attached. The library (cdcl.h) does none of this.
+#ifndef CDCL_LIBRARY
+
+static unsigned clause_sig(const clause_t *c) {
+    unsigned sig = 0;
+    for(int i = 0; i < c->size; i++) sig |= 1u << (var_of(c->lits[i]) & 31);
+    return sig;
+}
+
+static void occ_remove(solver_t *S, int v, cref_t cr) {
+    ivec_t *o = &S->occs[v];
+    for(int i = 0; i < o->size; i++) {
+        if(o->data[i] == cr) {
+            o->data[i] = o->data[--o->size];
+            return;
+        }
+    }
+}
+
+static void pre_delete(solver_t *S, cref_t cr) {
+    clause_t *c = clause_at(S, cr);
+    c->deleted = 1;
+    S->arena_wasted += CLAUSE_HDR_INTS + c->size;
+}
+
+// Removes @lit from clause @cr; a clause that becomes unit is assigned at
+// level 0 and deleted. Returns 0 on a level-0 conflict.
+static int strengthen(solver_t *S, cref_t cr, int lit) {
+    clause_t *c = clause_at(S, cr);
+    int j = 0;
+    for(int i = 0; i < c->size; i++)
+        if(c->lits[i] != lit) c->lits[j++] = c->lits[i];
+    assert(j == c->size - 1);
+    c->size = j;
+    S->arena_wasted++;
+    occ_remove(S, var_of(lit), cr);
+    if(j == 1) {
+        pre_delete(S, cr);
+        return enqueue(S, c->lits[0], CREF_UNDEF);
+    }
+    ivec_push(&S->subsume_queue, cr);
+    return 1;
+}
+
+// Applies new level-0 assignments to the clause set: satisfied clauses are
+// deleted and false literals removed. Returns 0 on a conflict.
+static int pre_propagate(solver_t *S) {
+    while(S->pre_qhead < S->trail_sz) {
+        int v = S->trail[S->pre_qhead++];
+        int true_lit = (S->varinfo[v].value == VAL_TRUE) ? v : -v;
+        ivec_t *o = &S->occs[v];
+        // backwards: strengthen() swaps the last entry into slot i
+        for(int i = o->size - 1; i >= 0; i--) {
+            cref_t cr = o->data[i];
+            clause_t *c = clause_at(S, cr);
+            if(c->deleted) continue;
+            int sat = 0;
+            for(int k = 0; k < c->size; k++) sat |= (c->lits[k] == true_lit);
+            if(sat) pre_delete(S, cr);
+            else if(!strengthen(S, cr, -true_lit)) return 0;
+        }
+        o->size = 0;
+    }
+    return 1;
+}
+
+// Returns 1 if @c subsumes @d, where at most one literal of @c may occur
+// negated in @d. In that case *flip is that literal of @d (which can then be
+// removed from @d), else 0.
+static int subsumes(const clause_t *c, const clause_t *d, int *flip) {
+    *flip = 0;
+    for(int i = 0; i < c->size; i++) {
+        int found = 0;
+        for(int j = 0; j < d->size && !found; j++) {
+            if(d->lits[j] == c->lits[i]) found = 1;
+            else if(!*flip && d->lits[j] == -c->lits[i]) {
+                *flip = d->lits[j];
+                found = 1;
+            }
+        }
+        if(!found) return 0;
+    }
+    return 1;
+}
 
-    // skip lines  starting with c
-    for(char c; (c = getc(stdin)) == 'c'; ) {
-        while(getc(stdin) != '\n');
+static int backward_subsume(solver_t *S, cref_t cr) {
+    clause_t *c = clause_at(S, cr);
+    if(c->deleted) return 1;
+    // every clause @c subsumes contains its rarest variable
+    int best = var_of(c->lits[0]);
+    for(int i = 1; i < c->size; i++)
+        if(S->occs[var_of(c->lits[i])].size < S->occs[best].size) best = var_of(c->lits[i]);
+    unsigned sig = clause_sig(c);
+    ivec_t *o = &S->occs[best];
+    // backwards: strengthening on best swaps the last entry into slot i
+    for(int i = o->size - 1; i >= 0; i--) {
+        cref_t dr = o->data[i];
+        clause_t *d = clause_at(S, dr);
+        S->pre_steps++;
+        if(dr == cr || d->deleted || d->size < c->size || (sig & ~clause_sig(d))) continue;
+        int flip;
+        if(!subsumes(c, d, &flip)) continue;
+        if(!flip) {
+            pre_delete(S, dr);
+            S->stat_pre_subsumed++;
+        } else {
+            S->stat_pre_strengthened++;
+            if(!strengthen(S, dr, flip)) return 0;
+        }
+    }
+    return 1;
+}
+
+static int subsume_all(solver_t *S) {
+    while(S->subsume_queue.size) {
+        if(!pre_propagate(S)) return 0;
+        if(S->pre_steps > PRE_STEP_LIMIT) S->subsume_queue.size = 0;
+        else if(!backward_subsume(S, S->subsume_queue.data[--S->subsume_queue.size])) return 0;
+    }
+    return pre_propagate(S);
+}
+
+// Resolves @c and @d on variable @v into resolvent[]. Returns the size, or
+// -1 if the resolvent is a tautology.
+static int merge(solver_t *S, const clause_t *c, const clause_t *d, int v) {
+    int n = 0, taut = 0;
+    S->pre_steps++;
+    for(int i = 0; i < c->size; i++) {
+        if(var_of(c->lits[i]) == v) continue;
+        S->lit_mark[lit_index(c->lits[i])] = 1;
+        S->resolvent[n++] = c->lits[i];
+    }
+    for(int i = 0; i < d->size && !taut; i++) {
+        int lit = d->lits[i];
+        if(var_of(lit) == v) continue;
+        if(S->lit_mark[lit_index(-lit)]) taut = 1;
+        else if(!S->lit_mark[lit_index(lit)]) S->resolvent[n++] = lit;
     }
-    assert(scanf(" cnf %u %u\n", &N_VARS, &N_CLAUSES) == 2);
+    for(int i = 0; i < c->size; i++) S->lit_mark[lit_index(c->lits[i])] = 0;
+    return taut ? -1 : n;
+}
+
+static void elim_push_clause(solver_t *S, const clause_t *c, int v) {
+    int pivot = 0;
+    for(int i = 0; i < c->size; i++)
+        if(var_of(c->lits[i]) == v) pivot = c->lits[i];
+    ivec_push(&S->elim_stack, pivot);
+    for(int i = 0; i < c->size; i++)
+        if(c->lits[i] != pivot) ivec_push(&S->elim_stack, c->lits[i]);
+    ivec_push(&S->elim_stack, c->size);
+}
+
+static int add_resolvent(solver_t *S, int n) {
+    if(n == 0) return 0;
+    if(n == 1) return enqueue(S, S->resolvent[0], CREF_UNDEF);
+    cref_t cr = clause_alloc(S, S->resolvent, n, 0);
+    ivec_push(&S->pre_clauses, cr);
+    for(int i = 0; i < n; i++) ivec_push(&S->occs[var_of(S->resolvent[i])], cr);
+    ivec_push(&S->subsume_queue, cr);
+    return 1;
+}
 
-    CLAUSE_CAP = (N_CLAUSES + 16);
-    CLAUSES = (clause_t*) calloc(CLAUSE_CAP, sizeof(clause_t));
-    TOT_CLAUSES = N_CLAUSES;
+// Replaces the clauses on @v by their resolvents if that does not grow the
+// clause count. Returns 0 if the formula turned out UNSAT.
+static int eliminate_var(solver_t *S, int v) {
+    ivec_t *pos = &S->elim_pos, *neg = &S->elim_neg;
+    if(S->varinfo[v].value != VAL_UNASSIGNED || S->eliminated[v]) return 1;
+    pos->size = neg->size = 0;
+    ivec_t *o = &S->occs[v];
+    int j = 0;
+    for(int i = 0; i < o->size; i++) {
+        clause_t *c = clause_at(S, o->data[i]);
+        if(c->deleted) continue;
+        o->data[j++] = o->data[i];
+        int neg_occ = 0;
+        for(int k = 0; k < c->size; k++) neg_occ |= (c->lits[k] == -v);
+        ivec_push(neg_occ ? neg : pos, o->data[i]);
+    }
+    o->size = j;
+    if(pos->size > PRE_OCC_LIMIT && neg->size > PRE_OCC_LIMIT) return 1;
 
-    VARINFO = (varinfo_t*) calloc(N_VARS + 1, sizeof(varinfo_t));
-    for(unsigned i = 1; i <= N_VARS; i++) {
-        VARINFO[i].value = VAL_UNASSIGNED;
-        VARINFO[i].level = 0;
-        VARINFO[i].reason = NULL;
+    int before = pos->size + neg->size, after = 0;
+    for(int i = 0; i < pos->size; i++) {
+        for(int k = 0; k < neg->size; k++) {
+            int n = merge(S, clause_at(S, pos->data[i]), clause_at(S, neg->data[k]), v);
+            if(n < 0) continue;
+            if(++after > before || n > PRE_RESOLVENT_LIMIT) return 1;
+        }
     }
 
-    WATCHES = (watchlist_t*) calloc((N_VARS + 1) * 2, sizeof(watchlist_t));
-    for(unsigned i = 0; i < (N_VARS + 1) * 2; i++) {
-        WATCHES[i].cap = 0;
-        WATCHES[i].size = 0;
-        WATCHES[i].data = NULL;
+    for(int i = 0; i < o->size; i++) {
+        elim_push_clause(S, clause_at(S, o->data[i]), v);
+        pre_delete(S, o->data[i]);
+    }
+    o->size = 0;
+    S->eliminated[v] = 1;
+    S->stat_pre_eliminated++;
+    // deleted clauses keep their literals, so they can still be merged;
+    // clause_at is re-read since add_resolvent may move the arena
+    for(int i = 0; i < pos->size; i++) {
+        for(int k = 0; k < neg->size; k++) {
+            int n = merge(S, clause_at(S, pos->data[i]), clause_at(S, neg->data[k]), v);
+            if(n >= 0 && !add_resolvent(S, n)) return 0;
+        }
     }
+    return subsume_all(S);
+}
+
+static int elim_cmp(const void *a, const void *b) {
+    long long *cost = sort_solver->elim_cost;
+    long long ca = cost[*(const int*) a], cb = cost[*(const int*) b];
+    return (ca > cb) - (ca < cb);
+}
+
+// Simplifies the clauses in pre_clauses in place. Units found are put on
+// the trail at level 0. Returns 0 if the formula is UNSAT.
+static int preprocess(solver_t *S) {
+    S->occs = calloc(S->n_vars + 1, sizeof(ivec_t));
+    S->lit_mark = calloc((S->n_vars + 1) * 2, sizeof(char));
+    S->resolvent = malloc(sizeof(int) * (S->n_vars + 1));
+    S->elim_cost = malloc(sizeof(long long) * (S->n_vars + 1));
+    int *order = malloc(sizeof(int) * S->n_vars);
+    int ok = 1;
 
-    activity = (double*) calloc(N_VARS + 1, sizeof(double));
-    for(unsigned i = 1; i <= N_VARS; i++) activity[i] = 0.0;
+    for(int i = 0; i < S->pre_clauses.size; i++) {
+        clause_t *c = clause_at(S, S->pre_clauses.data[i]);
+        for(int k = 0; k < c->size; k++) ivec_push(&S->occs[var_of(c->lits[k])], S->pre_clauses.data[i]);
+        ivec_push(&S->subsume_queue, S->pre_clauses.data[i]);
+    }
+    ok = subsume_all(S);
 
-    // read clauses
-    for(unsigned i = 0; i < N_CLAUSES; i++) {
-        int arrCap = 4, arrSz = 0;
-        int *arr = (int*) malloc(sizeof(int) * arrCap);
-        int lit = 0;
-        while(1) {
-            assert(scanf("%d", &lit) == 1);
-            if(!lit) break;
-            if(arrSz == arrCap) {
-                arrCap *= 2;
-                arr = (int*) realloc(arr, sizeof(int) * arrCap);
+    // cheapest variables first; eliminating one can make others cheap, so
+    // go around again while something changes
+    for(int round = 0; ok && S->opts.elim && round < 3 && S->pre_steps < PRE_STEP_LIMIT; round++) {
+        long long elim_before = S->stat_pre_eliminated;
+        int n = 0;
+        for(unsigned v = 1; v <= S->n_vars; v++) {
+            if(S->varinfo[v].value != VAL_UNASSIGNED || S->eliminated[v]) continue;
+            long long p = 0, q = 0;
+            for(int i = 0; i < S->occs[v].size; i++) {
+                clause_t *c = clause_at(S, S->occs[v].data[i]);
+                if(c->deleted) continue;
+                int neg_occ = 0;
+                for(int k = 0; k < c->size; k++) neg_occ |= (c->lits[k] == -(int) v);
+                if(neg_occ) q++;
+                else p++;
             }
-            arr[arrSz++] = lit;
+            S->elim_cost[v] = p * q;
+            order[n++] = v;
         }
-        CLAUSES[i].size = arrSz;
-        CLAUSES[i].lits = arr;
-        CLAUSES[i].learnt = 0;
-        CLAUSES[i].watch0 = 0;
-        CLAUSES[i].watch1 = (arrSz > 1) ? 1 : 0;
+        sort_solver = S;
+        qsort(order, n, sizeof(int), elim_cmp);
+        for(int i = 0; ok && i < n && S->pre_steps < PRE_STEP_LIMIT; i++)
+            ok = eliminate_var(S, order[i]);
+        if(S->stat_pre_eliminated == elim_before) break;
     }
 
-    // watchers
-    for(unsigned i = 0; i < N_CLAUSES; i++) {
-        int L0 = CLAUSES[i].lits[CLAUSES[i].watch0];
-        int L1 = CLAUSES[i].lits[CLAUSES[i].watch1];
-        watchlist_push(lit_index(L0), &CLAUSES[i]);
-        watchlist_push(lit_index(L1), &CLAUSES[i]);
+    for(unsigned v = 0; v <= S->n_vars; v++) free(S->occs[v].data);
+    free(S->occs);
+    free(S->lit_mark);
+    free(S->resolvent);
+    free(S->elim_cost);
+    free(order);
+    free(S->subsume_queue.data);
+    S->occs = NULL;
+    S->subsume_queue = (ivec_t){ 0 };
+    return ok;
+}
+
+// Failed-literal probing: assign each literal at level 1 and propagate. If
+// that conflicts the negation holds at level 0; so does anything implied by
+// both polarities of a variable. Returns 0 if the formula is UNSAT.
+static int probe(solver_t *S) {
+    if(propagate(S) != CREF_UNDEF) return 0;
+    int *stamp = calloc(S->n_vars + 1, sizeof(int));
+    char *implied = calloc(S->n_vars + 1, sizeof(char));
+    int *both = malloc(sizeof(int) * (S->n_vars + 1));
+    long long budget = S->stat_propagations + PROBE_BUDGET;
+    int ok = 1;
+
+    for(unsigned v = 1; ok && v <= S->n_vars && S->stat_propagations < budget; v++) {
+        if(S->varinfo[v].value != VAL_UNASSIGNED || S->eliminated[v]) continue;
+        int n_both = 0;
+        for(int s = 0; s < 2; s++) {
+            int lit = s ? -(int) v : (int) v;
+            S->current_dl = 1;
+            S->trail_lim[1] = S->trail_sz;
+            enqueue(S, lit, CREF_UNDEF);
+            cref_t confl = propagate(S);
+            for(int i = S->trail_lim[1] + 1; confl == CREF_UNDEF && i < S->trail_sz; i++) {
+                int u = S->trail[i];
+                if(!s) {
+                    stamp[u] = v;
+                    implied[u] = S->varinfo[u].value;
+                } else if(stamp[u] == (int) v && implied[u] == S->varinfo[u].value) {
+                    both[n_both++] = (S->varinfo[u].value == VAL_TRUE) ? u : -u;
+                }
+            }
+            cancel_until(S, 0);
+            if(confl != CREF_UNDEF) {
+                S->stat_pre_failed++;
+                n_both = 0;
+                ok = enqueue(S, -lit, CREF_UNDEF) && propagate(S) == CREF_UNDEF;
+                break;
+            }
+        }
+        for(int i = 0; ok && i < n_both; i++) {
+            S->stat_pre_probe_units++;
+            ok = enqueue(S, both[i], CREF_UNDEF);
+        }
+        if(ok && n_both) ok = (propagate(S) == CREF_UNDEF);
     }
+    free(stamp);
+    free(implied);
+    free(both);
+    return ok;
+}
 
-    //  trail
-    trail = (int*) malloc(sizeof(int) * (N_VARS + 1) * 2);
-    trail_sz = 0;
-    trail_lim = (int*) malloc(sizeof(int) * (N_VARS + 1));
-    trail_lim[0] = 0;
-    current_dl = 0;
+// Assigns the eliminated variables (SatELite's model extension). The stack
+// is walked from the top, i.e. from the last eliminated variable back; a
+// removed clause the model does not satisfy gets its pivot set TRUE. The
+// clauses removed with a variable only mention variables eliminated after
+// it, which all have their final values by then.
+static void extend_model(solver_t *S) {
+    for(unsigned v = 1; v <= S->n_vars; v++)
+        if(S->eliminated[v]) S->varinfo[v].value = VAL_FALSE;
+    for(int i = S->elim_stack.size - 1; i >= 0; ) {
+        int n = S->elim_stack.data[i];
+        int *lits = &S->elim_stack.data[i - n];
+        i -= n + 1;
+        int sat = 0;
+        for(int k = 0; k < n && !sat; k++) sat = (value_lit(S, lits[k]) == VAL_TRUE);
+        if(!sat) S->varinfo[var_of(lits[0])].value = (lits[0] > 0) ? VAL_TRUE : VAL_FALSE;
+    }
+}
+#endif
 
-    //conflict analysis
-    seen = (char*) calloc(N_VARS + 1, sizeof(char));
-    an_stack = (int*) malloc(sizeof(int) * (N_VARS + 1));
-    learnt_arr = (int*) malloc(sizeof(int) * (N_VARS + 1) * 2);
+/***************************************************/
+/* CLAUSE SHARING (PORTFOLIO)                       */
+/***************************************************/
+// Publishes a short, low-LBD learnt clause (or a learnt unit) to the other
+// threads. Only the owning thread writes its buffer, so no lock is needed:
+// the entry is written first and head is moved past it afterwards.
+static void export_clause(solver_t *S, const int *lits, int n, int lbd) {
+    if(!S->pf || n > S->opts.share_size || lbd > S->opts.share_lbd) return;
+    share_buf_t *b = &S->pf->bufs[S->id];
+    unsigned long long h = atomic_load_explicit(&b->head, memory_order_relaxed);
+    // readers that see any of the ints below also see the previous head
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&b->data[h++ % SHARE_BUF_INTS], n, memory_order_relaxed);
+    atomic_store_explicit(&b->data[h++ % SHARE_BUF_INTS], lbd, memory_order_relaxed);
+    for(int i = 0; i < n; i++)
+        atomic_store_explicit(&b->data[h++ % SHARE_BUF_INTS], lits[i], memory_order_relaxed);
+    atomic_store_explicit(&b->head, h, memory_order_release);
+    S->stat_exported++;
+}
 
-    // solve
-    int ret = search_inner();
-    if(!ret) {
-        printf("UNSAT\n");
-        return 0;
-    } 
-    // final check -> sat
-    printf("SAT\n");
-    for(unsigned v = 1; v <= N_VARS; v++) {
-        if(VARINFO[v].value == VAL_TRUE) printf("%u ", v);
-        else printf("-%u ", v);
+// Adds a clause learnt by another thread. Literals false at level 0 are
+// dropped. The best two literals (non-false first, then false ones from the
+// highest level) become the watches; if the clause is unit or false under
+// the current trail we backjump to where it is not. Returns 0 if the clause
+// is false at level 0.
+static int add_imported(solver_t *S, int *lits, int n, int lbd) {
+    int j = 0;
+    for(int i = 0; i < n; i++) {
+        val_t val = value_lit(S, lits[i]);
+        if(val != VAL_UNASSIGNED && S->varinfo[var_of(lits[i])].level == 0) {
+            if(val == VAL_TRUE) return 1;
+            continue;
+        }
+        lits[j++] = lits[i];
+    }
+    n = j;
+    if(n == 0) return 0;
+    S->stat_imported++;
+    if(n == 1) {
+        cancel_until(S, 0);
+        return enqueue(S, lits[0], CREF_UNDEF);
+    }
+
+    for(int w = 0; w < 2; w++) {
+        for(int i = w + 1; i < n; i++) {
+            int a = lits[i], b = lits[w];
+            int ra = (value_lit(S, a) != VAL_FALSE) ? S->current_dl + 1 : S->varinfo[var_of(a)].level;
+            int rb = (value_lit(S, b) != VAL_FALSE) ? S->current_dl + 1 : S->varinfo[var_of(b)].level;
+            if(ra > rb) {
+                lits[i] = b;
+                lits[w] = a;
+            }
+        }
+    }
+
+    int unit = 0;
+    if(value_lit(S, lits[1]) == VAL_FALSE) {
+        int l0 = S->varinfo[var_of(lits[0])].level;
+        int l1 = S->varinfo[var_of(lits[1])].level;
+        val_t v0 = value_lit(S, lits[0]);
+        if(v0 == VAL_FALSE && l0 == l1) {
+            cancel_until(S, l1 - 1);  // both watches unassigned again
+        } else if(v0 != VAL_TRUE || l0 > l1) {
+            cancel_until(S, l1);      // lits[0] is implied at l1
+            unit = 1;
+        }
+    }
+    cref_t cr = clause_alloc(S, lits, n, 1);
+    clause_at(S, cr)->lbd = lbd;
+    attach_clause(S, cr);
+    learnts_push(S, cr);
+    if(unit) enqueue(S, lits[0], reason_of(S, cr));
+    return 1;
+}
+
+// Reads whatever the other threads exported since the last call. The ring
+// buffer may be overwritten while we copy an entry, so after copying we
+// re-read head: if the writer could have come around to the entry, it is
+// thrown away and we skip ahead. Returns 0 if the formula became UNSAT.
+static int import_clauses(solver_t *S) {
+    int lits[SHARE_MAX_SIZE];
+    for(int t = 0; t < S->pf->n_threads; t++) {
+        if(t == S->id) continue;
+        share_buf_t *b = &S->pf->bufs[t];
+        unsigned long long h = atomic_load_explicit(&b->head, memory_order_acquire);
+        unsigned long long pos = S->import_pos[t];
+        while(pos < h) {
+            int n = atomic_load_explicit(&b->data[pos % SHARE_BUF_INTS], memory_order_relaxed);
+            int lbd = atomic_load_explicit(&b->data[(pos + 1) % SHARE_BUF_INTS], memory_order_relaxed);
+            int valid = (n >= 1 && n <= SHARE_MAX_SIZE);
+            for(int i = 0; valid && i < n; i++)
+                lits[i] = atomic_load_explicit(&b->data[(pos + 2 + i) % SHARE_BUF_INTS], memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            unsigned long long h2 = atomic_load_explicit(&b->head, memory_order_relaxed);
+            if(h2 + SHARE_MAX_SIZE + 2 > pos + SHARE_BUF_INTS) { // lapped
+                pos = h2;
+                break;
+            }
+            assert(valid);
+            pos += n + 2;
+            if(!add_imported(S, lits, n, lbd)) return 0;
+        }
+        S->import_pos[t] = pos;
+    }
+    return 1;
+}
+
+/***************************************************/
+/* LOCAL SEARCH (probSAT)                           */
+/***************************************************/
+// A round works on the problem clauses as they stand at level 0: satisfied
+// ones are left out, false literals dropped, so level-0 variables are never
+// flipped (learnt clauses follow from the rest and are ignored). Each step
+// picks a random unsatisfied clause and flips one of its variables, chosen
+// with weight cb^-break, where break is the number of clauses that variable
+// alone satisfies. Break counts are kept up to date on every flip: a clause
+// with one true literal remembers its variable as the xor of the variables
+// of all its true literals.
+
+#define LS_BREAK_MAX 32
+#define LS_FIRST_INTERVAL 5000  // conflicts before the second round; doubles after each
+
+typedef struct {
+    int n_vars;
+    int n_clauses;
+    int *lits;          // clause i is lits[start[i] .. start[i + 1])
+    int *start;
+    int *occ;           // clauses with literal index idx: occ[occ_start[idx] .. occ_start[idx + 1])
+    int *occ_start;
+    int *n_true;        // clause -> number of true literals
+    int *crit;          // clause -> xor of the variables of its true literals
+    int *brk;           // var -> clauses it is the only true literal of
+    char *val;          // var -> 1 if true
+    int *unsat;         // the unsatisfied clauses
+    int *unsat_pos;     // clause -> its index in unsat
+    int n_unsat;
+    double *weight;     // scratch for one clause
+    double prob[LS_BREAK_MAX + 1];  // break count -> weight
+
+    // The best assignment so far is val with the flips logged since then
+    // undone. Once the log is longer than a copy it goes into best_val.
+    int *log;
+    int n_log;
+    int best_in_log;
+    char *best_val;
+} ls_t;
+
+static double now_seconds(void);
+
+// Appends the live problem (not learnt) clauses to @out. Every clause is
+// watched by its lits[0], so each is found once by looking for the
+// watchers of the literal in its slot 0.
+static void problem_clauses(solver_t *S, ivec_t *out) {
+    for(unsigned idx = 0; idx < (S->n_vars + 1) * 2; idx++) {
+        for(int bin = 0; bin < 2; bin++) {
+            watchlist_t *wl = bin ? &S->bin_watches[idx] : &S->watches[idx];
+            for(int i = 0; i < wl->size; i++) {
+                clause_t *c = clause_at(S, wl->data[i].cref);
+                if(!c->deleted && !c->learnt && lit_index(c->lits[0]) == (int) idx)
+                    ivec_push(out, wl->data[i].cref);
+            }
+        }
+    }
+}
+
+static void ls_unsat_add(ls_t *L, int c) {
+    L->unsat_pos[c] = L->n_unsat;
+    L->unsat[L->n_unsat++] = c;
+}
+
+static void ls_unsat_remove(ls_t *L, int c) {
+    int last = L->unsat[--L->n_unsat];
+    L->unsat[L->unsat_pos[c]] = last;
+    L->unsat_pos[last] = L->unsat_pos[c];
+}
+
+static void ls_build(solver_t *S, ls_t *L) {
+    unsigned n_idx = (S->n_vars + 1) * 2;
+    ivec_t crs = { 0 }, lits = { 0 }, start = { 0 };
+    int max_len = 0;
+    problem_clauses(S, &crs);
+    for(int i = 0; i < crs.size; i++) {
+        clause_t *c = clause_at(S, crs.data[i]);
+        int from = lits.size, sat = 0;
+        for(int k = 0; k < c->size && !sat; k++) {
+            val_t val = value_lit(S, c->lits[k]);
+            if(val == VAL_TRUE) sat = 1;
+            else if(val == VAL_UNASSIGNED) ivec_push(&lits, c->lits[k]);
+        }
+        if(sat || lits.size == from) {
+            lits.size = from;
+            continue;
+        }
+        ivec_push(&start, from);
+        if(lits.size - from > max_len) max_len = lits.size - from;
+    }
+    ivec_push(&start, lits.size);
+    free(crs.data);
+
+    L->n_vars = S->n_vars;
+    L->n_clauses = start.size - 1;
+    L->lits = lits.data;
+    L->start = start.data;
+    L->occ_start = calloc(n_idx + 1, sizeof(int));
+    for(int i = 0; i < lits.size; i++) L->occ_start[lit_index(lits.data[i]) + 1]++;
+    for(unsigned idx = 0; idx < n_idx; idx++) L->occ_start[idx + 1] += L->occ_start[idx];
+    L->occ = malloc(sizeof(int) * (lits.size + 1));
+    int *fill = malloc(sizeof(int) * n_idx);
+    memcpy(fill, L->occ_start, sizeof(int) * n_idx);
+    for(int c = 0; c < L->n_clauses; c++)
+        for(int i = L->start[c]; i < L->start[c + 1]; i++) L->occ[fill[lit_index(L->lits[i])]++] = c;
+    free(fill);
+
+    L->n_true = malloc(sizeof(int) * (L->n_clauses + 1));
+    L->crit = malloc(sizeof(int) * (L->n_clauses + 1));
+    L->unsat = malloc(sizeof(int) * (L->n_clauses + 1));
+    L->unsat_pos = malloc(sizeof(int) * (L->n_clauses + 1));
+    L->brk = calloc(S->n_vars + 1, sizeof(int));
+    L->val = malloc(S->n_vars + 1);
+    L->best_val = malloc(S->n_vars + 1);
+    L->log = malloc(sizeof(int) * (S->n_vars + 1));
+    L->weight = malloc(sizeof(double) * (max_len + 1));
+
+    // probSAT's exponential setting for k-SAT; cb grows with k
+    double cb = (max_len <= 3) ? 2.5 : (max_len <= 5) ? 3.7 : 5.4;
+    L->prob[0] = 1.0;
+    for(int b = 1; b <= LS_BREAK_MAX; b++) L->prob[b] = L->prob[b - 1] / cb;
+}
+
+static void ls_free(ls_t *L) {
+    free(L->lits);
+    free(L->start);
+    free(L->occ);
+    free(L->occ_start);
+    free(L->n_true);
+    free(L->crit);
+    free(L->brk);
+    free(L->val);
+    free(L->best_val);
+    free(L->unsat);
+    free(L->unsat_pos);
+    free(L->log);
+    free(L->weight);
+}
+
+static void ls_flip(ls_t *L, int v) {
+    L->val[v] ^= 1;
+    int t = L->val[v] ? v : -v;     // the literal that became true
+    int idx = lit_index(t);
+    for(int *o = L->occ + L->occ_start[idx], *end = L->occ + L->occ_start[idx + 1]; o != end; o++) {
+        int c = *o;
+        int n = L->n_true[c]++;
+        if(n == 0) {
+            ls_unsat_remove(L, c);
+            L->brk[v]++;
+        } else if(n == 1) {
+            L->brk[L->crit[c]]--;
+        }
+        L->crit[c] ^= v;
+    }
+    idx = lit_index(-t);
+    for(int *o = L->occ + L->occ_start[idx], *end = L->occ + L->occ_start[idx + 1]; o != end; o++) {
+        int c = *o;
+        int n = --L->n_true[c];
+        L->crit[c] ^= v;
+        if(n == 0) {
+            ls_unsat_add(L, c);
+            L->brk[v]--;
+        } else if(n == 1) {
+            L->brk[L->crit[c]]++;
+        }
+    }
+
+    if(L->best_in_log) {
+        L->log[L->n_log++] = v;
+        if(L->n_log > L->n_vars) {
+            memcpy(L->best_val, L->val, L->n_vars + 1);
+            for(int i = 0; i < L->n_log; i++) L->best_val[L->log[i]] ^= 1;
+            L->best_in_log = 0;
+        }
+    }
+}
+
+// One round of at most opts.ls_flips flips, starting from saved_phase; the
+// best assignment seen goes back there. Must be called at level 0. Returns
+// 1 if that assignment satisfies every clause.
+static int local_search(solver_t *S) {
+    assert(S->current_dl == 0);
+    double t0 = now_seconds();
+    ls_t L;
+    memset(&L, 0, sizeof(L));
+    ls_build(S, &L);
+
+    for(unsigned v = 1; v <= S->n_vars; v++) L.val[v] = (S->saved_phase[v] == VAL_TRUE);
+    for(int c = 0; c < L.n_clauses; c++) {
+        L.n_true[c] = L.crit[c] = 0;
+        for(int i = L.start[c]; i < L.start[c + 1]; i++) {
+            int lit = L.lits[i];
+            if(L.val[var_of(lit)] == (lit > 0)) {
+                L.n_true[c]++;
+                L.crit[c] ^= var_of(lit);
+            }
+        }
+        if(L.n_true[c] == 0) ls_unsat_add(&L, c);
+        else if(L.n_true[c] == 1) L.brk[L.crit[c]]++;
+    }
+
+    int best = L.n_unsat;
+    L.best_in_log = 1;
+    long long flips = 0;
+    while(L.n_unsat && flips < S->opts.ls_flips) {
+        int c = L.unsat[solver_rand(S) % L.n_unsat];
+        const int *lits = L.lits + L.start[c];
+        int n = L.start[c + 1] - L.start[c];
+        double sum = 0;
+        for(int i = 0; i < n; i++) {
+            int b = L.brk[var_of(lits[i])];
+            sum += L.weight[i] = L.prob[(b < LS_BREAK_MAX) ? b : LS_BREAK_MAX];
+        }
+        double r = sum * (solver_rand(S) / 4294967296.0);
+        int k = 0;
+        while(k < n - 1 && (r -= L.weight[k]) > 0) k++;
+        ls_flip(&L, var_of(lits[k]));
+        flips++;
+        if(L.n_unsat < best) {
+            best = L.n_unsat;
+            L.n_log = 0;
+            L.best_in_log = 1;
+        }
+    }
+
+    if(L.best_in_log)
+        for(int i = 0; i < L.n_log; i++) L.val[L.log[i]] ^= 1;
+    const char *best_val = L.best_in_log ? L.val : L.best_val;
+    for(unsigned v = 1; v <= S->n_vars; v++)
+        if(S->varinfo[v].value == VAL_UNASSIGNED) S->saved_phase[v] = best_val[v] ? VAL_TRUE : VAL_FALSE;
+    ls_free(&L);
+
+    S->stat_ls_rounds++;
+    S->stat_ls_flips += flips;
+    S->stat_ls_best = best;
+    S->stat_ls_seconds += now_seconds() - t0;
+    if(PRINT_STATS)
+        fprintf(stderr, "c ls round %lld conflicts %lld flips %lld best %d\n",
+                S->stat_ls_rounds, S->stat_conflicts, flips, best);
+    return best == 0;
+}
+
+/***************************************************/
+/* GAUSS-JORDAN ELIMINATION OVER XORS               */
+/***************************************************/
+// A k-variable XOR takes 2^(k-1) clauses, one per assignment of the wrong
+// parity; gauss_init() looks for complete sets of them. The matrix is kept
+// in reduced row echelon form over the unassigned columns, with the
+// assigned ones riding along. Whenever CNF propagation reaches a fixpoint,
+// gauss_propagate() re-pivots the rows whose pivot is assigned (or that
+// have none) and reads off the rows left with one unassigned variable,
+// which is implied, or none and the wrong parity, which is a conflict. A
+// row is a sum of input XORs, so the clause "its unassigned literal, or
+// one of its assigned variables differs" follows from the formula; it is
+// added as a learnt clause and used as the reason or conflict.
+//
+// Backtracking needs no undo: a pivot column is in no other row whatever
+// the assignment, and one that becomes unassigned again is still a valid
+// pivot. Rows without one simply get re-pivoted on the next call.
+
+#define GAUSS_MIN_XOR 3
+#define GAUSS_MAX_XOR 6
+#define GAUSS_MAX_WORK (1 << 22)    // rows * columns * words of one elimination
+#define GAUSS_PROBATION 2000        // calls before an unproductive matrix is dropped
+
+typedef struct {
+    int k;
+    int vars[GAUSS_MAX_XOR];        // sorted
+    unsigned negs;                  // bit i: vars[i] occurs negated
+} xor_cand_t;
+
+static void gauss_free(gauss_t *G) {
+    free(G->rows);
+    free(G->rhs);
+    free(G->col_var);
+    free(G->var_col);
+    free(G->m);
+    free(G->m_rhs);
+    free(G->pivot);
+    free(G->unassigned);
+    free(G->truth);
+    free(G->expl);
+    memset(G, 0, sizeof(*G));
+}
+
+#ifndef CDCL_LIBRARY
+static int xor_cand_cmp(const void *a, const void *b) {
+    const xor_cand_t *x = a, *y = b;
+    if(x->k != y->k) return x->k - y->k;
+    for(int i = 0; i < x->k; i++)
+        if(x->vars[i] != y->vars[i]) return x->vars[i] - y->vars[i];
+    return (x->negs > y->negs) - (x->negs < y->negs);
+}
+
+// Builds the matrix from the problem clauses; S must be at level 0.
+static void gauss_init(solver_t *S) {
+    gauss_t *G = &S->gauss;
+    ivec_t crs = { 0 };
+    problem_clauses(S, &crs);
+    xor_cand_t *cand = malloc(sizeof(xor_cand_t) * (crs.size + 1));
+    int n = 0;
+    for(int i = 0; i < crs.size; i++) {
+        clause_t *c = clause_at(S, crs.data[i]);
+        if(c->size < GAUSS_MIN_XOR || c->size > GAUSS_MAX_XOR) continue;
+        int assigned = 0;
+        for(int k = 0; k < c->size; k++) assigned |= (value_lit(S, c->lits[k]) != VAL_UNASSIGNED);
+        if(assigned) continue;
+        xor_cand_t *x = &cand[n++];
+        x->k = c->size;
+        for(int k = 0; k < c->size; k++) {     // insertion sort by variable
+            int v = var_of(c->lits[k]), j = k;
+            for(; j > 0 && x->vars[j - 1] > v; j--) x->vars[j] = x->vars[j - 1];
+            x->vars[j] = v;
+        }
+        x->negs = 0;
+        for(int k = 0; k < c->size; k++)
+            for(int j = 0; j < c->size; j++)
+                if(x->vars[j] == -c->lits[k]) x->negs |= 1u << j;
+    }
+    free(crs.data);
+    qsort(cand, n, sizeof(xor_cand_t), xor_cand_cmp);
+
+    // a clause excludes the one assignment that falsifies it, whose parity
+    // is that of its negations; all 2^(k-1) clauses of one parity make the
+    // XOR of the variables equal the other parity
+    ivec_t xors = { 0 };            // k, rhs, vars... per XOR
+    for(int i = 0, j; i < n; i = j) {
+        uint64_t seen = 0;
+        int k = cand[i].k;
+        for(j = i; j < n && cand[j].k == k && !memcmp(cand[i].vars, cand[j].vars, sizeof(int) * k); j++)
+            seen |= 1ull << cand[j].negs;
+        for(int parity = 0; parity < 2; parity++) {
+            int have = 0;
+            for(unsigned negs = 0; negs < (1u << k); negs++)
+                if((__builtin_popcount(negs) & 1) == parity && (seen >> negs & 1)) have++;
+            if(have < (1 << (k - 1))) continue;
+            ivec_push(&xors, k);
+            ivec_push(&xors, !parity);
+            for(int t = 0; t < k; t++) ivec_push(&xors, cand[i].vars[t]);
+        }
+    }
+    free(cand);
+
+    G->var_col = malloc(sizeof(int) * (S->n_vars + 1));
+    for(unsigned v = 0; v <= S->n_vars; v++) G->var_col[v] = -1;
+    G->col_var = malloc(sizeof(int) * (S->n_vars + 1));
+    for(int i = 0; i < xors.size; i += 2 + xors.data[i]) {
+        G->n_rows++;
+        for(int t = 0; t < xors.data[i]; t++) {
+            int v = xors.data[i + 2 + t];
+            if(G->var_col[v] < 0) {
+                G->var_col[v] = G->n_cols;
+                G->col_var[G->n_cols++] = v;
+            }
+        }
+    }
+    G->words = (G->n_cols + 63) / 64;
+    long long work = (long long) G->n_rows * G->n_cols * G->words;
+    if(G->n_rows < 2 || work > GAUSS_MAX_WORK) {
+        if(PRINT_STATS && G->n_rows)
+            fprintf(stderr, "c gauss %d xors over %d variables; too big, not used\n", G->n_rows, G->n_cols);
+        free(xors.data);
+        gauss_free(G);
+        return;
+    }
+    G->rows = calloc((size_t) G->n_rows * G->words, sizeof(uint64_t));
+    G->rhs = malloc(G->n_rows);
+    for(int i = 0, r = 0; i < xors.size; i += 2 + xors.data[i], r++) {
+        G->rhs[r] = xors.data[i + 1];
+        for(int t = 0; t < xors.data[i]; t++) {
+            int col = G->var_col[xors.data[i + 2 + t]];
+            G->rows[(size_t) r * G->words + col / 64] |= 1ull << (col % 64);
+        }
+    }
+    free(xors.data);
+    G->m = malloc(sizeof(uint64_t) * G->n_rows * G->words);
+    G->m_rhs = malloc(G->n_rows);
+    G->pivot = malloc(sizeof(int) * G->n_rows);
+    memcpy(G->m, G->rows, sizeof(uint64_t) * G->n_rows * G->words);
+    memcpy(G->m_rhs, G->rhs, G->n_rows);
+    for(int r = 0; r < G->n_rows; r++) G->pivot[r] = -1;
+    G->unassigned = malloc(sizeof(uint64_t) * G->words);
+    G->truth = malloc(sizeof(uint64_t) * G->words);
+    G->expl = malloc(sizeof(int) * (G->n_cols + 1));
+    G->dirty = 1;
+    G->active = 1;
+    if(PRINT_STATS) fprintf(stderr, "c gauss %d xors over %d variables\n", G->n_rows, G->n_cols);
+}
+#endif
+
+// Turns row @r of the eliminated matrix into a clause: @lit (0 for a
+// conflict) plus the literal of each assigned variable of the row that is
+// FALSE now. Adds it as a learnt clause with the two highest levels in the
+// watched slots and returns it; a unit clause is asserted at level 0
+// instead, and CREF_UNDEF returned (0 in *ok if that is a conflict).
+static cref_t gauss_explain(solver_t *S, int r, int lit, int *ok) {
+    gauss_t *G = &S->gauss;
+    const uint64_t *row = G->m + (size_t) r * G->words;
+    int n = 0;
+    if(lit) G->expl[n++] = lit;
+    for(int w = 0; w < G->words; w++) {
+        uint64_t bits = row[w] & ~G->unassigned[w];
+        while(bits) {
+            int col = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            int v = G->col_var[col];
+            G->expl[n++] = (S->varinfo[v].value == VAL_TRUE) ? -v : v;
+        }
+    }
+    if(n <= 1) {
+        cancel_until(S, 0);
+        *ok = n && enqueue(S, G->expl[0], CREF_UNDEF);
+        return CREF_UNDEF;
+    }
+    for(int w = lit ? 1 : 0; w < 2; w++) {
+        for(int i = w + 1; i < n; i++) {
+            if(S->varinfo[var_of(G->expl[i])].level > S->varinfo[var_of(G->expl[w])].level) {
+                int tmp = G->expl[w];
+                G->expl[w] = G->expl[i];
+                G->expl[i] = tmp;
+            }
+        }
+    }
+    cref_t cr = clause_alloc(S, G->expl, n, 1);
+    clause_at(S, cr)->lbd = compute_lbd(S, G->expl, n);
+    attach_clause(S, cr);
+    learnts_push(S, cr);
+    return cr;
+}
+
+// Runs after CNF propagation is done. Returns a conflict clause in *confl
+// (having backjumped to its highest level), or enqueues what the XORs
+// imply. Returns 0 if the formula is UNSAT.
+static int gauss_propagate(solver_t *S, cref_t *confl) {
+    gauss_t *G = &S->gauss;
+    *confl = CREF_UNDEF;
+    for(; G->qhead < S->trail_sz; G->qhead++) G->dirty |= (G->var_col[S->trail[G->qhead]] >= 0);
+    if(!G->dirty) return 1;
+    G->dirty = 0;
+    S->stat_gauss_calls++;
+
+    int W = G->words;
+    memset(G->unassigned, 0, sizeof(uint64_t) * W);
+    memset(G->truth, 0, sizeof(uint64_t) * W);
+    for(int col = 0; col < G->n_cols; col++) {
+        val_t val = S->varinfo[G->col_var[col]].value;
+        if(val == VAL_UNASSIGNED) G->unassigned[col / 64] |= 1ull << (col % 64);
+        else if(val == VAL_TRUE) G->truth[col / 64] |= 1ull << (col % 64);
+    }
+
+    // rows whose pivot got assigned take another unassigned column of
+    // theirs as pivot, which is then eliminated from every other row
+    for(int r = 0; r < G->n_rows; r++) {
+        uint64_t *p = G->m + (size_t) r * W;
+        int col = G->pivot[r];
+        if(col >= 0 && (G->unassigned[col / 64] >> (col % 64) & 1)) continue;
+        col = -1;
+        for(int i = 0; i < W && col < 0; i++)
+            if(p[i] & G->unassigned[i]) col = i * 64 + __builtin_ctzll(p[i] & G->unassigned[i]);
+        G->pivot[r] = col;
+        if(col < 0) continue;
+        int w = col / 64;
+        uint64_t bit = 1ull << (col % 64);
+        for(int r2 = 0; r2 < G->n_rows; r2++) {
+            uint64_t *q = G->m + (size_t) r2 * W;
+            if(r2 == r || !(q[w] & bit)) continue;
+            for(int i = 0; i < W; i++) q[i] ^= p[i];
+            G->m_rhs[r2] ^= G->m_rhs[r];
+        }
+    }
+
+    // rows without a pivot have no unassigned variable left; they are
+    // either satisfied or a conflict. The others have their pivot and maybe
+    // more unassigned variables; with just the pivot, it is implied.
+    int ok = 1;
+    for(int pass = 0; pass < 2; pass++) {
+        for(int r = 0; r < G->n_rows; r++) {
+            if((G->pivot[r] >= 0) != pass) continue;
+            const uint64_t *row = G->m + (size_t) r * W;
+            int free_cols = 0, free_col = -1, parity = G->m_rhs[r];
+            for(int i = 0; i < W; i++) {
+                uint64_t u = row[i] & G->unassigned[i];
+                if(u) free_col = i * 64 + __builtin_ctzll(u);
+                free_cols += __builtin_popcountll(u);
+                parity ^= __builtin_popcountll(row[i] & G->truth[i]) & 1;
+            }
+            if(free_cols == 0 && parity) {
+                S->stat_gauss_conflicts++;
+                cref_t cr = gauss_explain(S, r, 0, &ok);
+                if(cr == CREF_UNDEF) return ok;
+                clause_t *c = clause_at(S, cr);
+                cancel_until(S, S->varinfo[var_of(c->lits[0])].level);
+                *confl = cr;
+                return 1;
+            }
+            if(free_cols == 1) {
+                // the pivot must make the row's parity come out right
+                int v = G->col_var[free_col];
+                int lit = parity ? v : -v;
+                S->stat_gauss_props++;
+                cref_t cr = gauss_explain(S, r, lit, &ok);
+                if(cr == CREF_UNDEF) return ok;
+                enqueue(S, lit, reason_of(S, cr));
+            }
+        }
+    }
+    if(S->stat_gauss_calls == GAUSS_PROBATION
+            && (S->stat_gauss_props + S->stat_gauss_conflicts) * 100 < GAUSS_PROBATION) {
+        if(PRINT_STATS) fprintf(stderr, "c gauss dropped; nothing CNF propagation misses\n");
+        G->active = 0;
+    }
+    return 1;
+}
+
+/***************************************************/
+/* MAIN SEARCH                                     */
+/***************************************************/
+// Returns 1 for SAT, 0 for UNSAT and -1 if another portfolio thread
+// finished first. UNSAT because of the assumptions leaves ok set.
+static int search_inner(solver_t *S) {
+    long long imported_at = -1;
+    while(1) {
+        cref_t confl = propagate(S);
+        if(confl == CREF_UNDEF && S->gauss.active) {
+            int trail_before = S->trail_sz, dl_before = S->current_dl;
+            if(!gauss_propagate(S, &confl)) return S->ok = 0;
+            // implied literals go through the clauses first
+            if(confl == CREF_UNDEF && (S->trail_sz != trail_before || S->current_dl != dl_before)) continue;
+        }
+        if(confl != CREF_UNDEF) {
+            S->conflict_ct++;
+            S->stat_conflicts++;
+            if(S->current_dl == 0) return S->ok = 0; // unsat
+            int btlevel = 0;
+            analyze(S, confl, &btlevel);
+            restart_on_conflict(S, S->learnt_lbd);
+            cancel_until(S, btlevel);
+            strengthen_reasons(S);
+            export_clause(S, S->learnt_arr, S->learnt_sz, S->learnt_lbd);
+            if(S->learnt_sz == 1) {
+                if(!enqueue(S, S->learnt_arr[0], CREF_UNDEF)) return S->ok = 0; // conflict at level0
+            } else {
+                cref_t cr = clause_alloc(S, S->learnt_arr, S->learnt_sz, 1);
+                clause_at(S, cr)->lbd = S->learnt_lbd;
+                clause_bump_activity(S, clause_at(S, cr));
+                attach_clause(S, cr);
+                learnts_push(S, cr);
+                enqueue(S, S->learnt_arr[0], reason_of(S, cr));
+                S->stat_learnt++;
+            }
+            clause_decay_activity(S);
+        } else {
+            if(S->pf) {
+                if(atomic_load_explicit(&S->pf->winner, memory_order_relaxed) >= 0) return -1;
+                // at most once per conflict; importing may backjump, so
+                // propagate again before deciding
+                if(imported_at != S->stat_conflicts) {
+                    imported_at = S->stat_conflicts;
+                    int trail_before = S->trail_sz, dl_before = S->current_dl;
+                    if(!import_clauses(S)) return S->ok = 0;
+                    if(S->trail_sz != trail_before || S->current_dl != dl_before) continue;
+                }
+            }
+
+            // the phases of the trail are saved when it is undone, so drop
+            // it before the round reads them
+            if(S->opts.ls && S->stat_conflicts >= S->next_ls) {
+                cancel_until(S, 0);
+                local_search(S);
+                S->next_ls = S->stat_conflicts + S->ls_interval;
+                S->ls_interval *= 2;
+                continue;
+            }
+
+            if(should_restart(S)) {
+                int lvl = restart_level(S);
+                S->stat_reused_levels += lvl;
+                S->conflict_ct = 0;
+                S->restart_ct++;
+                cancel_until(S, lvl);
+                continue;
+            }
+
+            if(S->opts.reduce && S->stat_conflicts >= S->next_reduce) {
+                S->reduce_interval += S->opts.reduce_inc;
+                S->next_reduce = S->stat_conflicts + S->reduce_interval;
+                reduce_db(S);
+            }
+
+            // assumptions first, one level each; one that already holds
+            // gets an empty level so level i+1 still belongs to assumption i
+            int next = 0;
+            while(S->current_dl < S->assumps.size) {
+                int p = S->assumps.data[S->current_dl];
+                if(value_lit(S, p) == VAL_TRUE) {
+                    S->current_dl++;
+                    S->trail_lim[S->current_dl] = S->trail_sz;
+                } else if(value_lit(S, p) == VAL_FALSE) {
+                    analyze_final(S, p);
+                    return 0;
+                } else {
+                    next = p;
+                    break;
+                }
+            }
+
+            // pick var +polarity; none left -> sat
+            if(!next) {
+                int var = decideVar(S);
+                if(!var) return 1; //  all assigned
+                next = pickPolarity(S, var);
+            }
+
+            // do a decision
+            S->current_dl++;
+            S->trail_lim[S->current_dl] = S->trail_sz;
+            S->stat_decisions++;
+            if(!enqueue(S, next, CREF_UNDEF)) return 0;
+        }
+    }
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#ifndef CDCL_LIBRARY
+static void print_stats(solver_t *S, double seconds) {
+    if(!PRINT_STATS) return;
+    fprintf(stderr, "c vars %u\n", S->n_vars);
+    fprintf(stderr, "c clauses %u\n", S->n_clauses);
+    fprintf(stderr, "c arena_bytes %zu\n", (size_t) S->arena_sz * sizeof(int));
+    fprintf(stderr, "c conflicts %lld\n", S->stat_conflicts);
+    fprintf(stderr, "c decisions %lld\n", S->stat_decisions);
+    fprintf(stderr, "c restarts %d\n", S->restart_ct);
+    fprintf(stderr, "c blocked_restarts %lld\n", S->stat_blocked_restarts);
+    fprintf(stderr, "c reused_levels %lld\n", S->stat_reused_levels);
+    fprintf(stderr, "c propagations %lld\n", S->stat_propagations);
+    fprintf(stderr, "c learnt %lld\n", S->stat_learnt);
+    fprintf(stderr, "c learnt_lits %lld\n", S->stat_learnt_lits);
+    fprintf(stderr, "c minimized_lits %lld\n", S->stat_minimized_lits);
+    fprintf(stderr, "c otfs_strengthened %lld\n", S->stat_otfs);
+    fprintf(stderr, "c learnt_live %d\n", S->n_learnts);
+    fprintf(stderr, "c reductions %lld\n", S->stat_reductions);
+    fprintf(stderr, "c reduce_kept %lld\n", S->stat_reduce_kept);
+    fprintf(stderr, "c reduce_glue %lld\n", S->stat_reduce_glue);
+    fprintf(stderr, "c reduce_dropped %lld\n", S->stat_reduce_dropped);
+    if(S->opts.ls) {
+        fprintf(stderr, "c ls_rounds %lld\n", S->stat_ls_rounds);
+        fprintf(stderr, "c ls_flips %lld\n", S->stat_ls_flips);
+        fprintf(stderr, "c ls_best_unsat %d\n", S->stat_ls_best);
+        fprintf(stderr, "c ls_seconds %.6f\n", S->stat_ls_seconds);
+        fprintf(stderr, "c ls_flips_per_sec %.0f\n",
+                S->stat_ls_seconds > 0 ? S->stat_ls_flips / S->stat_ls_seconds : 0.0);
+    }
+    if(S->gauss.n_rows) {
+        fprintf(stderr, "c gauss_rows %d\n", S->gauss.n_rows);
+        fprintf(stderr, "c gauss_cols %d\n", S->gauss.n_cols);
+        fprintf(stderr, "c gauss_calls %lld\n", S->stat_gauss_calls);
+        fprintf(stderr, "c gauss_props %lld\n", S->stat_gauss_props);
+        fprintf(stderr, "c gauss_conflicts %lld\n", S->stat_gauss_conflicts);
+    }
+    fprintf(stderr, "c gcs %lld\n", S->stat_gcs);
+    fprintf(stderr, "c gc_bytes %lld\n", S->stat_gc_bytes);
+    fprintf(stderr, "c pre_clauses_before %d\n", S->stat_pre_clauses_before);
+    fprintf(stderr, "c pre_clauses_after %d\n", S->stat_pre_clauses_after);
+    fprintf(stderr, "c pre_eliminated %lld\n", S->stat_pre_eliminated);
+    fprintf(stderr, "c pre_subsumed %lld\n", S->stat_pre_subsumed);
+    fprintf(stderr, "c pre_strengthened %lld\n", S->stat_pre_strengthened);
+    fprintf(stderr, "c pre_failed_literals %lld\n", S->stat_pre_failed);
+    fprintf(stderr, "c pre_probe_units %lld\n", S->stat_pre_probe_units);
+    fprintf(stderr, "c pre_seconds %.6f\n", S->stat_pre_seconds);
+    if(S->pf) {
+        fprintf(stderr, "c threads %d\n", S->pf->n_threads);
+        fprintf(stderr, "c winner %d\n", S->id);
+        fprintf(stderr, "c shared_exported %lld\n", S->stat_exported);
+        fprintf(stderr, "c shared_imported %lld\n", S->stat_imported);
+    }
+    if(S->cube_workers) {
+        fprintf(stderr, "c cube_workers %d\n", S->cube_workers);
+        fprintf(stderr, "c cubes %lld\n", S->stat_cubes);
+        fprintf(stderr, "c cubes_refuted %lld\n", S->stat_cubes_refuted);
+        fprintf(stderr, "c cubes_pruned %lld\n", S->stat_cubes_pruned);
+        fprintf(stderr, "c cube_seconds %.6f\n", S->stat_cube_seconds);
+    }
+    fprintf(stderr, "c solve_seconds %.6f\n", seconds);
+    fprintf(stderr, "c props_per_sec %.0f\n",
+            seconds > 0 ? S->stat_propagations / seconds : 0.0);
+}
+#endif
+
+/***************************************************/
+/* SOLVER SETUP                                    */
+/***************************************************/
+// trail_lim and level_stamp are indexed by decision level. Assumptions
+// that already hold get a level without a variable, so there can be more
+// than n_vars levels.
+static void grow_levels(solver_t *S, int n) {
+    if(n <= S->lim_cap) return;
+    S->lim_cap = (S->lim_cap * 2 > n) ? S->lim_cap * 2 : n;
+    S->trail_lim = (int*) realloc(S->trail_lim, sizeof(int) * S->lim_cap);
+    S->level_stamp = (int*) realloc(S->level_stamp, sizeof(int) * S->lim_cap);
+    memset(S->level_stamp, 0, sizeof(int) * S->lim_cap);
+    S->lbd_stamp = 0;
+}
+
+// Makes room for variables up to @n_vars. New variables start unassigned
+// and go into the decision heap.
+static void solver_grow(solver_t *S, unsigned n_vars) {
+    int first = (S->varinfo == NULL);
+    if(!first && n_vars <= S->n_vars) return;
+    if(first || n_vars > S->var_cap) {
+        size_t had = first ? 0 : S->var_cap + 1;
+        unsigned cap = (S->var_cap * 2 > n_vars) ? S->var_cap * 2 : n_vars;
+        size_t n = cap + 1;
+        S->varinfo = (varinfo_t*) realloc(S->varinfo, sizeof(varinfo_t) * n);
+        S->watches = (watchlist_t*) realloc(S->watches, sizeof(watchlist_t) * n * 2);
+        memset(S->watches + had * 2, 0, sizeof(watchlist_t) * (n - had) * 2);
+        S->bin_watches = (watchlist_t*) realloc(S->bin_watches, sizeof(watchlist_t) * n * 2);
+        memset(S->bin_watches + had * 2, 0, sizeof(watchlist_t) * (n - had) * 2);
+        S->activity = (double*) realloc(S->activity, sizeof(double) * n);
+        S->saved_phase = (char*) realloc(S->saved_phase, n);
+        S->eliminated = (char*) realloc(S->eliminated, n);
+        S->order_heap = (int*) realloc(S->order_heap, sizeof(int) * n);
+        S->heap_index = (int*) realloc(S->heap_index, sizeof(int) * n);
+        S->trail = (int*) realloc(S->trail, sizeof(int) * n * 2);
+        S->seen = (char*) realloc(S->seen, n);
+        S->an_stack = (int*) realloc(S->an_stack, sizeof(int) * n);
+        S->min_stack = (int*) realloc(S->min_stack, sizeof(int) * n);
+        S->learnt_arr = (int*) realloc(S->learnt_arr, sizeof(int) * n * 2);
+        S->var_cap = cap;
+    }
+    grow_levels(S, n_vars + 1);
+
+    unsigned from = first ? 0 : S->n_vars + 1;
+    for(unsigned i = from; i <= n_vars; i++) {
+        S->varinfo[i].value = VAL_UNASSIGNED;
+        S->varinfo[i].level = 0;
+        S->varinfo[i].reason = CREF_UNDEF;
+        S->activity[i] = 0.0;
+        S->saved_phase[i] = VAL_FALSE;
+        S->eliminated[i] = 0;
+        S->heap_index[i] = -1;
+        S->seen[i] = 0;
+        // thread 0 keeps the deterministic start; the others begin from a
+        // random phase and slightly shuffled activities so they diverge
+        // even with the same configuration
+        if(S->id > 0 && i > 0) {
+            S->saved_phase[i] = solver_rand(S) & 1;
+            S->activity[i] = (solver_rand(S) % 1024) * 1e-6;
+        }
+    }
+    S->n_vars = n_vars;
+    for(unsigned i = (from ? from : 1); i <= n_vars; i++) heap_insert_var(S, i);
+}
+
+static solver_t *solver_new(unsigned n_vars, const opts_t *opts, int id) {
+    solver_t *S = (solver_t*) calloc(1, sizeof(solver_t));
+    S->opts = *opts;
+    S->id = id;
+    S->rng = opts->seed ? opts->seed : 1;
+    S->ok = 1;
+    S->cla_inc = 1.0;
+    S->cla_decay = 0.999;
+    S->var_inc = 1.0;
+    S->var_decay = 0.8;
+    S->restart_interval = 50;
+    S->reduce_interval = opts->reduce_first;
+    S->next_reduce = opts->reduce_first;
+    S->ls_interval = LS_FIRST_INTERVAL;
+    bq_init(&S->lbd_queue, GLUCOSE_LBD_WINDOW);
+    bq_init(&S->trail_queue, GLUCOSE_TRAIL_WINDOW);
+    solver_grow(S, n_vars);
+    S->trail_lim[0] = 0;
+    return S;
+}
+
+static void solver_free(solver_t *S) {
+    for(unsigned i = 0; i < (S->var_cap + 1) * 2; i++) {
+        free(S->watches[i].data);
+        free(S->bin_watches[i].data);
+    }
+    free(S->watches);
+    free(S->bin_watches);
+    gauss_free(&S->gauss);
+    free(S->varinfo);
+    free(S->activity);
+    free(S->saved_phase);
+    free(S->eliminated);
+    free(S->order_heap);
+    free(S->heap_index);
+    free(S->trail);
+    free(S->trail_lim);
+    free(S->seen);
+    free(S->an_stack);
+    free(S->min_stack);
+    free(S->otfs.data);
+    free(S->learnt_arr);
+    free(S->level_stamp);
+    free(S->lbd_queue.data);
+    free(S->trail_queue.data);
+    free(S->arena);
+    free(S->learnts);
+    free(S->pre_clauses.data);
+    free(S->elim_stack.data);
+    free(S->elim_pos.data);
+    free(S->elim_neg.data);
+    free(S->clauses.data);
+    free(S->groups.data);
+    free(S->assumps.data);
+    free(S->core.data);
+    free(S->model);
+    free(S->ext2int);
+    free(S->int2ext);
+    free(S->import_pos);
+    free(S);
+}
+
+#ifndef CDCL_LIBRARY
+// Copies the clauses of a parsed DIMACS file into the arena; duplicates
+// are dropped, tautologies skipped and units assigned at level 0. Watches
+// are only attached once preprocessing is done with the clauses. Returns 0
+// if the input already contains a conflict.
+static int read_clauses(solver_t *S, dimacs_t *d) {
+    // every clause fits without growing the arena
+    size_t need = d->n_lits + (size_t) d->n_clauses * CLAUSE_HDR_INTS;
+    if(need > S->arena_cap) {
+        S->arena_cap = need;
+        S->arena = realloc(S->arena, sizeof(int) * S->arena_cap);
+        assert(S->arena);
+    }
+    int ok = 1;
+    for(unsigned i = 0; i < d->n_clauses; i++) {
+        int n, arrSz = 0, taut = 0;
+        int *arr = dimacs_clause(d, i, &n);
+        // dedupe in place; d is ours to scribble on
+        for(int j = 0; j < n; j++) {
+            int lit = arr[j], dup = 0;
+            for(int k = 0; k < arrSz; k++) {
+                if(arr[k] == lit) dup = 1;
+                if(arr[k] == -lit) taut = 1;
+            }
+            if(!dup) arr[arrSz++] = lit;
+        }
+        if(taut) continue;
+        if(arrSz == 0) ok = 0;
+        else if(arrSz == 1) {
+            if(!enqueue(S, arr[0], CREF_UNDEF)) ok = 0;
+        } else {
+            ivec_push(&S->pre_clauses, clause_alloc(S, arr, arrSz, 0));
+        }
+    }
+    return ok;
+}
+
+// Preprocesses the clauses read by read_clauses and attaches the ones that
+// are left. Returns 0 if the formula is UNSAT.
+static int simplify(solver_t *S) {
+    double t0 = now_seconds();
+    int ok = 1;
+    S->stat_pre_clauses_before = S->pre_clauses.size;
+    if(S->opts.preprocess && !preprocess(S)) ok = 0;
+    for(int i = 0; ok && i < S->pre_clauses.size; i++) {
+        if(clause_at(S, S->pre_clauses.data[i])->deleted) continue;
+        attach_clause(S, S->pre_clauses.data[i]);
+        S->stat_pre_clauses_after++;
+    }
+    free(S->pre_clauses.data);
+    S->pre_clauses = (ivec_t){ 0 };
+    if(ok && S->arena_wasted) garbage_collect(S);
+    if(ok && S->opts.preprocess && S->opts.probe && !probe(S)) ok = 0;
+    if(ok && S->opts.gauss) gauss_init(S);
+    S->stat_pre_seconds = now_seconds() - t0;
+    return ok;
+}
+
+// A fresh solver for portfolio thread @id over the formula @S0 ended up
+// with after simplify(): same compacted arena, level-0 units and
+// eliminated variables, but its own watches, heap and options.
+static solver_t *solver_clone(const solver_t *S0, const opts_t *opts, int id) {
+    solver_t *S = solver_new(S0->n_vars, opts, id);
+    assert(S0->arena_wasted == 0 && S0->n_learnts == 0);
+    S->n_clauses = S0->n_clauses;
+    S->arena = (int*) malloc(sizeof(int) * (S0->arena_sz + 1));
+    memcpy(S->arena, S0->arena, sizeof(int) * S0->arena_sz);
+    S->arena_sz = S->arena_cap = S0->arena_sz;
+    for(cref_t cr = 0; cr < (cref_t) S->arena_sz; cr += CLAUSE_HDR_INTS + clause_at(S, cr)->size)
+        attach_clause(S, cr);
+    // re-propagated by the first propagate() of the search
+    for(int i = 0; i < S0->trail_sz; i++) {
+        int v = S0->trail[i];
+        enqueue(S, S0->varinfo[v].value == VAL_TRUE ? v : -v, CREF_UNDEF);
+    }
+    memcpy(S->eliminated, S0->eliminated, S0->n_vars + 1);
+    if(opts->gauss) gauss_init(S);
+    S->elim_stack.size = S->elim_stack.cap = S0->elim_stack.size;
+    S->elim_stack.data = (int*) malloc(sizeof(int) * (S0->elim_stack.size + 1));
+    memcpy(S->elim_stack.data, S0->elim_stack.data, sizeof(int) * S0->elim_stack.size);
+
+    S->stat_pre_clauses_before = S0->stat_pre_clauses_before;
+    S->stat_pre_clauses_after = S0->stat_pre_clauses_after;
+    S->stat_pre_eliminated = S0->stat_pre_eliminated;
+    S->stat_pre_subsumed = S0->stat_pre_subsumed;
+    S->stat_pre_strengthened = S0->stat_pre_strengthened;
+    S->stat_pre_failed = S0->stat_pre_failed;
+    S->stat_pre_probe_units = S0->stat_pre_probe_units;
+    S->stat_pre_seconds = S0->stat_pre_seconds;
+    return S;
+}
+#endif
+
+/***************************************************/
+/* PORTFOLIO                                       */
+/***************************************************/
+#ifndef CDCL_LIBRARY
+// Thread i runs configuration i % 4 on top of the command line options,
+// with seed + i. Thread 0 is exactly the single-threaded solver.
+static opts_t portfolio_opts(const opts_t *base, int i) {
+    opts_t o = *base;
+    o.seed = base->seed + i;
+    switch(i % 4) {
+    case 0:
+        break;
+    case 1:
+        o.restart_policy = RESTART_LUBY;
+        break;
+    case 2:
+        o.polarity = POLARITY_FALSE;
+        o.reuse_trail = 0;
+        break;
+    case 3:
+        o.restart_policy = RESTART_GLUCOSE;
+        o.polarity = POLARITY_SAVE;
+        o.reuse_trail = 1;
+        break;
+    }
+    return o;
+}
+
+static void *portfolio_thread(void *arg) {
+    solver_t *S = (solver_t*) arg;
+    int ret = search_inner(S);
+    int none = -1;
+    if(ret >= 0 && atomic_compare_exchange_strong(&S->pf->winner, &none, S->id))
+        S->pf->result = ret;
+    return NULL;
+}
+
+// Runs @n_threads solvers on the formula @S0 holds and returns the one
+// that finished first; its answer is in pf->result.
+static solver_t *portfolio_solve(solver_t *S0, int n_threads) {
+    portfolio_t *pf = (portfolio_t*) calloc(1, sizeof(portfolio_t));
+    pf->n_threads = n_threads;
+    pf->bufs = (share_buf_t*) calloc(n_threads, sizeof(share_buf_t));
+    atomic_init(&pf->winner, -1);
+
+    solver_t **solvers = (solver_t**) malloc(sizeof(solver_t*) * n_threads);
+    pthread_t *tids = (pthread_t*) malloc(sizeof(pthread_t) * n_threads);
+    for(int i = 0; i < n_threads; i++) {
+        opts_t o = portfolio_opts(&S0->opts, i);
+        solvers[i] = i ? solver_clone(S0, &o, i) : S0;
+        solvers[i]->pf = pf;
+        solvers[i]->import_pos = (unsigned long long*) calloc(n_threads, sizeof(unsigned long long));
+    }
+    for(int i = 0; i < n_threads; i++) {
+        int err = pthread_create(&tids[i], NULL, portfolio_thread, solvers[i]);
+        if(err) {
+            fprintf(stderr, "cdcl: pthread_create: %s\n", strerror(err));
+            exit(1);
+        }
+    }
+    for(int i = 0; i < n_threads; i++) pthread_join(tids[i], NULL);
+
+    solver_t *winner = solvers[atomic_load(&pf->winner)];
+    free(tids);
+    free(solvers);
+    return winner;
+}
+#endif
+
+/***************************************************/
+/* CUBE AND CONQUER                                */
+/***************************************************/
+#ifndef CDCL_LIBRARY
+// -cube=N splits the simplified formula into cubes (conjunctions of
+// literals) and hands them to N worker processes, which solve the formula
+// under one cube at a time as assumptions. The formula is UNSAT once every
+// cube is refuted.
+//
+// The cuber is a DPLL descent from level 0 with a depth cutoff. At every
+// node it propagates both phases of the most frequent unassigned variables
+// at a fresh level each. A phase that conflicts is a failed literal, so
+// the other phase is forced. Of the rest, the variable whose two phases
+// assign the most in product (as in march) is split on. A node that
+// propagates to a conflict is refuted there and then and yields no cube.
+//
+// Each worker talks to the master over its own socketpair and needs
+// nothing else: here they are fork()ed and inherit the simplified formula.
+// The master keeps the cubes nobody has started and gives the next one to
+// whichever worker goes idle. Workers keep their learnt clauses from one
+// cube to the next. A refuted cube comes back with its failed assumptions,
+// and every queued cube that contains all of them is dropped unsolved. The
+// first SAT answer ends the run.
+#define CUBE_LOOKAHEAD_VARS 64      // candidates per node, most frequent first
+#define CUBE_PER_WORKER 16          // the default depth makes about this many each
+
+typedef struct {
+    ivec_t lits;            // every cube back to back
+    ivec_t start;           // cube i is lits[start[i] .. start[i + 1])
+    ivec_t path;            // the literals of the node being split
+    int *cands;             // variables by occurrence count, most first
+    int n_cands;
+} cuber_t;
+
+// what a worker sends back for a cube; n_core literals follow, then for
+// SAT the value of every variable
+typedef struct {
+    int result;             // 1 SAT, 0 cube refuted, -1 formula UNSAT
+    int n_core;
+    long long conflicts, decisions, propagations;
+} cube_reply_t;
+
+static int occ_cmp(const void *a, const void *b) {
+    const int *x = (const int*) a, *y = (const int*) b;
+    if(x[0] != y[0]) return (x[0] < y[0]) ? 1 : -1;
+    return x[1] - y[1];
+}
+
+// Number of variables @lit assigns by propagation at a new level, or -1 if
+// it fails.
+static int lookahead(solver_t *S, int lit) {
+    int before = S->trail_sz;
+    S->current_dl++;
+    S->trail_lim[S->current_dl] = S->trail_sz;
+    enqueue(S, lit, CREF_UNDEF);
+    int n = (propagate(S) == CREF_UNDEF) ? S->trail_sz - before : -1;
+    cancel_until(S, S->current_dl - 1);
+    return n;
+}
+
+// Splits the node reached by C->path (already on the trail, not yet
+// propagated) @depth more levels and appends its cubes.
+static void cube_split(solver_t *S, cuber_t *C, int depth) {
+    int path_sz = C->path.size, best = 0;
+    double best_score = -1;
+    if(propagate(S) != CREF_UNDEF) goto refuted;
+    for(int i = 0, looked = 0; depth > 0 && i < C->n_cands && looked < CUBE_LOOKAHEAD_VARS; i++) {
+        int v = C->cands[i];
+        if(S->varinfo[v].value != VAL_UNASSIGNED) continue;
+        looked++;
+        int pos = lookahead(S, v), neg = lookahead(S, -v);
+        if(pos < 0 && neg < 0) goto refuted;
+        if(pos < 0 || neg < 0) {
+            // at level 0 a failed literal is a unit for good
+            int forced = (pos < 0) ? -v : v;
+            enqueue(S, forced, CREF_UNDEF);
+            if(S->current_dl > 0) ivec_push(&C->path, forced);
+            if(propagate(S) != CREF_UNDEF) goto refuted;
+            continue;
+        }
+        // the phase that assigns less goes first: less constrained, more
+        // likely to hold a model
+        double score = (double) (pos + 1) * (neg + 1);
+        if(score > best_score) {
+            best_score = score;
+            best = (pos <= neg) ? v : -v;
+        }
+    }
+
+    if(!best) {
+        // a leaf; if nothing is left to assign, the cube is a model
+        for(int i = 0; i < C->path.size; i++) ivec_push(&C->lits, C->path.data[i]);
+        ivec_push(&C->start, C->lits.size);
+        S->stat_cubes++;
+    } else {
+        for(int side = 0; side < 2; side++) {
+            int lit = side ? -best : best;
+            S->current_dl++;
+            S->trail_lim[S->current_dl] = S->trail_sz;
+            enqueue(S, lit, CREF_UNDEF);
+            ivec_push(&C->path, lit);
+            cube_split(S, C, depth - 1);
+            C->path.size--;
+            cancel_until(S, S->current_dl - 1);
+            if(!S->ok) break;
+        }
+    }
+    C->path.size = path_sz;
+    return;
+
+refuted:
+    if(S->current_dl == 0) S->ok = 0;
+    S->stat_cubes_refuted++;
+    C->path.size = path_sz;
+}
+
+// Reads or writes exactly @n bytes; 0 if the other end went away.
+static int read_full(int fd, void *buf, size_t n) {
+    for(char *p = (char*) buf; n; ) {
+        ssize_t r = read(fd, p, n);
+        if(r < 0 && errno == EINTR) continue;
+        if(r <= 0) return 0;
+        p += r;
+        n -= r;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const void *buf, size_t n) {
+    for(const char *p = (const char*) buf; n; ) {
+        ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+        if(r < 0 && errno == EINTR) continue;
+        if(r <= 0) return 0;
+        p += r;
+        n -= r;
+    }
+    return 1;
+}
+
+// A worker's life: solve each cube the master sends until it hangs up.
+static void cube_worker(solver_t *S, int fd) {
+    int n;
+    char *model = (char*) malloc(S->n_vars + 1);
+    while(read_full(fd, &n, sizeof(int))) {
+        cancel_until(S, 0);
+        S->assumps.size = 0;
+        for(int i = 0, lit; i < n; i++) {
+            if(!read_full(fd, &lit, sizeof(int))) _exit(1);
+            ivec_push(&S->assumps, lit);
+        }
+        grow_levels(S, S->n_vars + S->assumps.size + 1);
+        S->core.size = 0;
+        int ret = S->ok ? search_inner(S) : 0;
+        cube_reply_t rep = {
+            .result = (ret == 0 && !S->ok) ? -1 : ret,
+            .n_core = (ret == 0 && S->ok) ? S->core.size : 0,
+            .conflicts = S->stat_conflicts,
+            .decisions = S->stat_decisions,
+            .propagations = S->stat_propagations,
+        };
+        if(!write_full(fd, &rep, sizeof(rep)) ||
+           !write_full(fd, S->core.data, sizeof(int) * rep.n_core))
+            break;
+        if(ret == 1) {
+            for(unsigned v = 0; v <= S->n_vars; v++) model[v] = S->varinfo[v].value;
+            if(!write_full(fd, model, S->n_vars + 1)) break;
+        }
+    }
+    free(model);
+}
+
+// 1 if cube @c contains every literal of @core.
+static int cube_covers(const cuber_t *C, int c, const int *core, int n_core) {
+    const int *lits = C->lits.data + C->start.data[c];
+    int n = C->start.data[c + 1] - C->start.data[c];
+    for(int i = 0; i < n_core; i++) {
+        int found = 0;
+        for(int j = 0; j < n && !found; j++) found = (lits[j] == core[i]);
+        if(!found) return 0;
+    }
+    return 1;
+}
+
+// Solves the simplified formula @S with @n_workers processes over cubes
+// @depth levels deep (0: pick one). Returns 1 for SAT, with the model in
+// S->varinfo, or 0 for UNSAT.
+static int cube_solve(solver_t *S, int n_workers, int depth) {
+    double t0 = now_seconds();
+    if(depth <= 0)
+        for(depth = 0; (1 << depth) < n_workers * CUBE_PER_WORKER && depth < 24; depth++)
+            ;
+    S->cube_workers = n_workers;
+
+    cuber_t C = { 0 };
+    int *occ = (int*) calloc((S->n_vars + 1) * 2, sizeof(int));
+    ivec_t crs = { 0 };
+    problem_clauses(S, &crs);
+    for(int i = 0; i < crs.size; i++) {
+        clause_t *c = clause_at(S, crs.data[i]);
+        for(int k = 0; k < c->size; k++) occ[2 * var_of(c->lits[k])]++;
+    }
+    free(crs.data);
+    for(unsigned v = 1; v <= S->n_vars; v++) occ[2 * v + 1] = v;
+    qsort(occ + 2, S->n_vars, 2 * sizeof(int), occ_cmp);
+    C.cands = (int*) malloc(sizeof(int) * (S->n_vars + 1));
+    for(unsigned i = 1; i <= S->n_vars && occ[2 * i]; i++) C.cands[C.n_cands++] = occ[2 * i + 1];
+    free(occ);
+
+    ivec_push(&C.start, 0);
+    grow_levels(S, depth + 2);
+    cube_split(S, &C, depth);
+    free(C.cands);
+    free(C.path.data);
+    S->stat_cube_seconds = now_seconds() - t0;
+    int n_cubes = C.start.size - 1, result = 0;
+    if(!S->ok || !n_cubes) goto done;
+
+    // fork the workers; each keeps only its own end of its socket
+    pid_t *pids = (pid_t*) malloc(sizeof(pid_t) * n_workers);
+    int *fds = (int*) malloc(sizeof(int) * n_workers);
+    int *busy = (int*) malloc(sizeof(int) * n_workers);     // its cube, or -1
+    long long (*totals)[3] = calloc(n_workers, sizeof(*totals));
+    fflush(stdout);
+    fflush(stderr);
+    for(int w = 0; w < n_workers; w++) {
+        int sv[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            perror("cdcl: socketpair");
+            exit(1);
+        }
+        pids[w] = fork();
+        if(pids[w] < 0) {
+            perror("cdcl: fork");
+            exit(1);
+        }
+        if(!pids[w]) {
+            for(int u = 0; u < w; u++) close(fds[u]);
+            close(sv[0]);
+            S->opts = portfolio_opts(&S->opts, w);
+            S->rng = S->opts.seed ? S->opts.seed : 1;
+            // the master counts the cuber's work; report only ours
+            S->stat_conflicts = S->stat_decisions = S->stat_propagations = 0;
+            cube_worker(S, sv[1]);
+            _exit(0);
+        }
+        close(sv[1]);
+        fds[w] = sv[0];
+        busy[w] = -1;
+    }
+
+    // 0 queued, 1 running, 2 done
+    char *state = (char*) calloc(n_cubes, 1);
+    int next = 0, n_done = 0, n_live = n_workers;
+    int *core = (int*) malloc(sizeof(int) * (S->n_vars + 1));
+    char *model = (char*) malloc(S->n_vars + 1);
+    struct pollfd *pfds = (struct pollfd*) malloc(sizeof(struct pollfd) * n_workers);
+    while(n_done < n_cubes) {
+        // hand out cubes to idle workers
+        for(int w = 0; w < n_workers; w++) {
+            if(fds[w] < 0 || busy[w] >= 0) continue;
+            while(next < n_cubes && state[next]) next++;
+            if(next == n_cubes) break;
+            int n = C.start.data[next + 1] - C.start.data[next];
+            if(!write_full(fds[w], &n, sizeof(int)) ||
+               !write_full(fds[w], C.lits.data + C.start.data[next], sizeof(int) * n))
+                continue;   // dead; poll reports the hangup
+            state[next] = 1;
+            busy[w] = next++;
+        }
+
+        for(int w = 0; w < n_workers; w++) {
+            pfds[w].fd = fds[w];
+            pfds[w].events = POLLIN;
+        }
+        if(poll(pfds, n_workers, -1) < 0) {
+            if(errno == EINTR) continue;
+            perror("cdcl: poll");
+            exit(1);
+        }
+        for(int w = 0; w < n_workers; w++) {
+            if(fds[w] < 0 || !pfds[w].revents) continue;
+            cube_reply_t rep;
+            int c = busy[w];
+            if(!read_full(fds[w], &rep, sizeof(rep)) ||
+               !read_full(fds[w], core, sizeof(int) * rep.n_core) ||
+               (rep.result == 1 && !read_full(fds[w], model, S->n_vars + 1))) {
+                // crashed or killed; someone else gets its cube
+                fprintf(stderr, "c cube worker %d died\n", w);
+                close(fds[w]);
+                fds[w] = -1;
+                if(c >= 0) {
+                    state[c] = 0;
+                    if(c < next) next = c;
+                }
+                if(!--n_live) {
+                    fprintf(stderr, "cdcl: no cube workers left\n");
+                    exit(1);
+                }
+                continue;
+            }
+            totals[w][0] = rep.conflicts;
+            totals[w][1] = rep.decisions;
+            totals[w][2] = rep.propagations;
+            busy[w] = -1;
+            if(rep.result != 0) {
+                result = rep.result;
+                if(result == 1)
+                    for(unsigned v = 1; v <= S->n_vars; v++) S->varinfo[v].value = (val_t) model[v];
+                goto stop;
+            }
+            state[c] = 2;
+            n_done++;
+            // whatever else contains the failed assumptions is refuted too
+            for(int d = next; d < n_cubes; d++) {
+                if(state[d] || !cube_covers(&C, d, core, rep.n_core)) continue;
+                state[d] = 2;
+                n_done++;
+                S->stat_cubes_pruned++;
+            }
+        }
+    }
+
+stop:
+    if(result < 0) result = 0;
+    for(int w = 0; w < n_workers; w++) {
+        kill(pids[w], SIGKILL);
+        waitpid(pids[w], NULL, 0);
+        if(fds[w] >= 0) close(fds[w]);
+        S->stat_conflicts += totals[w][0];
+        S->stat_decisions += totals[w][1];
+        S->stat_propagations += totals[w][2];
+    }
+    free(pids);
+    free(fds);
+    free(busy);
+    free(totals);
+    free(state);
+    free(core);
+    free(model);
+    free(pfds);
+done:
+    free(C.lits.data);
+    free(C.start.data);
+    return result;
+}
+#endif
+
+/***************************************************/
+/* LIBRARY INTERFACE (cdcl.h)                       */
+/***************************************************/
+// The caller's variables are mapped to ours on first use, so that the
+// selector variables of cdcl_push groups can never collide with theirs.
+// A clause added inside a group gets the negated selector appended and
+// every solve assumes the selectors of the open groups; cdcl_pop sets the
+// selector FALSE for good, which satisfies the group's clauses and every
+// clause learnt from them.
+cdcl_t *cdcl_new(void) {
+    opts_t opts = DEFAULT_OPTS;
+    opts.preprocess = 0;
+    // incremental queries share most of their clauses, so keep the phases
+    // and as much of the trail as the heap allows from one to the next
+    opts.restart_policy = RESTART_GLUCOSE;
+    opts.polarity = POLARITY_SAVE;
+    opts.reuse_trail = 1;
+    opts.seed = 1;
+    return solver_new(0, &opts, 0);
+}
+
+void cdcl_delete(cdcl_t *S) { solver_free(S); }
+
+static int new_var(solver_t *S, int ext) {
+    int v = S->n_vars + 1;
+    solver_grow(S, v);
+    S->int2ext = (int*) realloc(S->int2ext, sizeof(int) * (S->var_cap + 1));
+    S->int2ext[v] = ext;
+    return v;
+}
+
+static int map_lit(solver_t *S, int lit) {
+    unsigned ext = var_of(lit);
+    if(ext >= S->ext_cap) {
+        unsigned cap = (S->ext_cap * 2 > ext + 1) ? S->ext_cap * 2 : ext + 1;
+        S->ext2int = (int*) realloc(S->ext2int, sizeof(int) * cap);
+        memset(S->ext2int + S->ext_cap, 0, sizeof(int) * (cap - S->ext_cap));
+        S->ext_cap = cap;
+    }
+    if(!S->ext2int[ext]) S->ext2int[ext] = new_var(S, ext);
+    return (lit > 0) ? S->ext2int[ext] : -S->ext2int[ext];
+}
+
+// Adds a clause over our variables at level 0. Literals already FALSE at
+// level 0 are dropped; a clause already TRUE there is not added at all.
+static void add_clause_internal(solver_t *S, int *lits, int n) {
+    int j = 0;
+    for(int i = 0; i < n; i++) {
+        int dup = 0;
+        for(int k = 0; k < j; k++) {
+            if(lits[k] == -lits[i]) return; // tautology
+            if(lits[k] == lits[i]) dup = 1;
+        }
+        val_t val = value_lit(S, lits[i]);
+        if(val == VAL_TRUE) return;
+        if(dup || val == VAL_FALSE) continue;
+        lits[j++] = lits[i];
+    }
+    if(j == 0) S->ok = 0;
+    else if(j == 1) S->ok = enqueue(S, lits[0], CREF_UNDEF);
+    else {
+        cref_t cr = clause_alloc(S, lits, j, 0);
+        attach_clause(S, cr);
+        ivec_push(&S->clauses, cr);
+    }
+}
+
+void cdcl_add_clause(cdcl_t *S, const int *lits, int n) {
+    if(!S->ok) return;
+    int *buf = (int*) malloc(sizeof(int) * (n + 1));
+    for(int i = 0; i < n; i++) buf[i] = map_lit(S, lits[i]);
+    if(S->groups.size) buf[n++] = -S->groups.data[S->groups.size - 1];
+    cancel_until(S, 0);
+    add_clause_internal(S, buf, n);
+    free(buf);
+}
+
+int cdcl_solve(cdcl_t *S, const int *assumps, int n) {
+    S->core.size = 0;
+    if(!S->ok) return 0;
+    cancel_until(S, 0);
+    S->assumps.size = 0;
+    for(int i = 0; i < S->groups.size; i++) ivec_push(&S->assumps, S->groups.data[i]);
+    for(int i = 0; i < n; i++) ivec_push(&S->assumps, map_lit(S, assumps[i]));
+    grow_levels(S, S->n_vars + S->assumps.size + 1);
+
+    int ret = search_inner(S);
+    if(ret == 1) {
+        if(S->model_sz < S->n_vars + 1) {
+            S->model_sz = S->var_cap + 1;
+            S->model = (char*) realloc(S->model, S->model_sz);
+        }
+        for(unsigned v = 1; v <= S->n_vars; v++) S->model[v] = S->varinfo[v].value;
+    }
+    // drop the selectors from the core; the caller never assumed them
+    int j = 0;
+    for(int i = 0; i < S->core.size; i++) {
+        int ext = S->int2ext[var_of(S->core.data[i])];
+        if(ext) S->core.data[j++] = (S->core.data[i] > 0) ? ext : -ext;
+    }
+    S->core.size = j;
+    cancel_until(S, 0);
+    S->assumps.size = 0;
+    return ret;
+}
+
+int cdcl_value(cdcl_t *S, int lit) {
+    unsigned ext = var_of(lit);
+    if(ext >= S->ext_cap || !S->ext2int[ext]) return lit < 0;
+    int v = S->ext2int[ext];
+    if((unsigned) v >= S->model_sz) return lit < 0;
+    return (S->model[v] == VAL_TRUE) == (lit > 0);
+}
+
+int cdcl_core(cdcl_t *S, const int **lits) {
+    *lits = S->core.data;
+    return S->core.size;
+}
+
+int cdcl_failed(cdcl_t *S, int lit) {
+    for(int i = 0; i < S->core.size; i++)
+        if(S->core.data[i] == lit) return 1;
+    return 0;
+}
+
+void cdcl_push(cdcl_t *S) {
+    ivec_push(&S->groups, new_var(S, 0));
+}
+
+// Deletes the clauses in crs[0..n) that are TRUE at level 0 and returns
+// how many are left.
+static int remove_satisfied(solver_t *S, cref_t *crs, int n) {
+    int j = 0;
+    for(int i = 0; i < n; i++) {
+        clause_t *c = clause_at(S, crs[i]);
+        int sat = 0;
+        for(int k = 0; k < c->size && !sat; k++) sat = (value_lit(S, c->lits[k]) == VAL_TRUE);
+        if(sat && !locked(S, crs[i])) {
+            c->deleted = 1;
+            S->arena_wasted += CLAUSE_HDR_INTS + c->size;
+        } else {
+            crs[j++] = crs[i];
+        }
+    }
+    return j;
+}
+
+// Also deletes every clause that is now TRUE at level 0, i.e. the group's
+// clauses and the learnt clauses that depended on them.
+void cdcl_pop(cdcl_t *S) {
+    assert(S->groups.size > 0);
+    int sel = S->groups.data[--S->groups.size];
+    cancel_until(S, 0);
+    enqueue(S, -sel, CREF_UNDEF);
+
+    S->clauses.size = remove_satisfied(S, S->clauses.data, S->clauses.size);
+    S->n_learnts = remove_satisfied(S, S->learnts, S->n_learnts);
+    if(S->arena_wasted > S->arena_sz / 5) garbage_collect(S);
+}
+
+/***************************************************/
+/* MAIN                                          */
+/***************************************************/
+#ifndef CDCL_LIBRARY
+int main(int argc, char** argv) {
+    opts_t opts = DEFAULT_OPTS;
+    opts.seed = time(NULL);
+    int n_threads = 1, n_cube = 0, cube_depth = 0;
+    const char *path = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(argv[i][0] != '-' || !strcmp(argv[i], "-")) path = argv[i];
+        else if(!strcmp(argv[i], "-s")) PRINT_STATS = 1;
+        else if(!strcmp(argv[i], "-no-reduce")) opts.reduce = 0;
+        else if(!strncmp(argv[i], "-reduce-first=", 14)) opts.reduce_first = atoi(argv[i] + 14);
+        else if(!strncmp(argv[i], "-reduce-inc=", 12)) opts.reduce_inc = atoi(argv[i] + 12);
+        else if(!strncmp(argv[i], "-glue=", 6)) opts.glue_lbd = atoi(argv[i] + 6);
+        else if(!strcmp(argv[i], "-restart=geom")) opts.restart_policy = RESTART_GEOM;
+        else if(!strcmp(argv[i], "-restart=luby")) opts.restart_policy = RESTART_LUBY;
+        else if(!strcmp(argv[i], "-restart=glucose")) opts.restart_policy = RESTART_GLUCOSE;
+        else if(!strncmp(argv[i], "-restart-unit=", 14)) opts.restart_unit = atoi(argv[i] + 14);
+        else if(!strcmp(argv[i], "-reuse-trail")) opts.reuse_trail = 1;
+        else if(!strcmp(argv[i], "-no-reuse-trail")) opts.reuse_trail = 0;
+        else if(!strcmp(argv[i], "-polarity=save")) opts.polarity = POLARITY_SAVE;
+        else if(!strcmp(argv[i], "-polarity=random")) opts.polarity = POLARITY_RANDOM;
+        else if(!strcmp(argv[i], "-polarity=false")) opts.polarity = POLARITY_FALSE;
+        else if(!strcmp(argv[i], "-no-pre")) opts.preprocess = 0;
+        else if(!strcmp(argv[i], "-no-elim")) opts.elim = 0;
+        else if(!strcmp(argv[i], "-no-probe")) opts.probe = 0;
+        else if(!strcmp(argv[i], "-no-minimize")) opts.minimize = 0;
+        else if(!strcmp(argv[i], "-no-otfs")) opts.otfs = 0;
+        else if(!strcmp(argv[i], "-no-gauss")) opts.gauss = 0;
+        else if(!strcmp(argv[i], "-ls")) opts.ls = 1;
+        else if(!strncmp(argv[i], "-ls-flips=", 10)) opts.ls_flips = atoi(argv[i] + 10);
+        else if(!strncmp(argv[i], "-threads=", 9)) n_threads = atoi(argv[i] + 9);
+        else if(!strncmp(argv[i], "-cube=", 6)) n_cube = atoi(argv[i] + 6);
+        else if(!strncmp(argv[i], "-cube-depth=", 12)) cube_depth = atoi(argv[i] + 12);
+        else if(!strncmp(argv[i], "-share-lbd=", 11)) opts.share_lbd = atoi(argv[i] + 11);
+        else if(!strncmp(argv[i], "-share-size=", 12)) opts.share_size = atoi(argv[i] + 12);
+        else if(!strncmp(argv[i], "-seed=", 6)) opts.seed = strtoul(argv[i] + 6, NULL, 0);
+        else {
+            fprintf(stderr, "cdcl: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(n_threads < 1) n_threads = 1;
+    if(n_cube > 0 && n_threads > 1) {
+        fprintf(stderr, "cdcl: -cube and -threads don't combine\n");
+        return 1;
+    }
+    if(opts.share_size > SHARE_MAX_SIZE) opts.share_size = SHARE_MAX_SIZE;
+
+    double t_parse = now_seconds();
+    dimacs_t dimacs;
+    if(!dimacs_read(&dimacs, path)) return 1;
+
+    solver_t *S = solver_new(dimacs.n_vars, &opts, 0);
+    S->n_clauses = dimacs.n_clauses;
+    int unsat = !read_clauses(S, &dimacs);
+    dimacs_free(&dimacs);
+    t_parse = now_seconds() - t_parse;
+    if(!unsat && !simplify(S)) unsat = 1;
+
+    // solve
+    double t0 = now_seconds();
+    int ret;
+    if(unsat) ret = 0;
+    else if(n_cube > 0) ret = cube_solve(S, n_cube, cube_depth);
+    else if(n_threads == 1) ret = search_inner(S);
+    else {
+        S = portfolio_solve(S, n_threads);
+        ret = S->pf->result;
+    }
+    if(PRINT_STATS) fprintf(stderr, "c parse_seconds %.6f\n", t_parse);
+    print_stats(S, now_seconds() - t0);
+    if(!ret) {
+        printf("UNSAT\n");
+        return 0;
+    }
+    extend_model(S);
+    // final check -> sat
+    printf("SAT\n");
+    for(unsigned v = 1; v <= S->n_vars; v++) {
+        if(S->varinfo[v].value == VAL_TRUE) printf("%u ", v);
+        else printf("-%u ", v);
     }
     printf("\n");
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+// Incremental interface to the CDCL solver in cdcl.c. Build libcdcl.a
+// (make libcdcl.a) and link against it; cdcl.c compiled with
+// -DCDCL_LIBRARY has no main().
+//
+// Literals are DIMACS-style ints: v > 0 is variable v, -v its negation.
+// Variables are created the first time a clause or assumption mentions
+// them. Learnt clauses are kept from one cdcl_solve() to the next.
+//
+// A library solver never preprocesses: variable elimination is not sound
+// once more clauses can arrive later.
+
+typedef struct cdcl cdcl_t;
+
+cdcl_t *cdcl_new(void);
+void cdcl_delete(cdcl_t *S);
+
+// Adds the clause lits[0..n). Inside a cdcl_push() group, the clause
+// is removed again by the matching cdcl_pop().
+void cdcl_add_clause(cdcl_t *S, const int *lits, int n);
+#define cdcl_clause(S, ...) \
+    cdcl_add_clause((S), (int[]){__VA_ARGS__}, sizeof((int[]){__VA_ARGS__}) / sizeof(int))
+
+// Solves the clauses under the assumptions assumps[0..n), which only hold
+// for this call. Returns 1 for SAT and 0 for UNSAT.
+int cdcl_solve(cdcl_t *S, const int *assumps, int n);
+
+// After cdcl_solve() returned 1: 1 if @lit is true in the model, else 0.
+int cdcl_value(cdcl_t *S, int lit);
+
+// After cdcl_solve() returned 0: the assumptions that together make the
+// clauses UNSAT (a subset of the ones passed in, not necessarily minimal).
+// It is empty if the clauses are UNSAT without any assumptions.
+int cdcl_core(cdcl_t *S, const int **lits);
+// 1 if assumption @lit is in that core.
+int cdcl_failed(cdcl_t *S, int lit);
+
+// Opens a clause group. Clauses added before the matching cdcl_pop() are
+// dropped by that cdcl_pop(). Groups nest.
+void cdcl_push(cdcl_t *S);
+void cdcl_pop(cdcl_t *S);
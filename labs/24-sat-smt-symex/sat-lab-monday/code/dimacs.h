@@ -0,0 +1,301 @@
+#pragma once
+/**********************************************************
+ * DIMACS CNF reader shared by basic.c, fast.c, loop.c and cdcl.c
+ *
+ * The input is never run through stdio: a regular file (including
+ * stdin redirected from one) is mmap'd, anything else is read in large
+ * blocks. A hand-written scanner then passes over the text twice: once
+ * to count clauses and literals, once to fill a single literal array
+ * sized by the first pass. Gzip input (recognized by its magic bytes)
+ * stays compressed in memory; each pass inflates it through zlib a block
+ * at a time and scans the blocks as they come. Clause i is
+ *     lits[start[i]] .. lits[start[i + 1] - 1]
+ * without the terminating 0. Literals are stored as read; duplicates
+ * and tautologies are left to the solver.
+ *
+ * Comment lines may appear anywhere. Reading stops after as many clauses
+ * as the header promises, or at a line starting with '%': the SATLIB uf*
+ * files have junk after the last clause. n_vars is the larger of the
+ * header's count and the largest variable actually used.
+ *
+ * Build with -DDIMACS_NO_ZLIB to drop the zlib dependency (gzip input
+ * is then rejected).
+ **********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifndef DIMACS_NO_ZLIB
+#include <zlib.h>
+#endif
+
+typedef struct {
+    unsigned n_vars;
+    unsigned n_clauses;
+    size_t n_lits;
+    int *lits;          // every clause back to back
+    size_t *start;      // n_clauses + 1 offsets into lits
+
+    // the raw text (still compressed if gzip'd); mmap'd or malloc'd
+    const char *text;
+    size_t text_sz;
+    int text_mapped;
+} dimacs_t;
+
+#define DIMACS_BLOCK (1 << 20)
+
+static inline int *dimacs_clause(const dimacs_t *d, unsigned i, int *n) {
+    *n = (int) (d->start[i + 1] - d->start[i]);
+    return d->lits + d->start[i];
+}
+
+// Reads all of @fd into a malloc'd buffer, DIMACS_BLOCK bytes at a time.
+static char *dimacs_slurp(int fd, size_t *sz) {
+    size_t cap = DIMACS_BLOCK, n = 0;
+    char *buf = (char*) malloc(cap);
+    while(1) {
+        if(n == cap) buf = (char*) realloc(buf, cap *= 2);
+        ssize_t r = read(fd, buf + n, cap - n);
+        if(r < 0) {
+            free(buf);
+            return NULL;
+        }
+        if(r == 0) break;
+        n += r;
+    }
+    *sz = n;
+    return buf;
+}
+
+static inline int dimacs_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline const char *dimacs_eol(const char *p, const char *end) {
+    const char *nl = (const char*) memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+// Where a pass over the text is between two chunks of it. Every chunk but
+// the last ends with a newline, so no line is split between two.
+typedef struct {
+    int fill;               // store the literals, or only count them
+    unsigned max_var;
+    size_t n_lits, n_clauses, clause_start, hdr_clauses;
+    size_t offset;          // of the chunk in the whole text
+    int line_start;
+    int done;               // the header's clauses are all read, or '%'
+} dimacs_scan_t;
+
+#define DIMACS_SCAN_INIT(FILL) { .fill = (FILL), .hdr_clauses = (size_t) -1, .line_start = 1 }
+
+// Scans the chunk [@p, @end). Without s->fill only counts; with it also
+// stores the literals into d->lits / d->start, which the counting pass
+// sized.
+static int dimacs_scan_chunk(dimacs_t *d, dimacs_scan_t *s, const char *p, const char *end) {
+    const char *chunk = p;
+    while(p < end && !s->done) {
+        char c = *p;
+        if(dimacs_space(c)) {
+            s->line_start = (c == '\n');
+            p++;
+            continue;
+        }
+        if(s->line_start && (c == 'c' || c == 'p')) {
+            if(c == 'p') {
+                unsigned v = 0, cl = 0;
+                char hdr[64];
+                size_t len = dimacs_eol(p, end) - p;
+                if(len >= sizeof(hdr)) len = sizeof(hdr) - 1;
+                memcpy(hdr, p, len);
+                hdr[len] = 0;
+                if(sscanf(hdr, "p cnf %u %u", &v, &cl) != 2 || v > INT_MAX) {
+                    fprintf(stderr, "dimacs: bad header: %s", hdr);
+                    return 0;
+                }
+                if(v > s->max_var) s->max_var = v;
+                s->hdr_clauses = cl;
+            }
+            p = dimacs_eol(p, end);
+            continue;
+        }
+        if(s->n_clauses == s->hdr_clauses || (s->line_start && c == '%')) {
+            s->done = 1;
+            break;
+        }
+        s->line_start = 0;
+
+        int neg = (c == '-');
+        if(neg) p++;
+        if(p == end || (unsigned) (*p - '0') > 9) {
+            fprintf(stderr, "dimacs: unexpected '%c' at byte %zu\n",
+                    (p < end) ? *p : '?', s->offset + (size_t) (p - chunk));
+            return 0;
+        }
+        const char *num = p;
+        unsigned v = 0;
+        for(; p < end && (unsigned) (*p - '0') <= 9; p++) {
+            unsigned digit = *p - '0';
+            if(v > (INT_MAX - digit) / 10) {
+                fprintf(stderr, "dimacs: variable out of range at byte %zu\n",
+                        s->offset + (size_t) (num - chunk));
+                return 0;
+            }
+            v = v * 10 + digit;
+        }
+        if(!v) {
+            if(s->fill) d->start[s->n_clauses] = s->clause_start;
+            s->n_clauses++;
+            s->clause_start = s->n_lits;
+            continue;
+        }
+        if(v > s->max_var) s->max_var = v;
+        if(s->fill) d->lits[s->n_lits] = neg ? -(int) v : (int) v;
+        s->n_lits++;
+    }
+    s->offset += end - chunk;
+    return 1;
+}
+
+// Ends a pass: takes a last clause without its 0, and the counts.
+static void dimacs_scan_end(dimacs_t *d, dimacs_scan_t *s) {
+    if(s->n_lits > s->clause_start) {
+        if(s->fill) d->start[s->n_clauses] = s->clause_start;
+        s->n_clauses++;
+    }
+    if(s->fill) d->start[s->n_clauses] = s->n_lits;
+    d->n_vars = s->max_var;
+    d->n_clauses = s->n_clauses;
+    d->n_lits = s->n_lits;
+}
+
+#ifndef DIMACS_NO_ZLIB
+// One pass over gzip'd text (possibly several concatenated members): it is
+// inflated DIMACS_BLOCK bytes at a time and each block is scanned up to its
+// last newline; the rest of the line is moved to the front and scanned with
+// the next block. So memory stays at a block (or the longest line) however
+// large the CNF is, at the price of inflating it once per pass.
+static int dimacs_gunzip_scan(dimacs_t *d, int fill) {
+    const char *in = d->text;
+    size_t in_sz = d->text_sz, cap = DIMACS_BLOCK, n = 0;
+    char *buf = (char*) malloc(cap);
+    dimacs_scan_t s = DIMACS_SCAN_INIT(fill);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(inflateInit2(&zs, 15 + 16) != Z_OK) {
+        free(buf);
+        fprintf(stderr, "dimacs: corrupt gzip input\n");
+        return 0;
+    }
+    zs.next_in = (Bytef*) in;
+    int ok = 1, eof = 0;
+    while(ok && !eof && !s.done) {
+        // avail_in/avail_out are 32 bits; hand zlib huge buffers in slices
+        size_t left = in_sz - (size_t) ((const char*) zs.next_in - in);
+        if(!zs.avail_in) zs.avail_in = (left > (1u << 30)) ? (1u << 30) : (uInt) left;
+        if(n == cap) buf = (char*) realloc(buf, cap *= 2);
+        size_t room = cap - n;
+        zs.next_out = (Bytef*) (buf + n);
+        zs.avail_out = (room > (1u << 30)) ? (1u << 30) : (uInt) room;
+        uInt before = zs.avail_out;
+        int r = inflate(&zs, Z_NO_FLUSH);
+        n += before - zs.avail_out;
+        int used = !zs.avail_in && (size_t) ((const char*) zs.next_in - in) == in_sz;
+        if(r == Z_STREAM_END) {
+            if(used) eof = 1;
+            else inflateReset(&zs);     // another member follows
+        } else if(r == Z_BUF_ERROR && used) {
+            // fewer clauses could turn an UNSAT instance SAT
+            fprintf(stderr, "dimacs: truncated gzip input\n");
+            ok = 0;
+            break;
+        } else if(r != Z_OK && r != Z_BUF_ERROR) {
+            fprintf(stderr, "dimacs: corrupt gzip input\n");
+            ok = 0;
+            break;
+        }
+
+        size_t cut = n;
+        if(!eof) {
+            while(cut && buf[cut - 1] != '\n') cut--;
+        }
+        if(cut) {
+            ok = dimacs_scan_chunk(d, &s, buf, buf + cut);
+            memmove(buf, buf + cut, n - cut);
+            n -= cut;
+        }
+    }
+    inflateEnd(&zs);
+    free(buf);
+    if(ok) dimacs_scan_end(d, &s);
+    return ok;
+}
+#endif
+
+// One pass over the input: counting (@fill 0) or storing the literals.
+static int dimacs_pass(dimacs_t *d, int fill) {
+    const char *text = d->text;
+    if(d->text_sz >= 2 && (unsigned char) text[0] == 0x1f && (unsigned char) text[1] == 0x8b) {
+#ifndef DIMACS_NO_ZLIB
+        return dimacs_gunzip_scan(d, fill);
+#else
+        fprintf(stderr, "dimacs: gzip input needs zlib; rebuild without DIMACS_NO_ZLIB\n");
+        return 0;
+#endif
+    }
+    dimacs_scan_t s = DIMACS_SCAN_INIT(fill);
+    if(!dimacs_scan_chunk(d, &s, text, text + d->text_sz)) return 0;
+    dimacs_scan_end(d, &s);
+    return 1;
+}
+
+static void dimacs_free(dimacs_t *d) {
+    if(d->text_mapped) munmap((void*) d->text, d->text_sz);
+    else free((void*) d->text);
+    free(d->lits);
+    free(d->start);
+    memset(d, 0, sizeof(*d));
+}
+
+// Reads @path, or stdin if it is NULL or "-". Returns 0 (after printing
+// why) if the input can't be read or isn't DIMACS.
+static int dimacs_read(dimacs_t *d, const char *path) {
+    memset(d, 0, sizeof(*d));
+    int fd = (!path || !strcmp(path, "-")) ? 0 : open(path, O_RDONLY);
+    if(fd < 0) {
+        perror(path);
+        return 0;
+    }
+
+    struct stat st;
+    char *text = NULL;
+    if(!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        text = (char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(text == MAP_FAILED) text = NULL;
+        else {
+            madvise(text, st.st_size, MADV_SEQUENTIAL);
+            d->text_sz = st.st_size;
+            d->text_mapped = 1;
+        }
+    }
+    if(!text) text = dimacs_slurp(fd, &d->text_sz);
+    if(fd) close(fd);
+    if(!text) {
+        perror("dimacs: read");
+        return 0;
+    }
+    d->text = text;
+
+    if(!dimacs_pass(d, 0)) {
+        dimacs_free(d);
+        return 0;
+    }
+    d->lits = (int*) malloc(sizeof(int) * (d->n_lits + 1));
+    d->start = (size_t*) malloc(sizeof(size_t) * (d->n_clauses + 1));
+    return dimacs_pass(d, 1);
+}
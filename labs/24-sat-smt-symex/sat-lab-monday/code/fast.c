@@ -2,6 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "dimacs.h"
 
 #define append_field(OBJ, FIELD) (*({ \
     (OBJ).FIELD = realloc((OBJ).FIELD, (++((OBJ).n_##FIELD)) * sizeof((OBJ).FIELD[0])); \
@@ -13,18 +17,23 @@ int LOG_XCHECK = 0;
 
 unsigned N_VARS = 0, N_CLAUSES = 0;
 
-struct clause {
-    int *literals, n_literals;
-    int watching[2];
-};
-struct clause *CLAUSES = NULL;
-
+// Literals inside the solver are ids (see literal_to_id); -l is id ^ 1.
+// VALUE is indexed by id, so a literal's value is one load. FALSE is the
+// only negative value, which lets the AVX2 watch search read "is FALSE"
+// straight off the sign bits.
 enum assignment {
-    UNASSIGNED  = -1,
-    FALSE       = 0,
+    UNASSIGNED  = 0,
+    FALSE       = -1,
     TRUE        = 1,
 };
-enum assignment *ASSIGNMENT = NULL;
+int *VALUE = NULL;
+
+// Every clause of 3+ literals lives in one int array as
+//     [size, lit_0, lit_1, ..., lit_size-1]
+// and is referred to by the offset of lit_0. The two watched literals are
+// always lit_0 and lit_1.
+int *CLAUSE_LITS = NULL;
+size_t N_CLAUSE_LITS = 0;
 
 enum decision_type {
     IMPLIED         = 0,
@@ -38,29 +47,35 @@ struct decision {
 struct decision *DECISION_STACK = NULL;
 unsigned N_DECISION_STACK = 0;
 
-struct clause_list {
-    struct clause *clause;
-    struct clause_list *next;
+// WATCHES[id] holds the offsets of the clauses watching literal id.
+struct watch_list {
+    int *clauses;
+    unsigned n, cap;
 };
-struct clause_list **LIT_TO_CLAUSES = NULL;
+struct watch_list *WATCHES = NULL;
+
+// Binary clauses aren't watched: (a | b) is stored as the implications
+// -a -> b and -b -> a. The ids implied by literal id are
+// IMPLICATIONS[IMPLIES_START[id] .. IMPLIES_START[id + 1]).
+int *IMPLICATIONS = NULL;
+unsigned *IMPLIES_START = NULL;
 
 int *BCP_LIST = NULL;
 unsigned N_BCP_LIST = 0;
 char *IS_BCP_LISTED = NULL;
 
-int literal_to_id(int literal) {
+int abs(int x) { return (x < 0) ? -x : x; }
+
+static inline int literal_to_id(int literal) {
     return (2 * abs(literal)) + (literal > 0);
 }
 
-struct clause_list **clauses_watching(int literal) {
-    return LIT_TO_CLAUSES + literal_to_id(literal);
+static inline int id_to_literal(int id) {
+    return (id & 1) ? (id >> 1) : -(id >> 1);
 }
 
-int abs(int x) { return (x < 0) ? -x : x; }
-
 int is_literal_true(int lit) {
-    int var = abs(lit);
-    return ASSIGNMENT[var] != UNASSIGNED && ASSIGNMENT[var] == (lit > 0);
+    return VALUE[literal_to_id(lit)] == TRUE;
 }
 
 int satisfiable() {
@@ -73,12 +88,32 @@ int satisfiable() {
 
 int unsatisfiable() { printf("UNSAT\n"); return 0; }
 
-void init_watcher(int clause_i, int which, int literal) {
-    CLAUSES[clause_i].watching[which] = literal;
-    struct clause_list *n = malloc(sizeof(*n));
-    n->clause = &CLAUSES[clause_i];
-    n->next = *clauses_watching(literal);
-    *clauses_watching(literal) = n;
+void watch(int id, int clause) {
+    struct watch_list *w = &WATCHES[id];
+    if (w->n == w->cap) {
+        w->cap = w->cap ? 2 * w->cap : 4;
+        w->clauses = realloc(w->clauses, w->cap * sizeof(w->clauses[0]));
+    }
+    w->clauses[w->n++] = clause;
+}
+
+// Index of the first of ids[0..n) that isn't FALSE, or -1. With AVX2,
+// eight values are gathered at once and their sign bits say which are
+// FALSE.
+static inline int find_non_false(const int *ids, int n) {
+    int i = 0;
+#ifdef __AVX2__
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_i32gather_epi32(VALUE, _mm256_loadu_si256((const __m256i *)(ids + i)), 4);
+        unsigned is_false = _mm256_movemask_ps(_mm256_castsi256_ps(v));
+        if (is_false != 0xff)
+            return i + __builtin_ctz(~is_false);
+    }
+#endif
+    for (; i < n; i++)
+        if (VALUE[ids[i]] != FALSE)
+            return i;
+    return -1;
 }
 
 void queue_bcp(int literal) {
@@ -97,53 +132,68 @@ int dequeue_bcp() {
 
 int set_literal(int literal, enum decision_type type) {
     int var = abs(literal);
-    ASSIGNMENT[var] = (literal > 0);
+    int id = literal_to_id(literal), false_id = id ^ 1;
+    VALUE[id] = TRUE;
+    VALUE[false_id] = FALSE;
     DECISION_STACK[N_DECISION_STACK].var = var;
     DECISION_STACK[N_DECISION_STACK++].type = type;
 
-    for (struct clause_list **w = clauses_watching(-literal); *w;) {
-        struct clause *clause = (*w)->clause;
-        int watch_id = (clause->watching[0] == -literal) ? 0 : 1;
-        int other_watch = clause->watching[!watch_id];
-        int new_watch_lit = 0;
-
-        for (int i = 0; i < clause->n_literals; i++) {
-            int c = clause->literals[i];
-            if (c != other_watch && c != -literal && !is_literal_true(-c)) {
-                new_watch_lit = c;
-                break;
-            }
+    for (unsigned i = IMPLIES_START[id]; i < IMPLIES_START[id + 1]; i++) {
+        int implied = IMPLICATIONS[i];
+        if (VALUE[implied] == FALSE)
+            return 0;
+        if (VALUE[implied] == UNASSIGNED)
+            queue_bcp(id_to_literal(implied));
+    }
+
+    // Clauses that find a new watch leave the list; the rest are
+    // compacted towards the front as we go.
+    struct watch_list *w = &WATCHES[false_id];
+    int *ws = w->clauses;
+    unsigned i = 0, j = 0, n = w->n;
+    int ok = 1;
+    while (i < n) {
+        int *c = CLAUSE_LITS + ws[i];
+        if (c[0] == false_id) {
+            c[0] = c[1];
+            c[1] = false_id;
+        }
+        int other = c[0];
+        if (VALUE[other] == TRUE) {
+            ws[j++] = ws[i++];
+            continue;
         }
 
-        if (new_watch_lit) {
-            struct clause_list *cw = *w;
-            *w = cw->next;
-            cw->next = *clauses_watching(new_watch_lit);
-            *clauses_watching(new_watch_lit) = cw;
-            clause->watching[watch_id] = new_watch_lit;
+        int k = find_non_false(c + 2, c[-1] - 2);
+        if (k >= 0) {
+            c[1] = c[2 + k];
+            c[2 + k] = false_id;
+            watch(c[1], ws[i++]);
             continue;
-        } else {
-            if (is_literal_true(-other_watch)) {
-                return 0;
-            } else if (is_literal_true(other_watch)) {
-            } else {
-                queue_bcp(other_watch);
-            }
-            w = &((*w)->next);
         }
+
+        ws[j++] = ws[i++];
+        if (VALUE[other] == FALSE) {
+            ok = 0;
+            break;
+        }
+        queue_bcp(id_to_literal(other));
     }
-    return 1;
+    while (i < n)
+        ws[j++] = ws[i++];
+    w->n = j;
+    return ok;
 }
 
 void unset_latest_assignment() {
     unsigned var = DECISION_STACK[--N_DECISION_STACK].var;
-    ASSIGNMENT[var] = UNASSIGNED;
+    VALUE[2 * var] = VALUE[2 * var + 1] = UNASSIGNED;
 }
 
 int decide() {
     int v;
     for (v = 1; v < N_VARS; v++) {
-        if (ASSIGNMENT[v] == UNASSIGNED) {
+        if (VALUE[2 * v] == UNASSIGNED) {
             break;
         }
     }
@@ -178,7 +228,7 @@ int resolveConflict() {
 
     unsigned var = DECISION_STACK[N_DECISION_STACK - 1].var;
 
-    int new_value = !ASSIGNMENT[var];
+    int new_value = !is_literal_true(var);
     unset_latest_assignment();
     set_literal(new_value ? var : -var, TRIED_BOTH_WAYS);
 
@@ -187,46 +237,72 @@ int resolveConflict() {
 
 int main(int argc, char **argv) {
     LOG_XCHECK = argc > 1;
-    for (char c; (c = getc(stdin)) == 'c';)
-        while (getc(stdin) != '\n');
+    dimacs_t dimacs;
+    if (!dimacs_read(&dimacs, NULL)) return 1;
+    N_VARS = dimacs.n_vars + 1;
+    N_CLAUSES = dimacs.n_clauses;
 
-    assert(scanf(" cnf %u %u\n", &N_VARS, &N_CLAUSES) == 2);
-    N_VARS++;
-
-    ASSIGNMENT = malloc(N_VARS * sizeof(ASSIGNMENT[0]));
-    memset(ASSIGNMENT, -1, N_VARS * sizeof(ASSIGNMENT[0]));
+    VALUE = calloc(2 * N_VARS, sizeof(VALUE[0]));
 
     DECISION_STACK = calloc(N_VARS, sizeof(DECISION_STACK[0]));
 
-    CLAUSES = calloc(N_CLAUSES, sizeof(struct clause));
-
-    LIT_TO_CLAUSES = calloc(N_VARS * 2, sizeof(LIT_TO_CLAUSES[0]));
+    WATCHES = calloc(2 * N_VARS, sizeof(WATCHES[0]));
 
     BCP_LIST = calloc(2 * N_VARS, sizeof(BCP_LIST[0]));
     IS_BCP_LISTED = calloc(2 * N_VARS, sizeof(IS_BCP_LISTED[0]));
 
+    // Duplicates are squeezed out of the parser's literal array in place.
+    int *sizes = calloc(N_CLAUSES, sizeof(sizes[0]));
     for (size_t i = 0; i < N_CLAUSES; i++) {
-        int literal = 0;
-        for (assert(scanf("%d ", &literal)); literal; assert(scanf("%d ", &literal))) {
+        int n;
+        int *lits = dimacs_clause(&dimacs, i, &n);
+        for (int k = 0; k < n; k++) {
             int repeat = 0;
-            for (size_t j = 0; j < CLAUSES[i].n_literals && !repeat; j++)
-                repeat = (CLAUSES[i].literals[j] == literal);
-            if (repeat) continue;
-
-            append_field(CLAUSES[i], literals) = literal;
+            for (int j = 0; j < sizes[i] && !repeat; j++)
+                repeat = (lits[j] == lits[k]);
+            if (!repeat) lits[sizes[i]++] = lits[k];
         }
+        if (sizes[i] > 2) N_CLAUSE_LITS += sizes[i] + 1;
     }
+    CLAUSE_LITS = malloc((N_CLAUSE_LITS + 1) * sizeof(CLAUSE_LITS[0]));
 
+    // count the implications per literal, then hand out the slices
+    IMPLIES_START = calloc(2 * N_VARS + 1, sizeof(IMPLIES_START[0]));
     for (size_t i = 0; i < N_CLAUSES; i++) {
-        if (!CLAUSES[i].n_literals) return unsatisfiable();
-        if (CLAUSES[i].n_literals == 1) {
-            queue_bcp(CLAUSES[i].literals[0]);
+        if (sizes[i] != 2) continue;
+        int *lits = dimacs.lits + dimacs.start[i];
+        IMPLIES_START[literal_to_id(-lits[0]) + 1]++;
+        IMPLIES_START[literal_to_id(-lits[1]) + 1]++;
+    }
+    for (unsigned id = 0; id < 2 * N_VARS; id++)
+        IMPLIES_START[id + 1] += IMPLIES_START[id];
+    IMPLICATIONS = malloc((IMPLIES_START[2 * N_VARS] + 1) * sizeof(IMPLICATIONS[0]));
+    unsigned *fill = malloc(2 * N_VARS * sizeof(fill[0]));
+    memcpy(fill, IMPLIES_START, 2 * N_VARS * sizeof(fill[0]));
+
+    size_t at = 0;
+    for (size_t i = 0; i < N_CLAUSES; i++) {
+        int *lits = dimacs.lits + dimacs.start[i];
+        if (!sizes[i]) return unsatisfiable();
+        if (sizes[i] == 1) {
+            queue_bcp(lits[0]);
+        } else if (sizes[i] == 2) {
+            int a = lits[0], b = lits[1];
+            IMPLICATIONS[fill[literal_to_id(-a)]++] = literal_to_id(b);
+            IMPLICATIONS[fill[literal_to_id(-b)]++] = literal_to_id(a);
         } else {
-            init_watcher(i, 0, CLAUSES[i].literals[0]);
-            init_watcher(i, 1, CLAUSES[i].literals[1]);
+            CLAUSE_LITS[at++] = sizes[i];
+            int clause = at;
+            for (int k = 0; k < sizes[i]; k++)
+                CLAUSE_LITS[at++] = literal_to_id(lits[k]);
+            watch(CLAUSE_LITS[clause], clause);
+            watch(CLAUSE_LITS[clause + 1], clause);
         }
     }
 
+    free(fill);
+    free(sizes);
+
     if (!bcp()) return unsatisfiable();
     while (1) {
         if (!decide())
@@ -0,0 +1,327 @@
+/**********************************************************
+ * CNF generator for scaling runs of the solvers in this directory
+ *
+ *      ./gen FAMILY N [options] > out.cnf
+ *
+ * Families, all sized by N:
+ *      ksat     random k-SAT over N variables, ratio * N clauses of k
+ *               distinct variables each. 3-SAT at the default ratio 4.26
+ *               sits at the threshold: about half SAT, and hardest there.
+ *      php      N + 1 pigeons into N holes. UNSAT, and exponential for
+ *               resolution, so for every solver here.
+ *      parity   dubois-style: a ring of 2N three-variable XORs over 3N
+ *               variables, each variable in two of them, with odd total
+ *               parity. UNSAT; 8N clauses.
+ *      miter    an N-bit ripple-carry adder against an N-bit Kogge-Stone
+ *               adder over the same inputs, Tseitin-encoded, asserting some
+ *               sum bit differs. UNSAT.
+ *
+ * Options:
+ *      -seed=S      random seed (default 1). ksat draws its clauses from
+ *                   it; the other families are the same formula for every
+ *                   seed, with variables renumbered, literals flipped and
+ *                   clauses shuffled by it. -seed=0 leaves them as built.
+ *      -k=K         clause width for ksat (default 3)
+ *      -ratio=R     clauses per variable for ksat (default 4.26)
+ *
+ * The formula goes to stdout as DIMACS, headed by a comment naming the
+ * family and parameters. See the scale-* targets in the Makefile.
+ *
+ *  e.g.
+ *      ./gen ksat 200 -seed=3 | ./cdcl
+ *      ./gen php 9 > php9.cnf
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Clauses are built into one growing array, each terminated by 0, and
+// only printed at the end, once the header's counts are known.
+static int *LITS = NULL;
+static size_t N_LITS = 0, CAP_LITS = 0;
+static unsigned N_VARS = 0, N_CLAUSES = 0;
+
+static void push_lit(int lit) {
+    if(N_LITS == CAP_LITS) {
+        CAP_LITS = CAP_LITS ? CAP_LITS * 2 : 1024;
+        LITS = (int*) realloc(LITS, sizeof(int) * CAP_LITS);
+    }
+    LITS[N_LITS++] = lit;
+}
+
+static void add_clause(const int *lits, int n) {
+    for(int i = 0; i < n; i++) push_lit(lits[i]);
+    push_lit(0);
+    N_CLAUSES++;
+}
+#define clause(...) \
+    add_clause((int[]){__VA_ARGS__}, sizeof((int[]){__VA_ARGS__}) / sizeof(int))
+
+static int new_var(void) {
+    return ++N_VARS;
+}
+
+// xorshift64*; deterministic across platforms, unlike rand()
+static uint64_t RNG = 1;
+static uint64_t rng_next(void) {
+    RNG ^= RNG >> 12;
+    RNG ^= RNG << 25;
+    RNG ^= RNG >> 27;
+    return RNG * 0x2545F4914F6CDD1DULL;
+}
+static unsigned rng_below(unsigned n) {
+    return (unsigned) ((rng_next() >> 32) % n);
+}
+
+/***************************************************/
+/* FAMILIES                                        */
+/***************************************************/
+
+static void gen_ksat(int n, int k, double ratio) {
+    N_VARS = n;
+    unsigned m = (unsigned) (ratio * n + 0.5);
+    int *c = (int*) malloc(sizeof(int) * k);
+    for(unsigned i = 0; i < m; i++) {
+        for(int j = 0; j < k; j++) {
+            int v, dup;
+            do {
+                v = 1 + rng_below(n);
+                dup = 0;
+                for(int l = 0; l < j; l++) dup |= (abs(c[l]) == v);
+            } while(dup);
+            c[j] = (rng_next() >> 63) ? -v : v;
+        }
+        add_clause(c, k);
+    }
+    free(c);
+}
+
+static void gen_php(int n) {
+    // p(i, h): pigeon i sits in hole h
+    int pigeons = n + 1;
+    N_VARS = pigeons * n;
+#define P(i, h) ((i) * n + (h) + 1)
+    int *c = (int*) malloc(sizeof(int) * n);
+    for(int i = 0; i < pigeons; i++) {
+        for(int h = 0; h < n; h++) c[h] = P(i, h);
+        add_clause(c, n);
+    }
+    for(int h = 0; h < n; h++)
+        for(int i = 0; i < pigeons; i++)
+            for(int j = i + 1; j < pigeons; j++)
+                clause(-P(i, h), -P(j, h));
+#undef P
+    free(c);
+}
+
+// The four clauses of a ^ b ^ c == parity.
+static void xor3(int a, int b, int c, int parity) {
+    for(int s = 0; s < 8; s++) {
+        int odd = __builtin_popcount(s) & 1;
+        // forbid the assignment a = s&1, b = s&2, c = s&4 if its parity is wrong
+        if(odd == parity) continue;
+        clause((s & 1) ? -a : a, (s & 2) ? -b : b, (s & 4) ? -c : c);
+    }
+}
+
+static void gen_parity(int n) {
+    // ring variables 1..2n, chords 2n+1..3n; XOR i joins ring i, ring i+1
+    // and chord i mod n. Summing them all cancels every variable, so the
+    // one odd right-hand side makes the ring contradictory.
+    int ring = 2 * n;
+    N_VARS = 3 * n;
+    for(int i = 0; i < ring; i++)
+        xor3(1 + i, 1 + (i + 1) % ring, ring + 1 + i % n, i == 0);
+}
+
+// Tseitin gates; each returns a fresh variable equal to its function.
+static int gate_and(int a, int b) {
+    int o = new_var();
+    clause(-o, a);
+    clause(-o, b);
+    clause(o, -a, -b);
+    return o;
+}
+
+static int gate_or(int a, int b) {
+    int o = new_var();
+    clause(o, -a);
+    clause(o, -b);
+    clause(-o, a, b);
+    return o;
+}
+
+static int gate_xor(int a, int b) {
+    int o = new_var();
+    clause(-o, a, b);
+    clause(-o, -a, -b);
+    clause(o, -a, b);
+    clause(o, a, -b);
+    return o;
+}
+
+static void gen_miter(int n) {
+    int *a = (int*) malloc(sizeof(int) * n), *b = (int*) malloc(sizeof(int) * n);
+    int *s = (int*) malloc(sizeof(int) * (n + 1)), *t = (int*) malloc(sizeof(int) * (n + 1));
+    for(int i = 0; i < n; i++) a[i] = new_var();
+    for(int i = 0; i < n; i++) b[i] = new_var();
+
+    // ripple carry: s_i = a_i ^ b_i ^ c_i, c_i+1 = a_i b_i | c_i (a_i ^ b_i)
+    int carry = 0;
+    for(int i = 0; i < n; i++) {
+        int p = gate_xor(a[i], b[i]), g = gate_and(a[i], b[i]);
+        if(!carry) {
+            s[i] = p;
+            carry = g;
+        } else {
+            s[i] = gate_xor(p, carry);
+            carry = gate_or(g, gate_and(p, carry));
+        }
+    }
+    s[n] = carry;
+
+    // Kogge-Stone: (G, P) prefixes over doubling spans, so G[i] ends up as
+    // the carry out of bit i
+    int *G = (int*) malloc(sizeof(int) * n), *P = (int*) malloc(sizeof(int) * n);
+    int *p0 = (int*) malloc(sizeof(int) * n);
+    int *nG = (int*) malloc(sizeof(int) * n), *nP = (int*) malloc(sizeof(int) * n);
+    for(int i = 0; i < n; i++) {
+        p0[i] = P[i] = gate_xor(a[i], b[i]);
+        G[i] = gate_and(a[i], b[i]);
+    }
+    for(int d = 1; d < n; d *= 2) {
+        for(int i = 0; i < n; i++) {
+            if(i < d) {
+                nG[i] = G[i];
+                nP[i] = P[i];
+                continue;
+            }
+            nG[i] = gate_or(G[i], gate_and(P[i], G[i - d]));
+            nP[i] = gate_and(P[i], P[i - d]);
+        }
+        memcpy(G, nG, sizeof(int) * n);
+        memcpy(P, nP, sizeof(int) * n);
+    }
+    t[0] = p0[0];
+    for(int i = 1; i < n; i++) t[i] = gate_xor(p0[i], G[i - 1]);
+    t[n] = G[n - 1];
+
+    // some output bit differs
+    int *diff = (int*) malloc(sizeof(int) * (n + 1));
+    for(int i = 0; i <= n; i++) diff[i] = gate_xor(s[i], t[i]);
+    add_clause(diff, n + 1);
+
+    free(a), free(b), free(s), free(t);
+    free(G), free(P), free(p0), free(nG), free(nP), free(diff);
+}
+
+/***************************************************/
+/* OUTPUT                                          */
+/***************************************************/
+
+// Renames the variables by a random permutation, flips the sign of a
+// random half of them and shuffles the clause order. None of it changes
+// satisfiability, but it keeps the structured families from always
+// handing the solvers the same variable order.
+static void scramble(void) {
+    int *map = (int*) malloc(sizeof(int) * (N_VARS + 1));
+    for(unsigned v = 1; v <= N_VARS; v++) map[v] = v;
+    for(unsigned v = N_VARS; v > 1; v--) {
+        unsigned u = 1 + rng_below(v);
+        int tmp = map[v];
+        map[v] = map[u];
+        map[u] = tmp;
+    }
+    for(unsigned v = 1; v <= N_VARS; v++)
+        if(rng_next() >> 63) map[v] = -map[v];
+    for(size_t i = 0; i < N_LITS; i++) {
+        int l = LITS[i];
+        if(l) LITS[i] = (l < 0) ? -map[-l] : map[l];
+    }
+    free(map);
+
+    // shuffle clause start offsets, then copy the clauses out in that order
+    size_t *start = (size_t*) malloc(sizeof(size_t) * N_CLAUSES);
+    for(size_t i = 0, c = 0; i < N_LITS; i++)
+        if(!i || !LITS[i - 1]) start[c++] = i;
+    for(unsigned i = N_CLAUSES; i > 1; i--) {
+        unsigned j = rng_below(i);
+        size_t tmp = start[i - 1];
+        start[i - 1] = start[j];
+        start[j] = tmp;
+    }
+    int *out = (int*) malloc(sizeof(int) * N_LITS);
+    size_t n = 0;
+    for(unsigned c = 0; c < N_CLAUSES; c++)
+        for(size_t i = start[c]; (out[n++] = LITS[i]); i++)
+            ;
+    free(start);
+    free(LITS);
+    LITS = out;
+}
+
+static void write_dimacs(void) {
+    printf("p cnf %u %u\n", N_VARS, N_CLAUSES);
+    for(size_t i = 0; i < N_LITS; i++) {
+        if(LITS[i]) printf("%d ", LITS[i]);
+        else fputs("0\n", stdout);
+    }
+}
+
+/***************************************************/
+/* MAIN                                            */
+/***************************************************/
+static void usage(void) {
+    fprintf(stderr, "usage: gen ksat|php|parity|miter N [-seed=S] [-k=K] [-ratio=R]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    static char buf[1 << 16];
+    setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+    const char *family = NULL;
+    int n = -1, k = 3;
+    unsigned long long seed = 1;
+    double ratio = 4.26;
+    for(int i = 1; i < argc; i++) {
+        if(!strncmp(argv[i], "-seed=", 6)) seed = strtoull(argv[i] + 6, NULL, 10);
+        else if(!strncmp(argv[i], "-k=", 3)) k = atoi(argv[i] + 3);
+        else if(!strncmp(argv[i], "-ratio=", 7)) ratio = atof(argv[i] + 7);
+        else if(argv[i][0] == '-') {
+            fprintf(stderr, "gen: unknown option %s\n", argv[i]);
+            usage();
+        } else if(!family) family = argv[i];
+        else if(n < 0) n = atoi(argv[i]);
+        else usage();
+    }
+    if(!family || n < 1 || k < 1) usage();
+    if(!strcmp(family, "ksat") && k > n) {
+        fprintf(stderr, "gen: ksat needs at least k = %d variables\n", k);
+        return 1;
+    }
+    // xorshift must not start at 0; mix the seed so nearby ones diverge
+    RNG = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+
+    if(!strcmp(family, "ksat")) {
+        printf("c gen ksat n=%d k=%d ratio=%g seed=%llu\n", n, k, ratio, seed);
+        gen_ksat(n, k, ratio);
+    } else if(!strcmp(family, "php")) {
+        printf("c gen php n=%d seed=%llu\n", n, seed);
+        gen_php(n);
+    } else if(!strcmp(family, "parity")) {
+        printf("c gen parity n=%d seed=%llu\n", n, seed);
+        gen_parity(n);
+    } else if(!strcmp(family, "miter")) {
+        printf("c gen miter n=%d seed=%llu\n", n, seed);
+        gen_miter(n);
+    } else {
+        fprintf(stderr, "gen: unknown family %s\n", family);
+        usage();
+    }
+    if(seed && strcmp(family, "ksat")) scramble();
+    write_dimacs();
+    free(LITS);
+    return 0;
+}
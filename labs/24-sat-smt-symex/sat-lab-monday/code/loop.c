@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include "dimacs.h"
 
 #define append_field(OBJ, FIELD) (*({ \
     (OBJ).FIELD = realloc((OBJ).FIELD, (++((OBJ).n_##FIELD)) * sizeof((OBJ).FIELD[0])); \
@@ -236,36 +237,47 @@ int solve_once(void) {
 int main(int argc, char **argv) {
     LOG_XCHECK = (argc > 1);
 
-    // skip lines that start with 'c'
-    for (char c; (c = getc(stdin)) == 'c'; )
-        while (getc(stdin) != '\n');
-
-    // read "p cnf N_VARS N_CLAUSES"
-    assert(scanf(" cnf %u %u\n", &N_VARS, &N_CLAUSES) == 2);
-    N_VARS++;
+    dimacs_t dimacs;
+    if (!dimacs_read(&dimacs, NULL)) return 1;
+    N_VARS = dimacs.n_vars + 1;
+    N_CLAUSES = dimacs.n_clauses;
 
     ASSIGNMENT = malloc(N_VARS * sizeof(*ASSIGNMENT));
     DECISION_STACK = calloc(N_VARS, sizeof(*DECISION_STACK));
     CLAUSES = calloc(N_CLAUSES, sizeof(*CLAUSES));
     LIT_TO_CLAUSES = calloc(2 * N_VARS, sizeof(*LIT_TO_CLAUSES));
 
-    // read each clause
+    // each clause uses its slice of the parser's literals, deduplicated in
+    // place; count the occurrences of every literal while we're at it
     for (unsigned i = 0; i < N_CLAUSES; i++) {
-        int literal = 0;
-        scanf("%d", &literal);
-        while (literal != 0) {
-            // deduplicate
+        int n;
+        int *lits = dimacs_clause(&dimacs, i, &n);
+        CLAUSES[i].literals = lits;
+        for (int k = 0; k < n; k++) {
             int repeat = 0;
             for (int j = 0; j < CLAUSES[i].n_literals && !repeat; j++) {
-                if (CLAUSES[i].literals[j] == literal) {
+                if (lits[j] == lits[k]) {
                     repeat = 1;
                 }
             }
             if (!repeat) {
-                append_field(CLAUSES[i], literals) = literal;
-                append_field(*clauses_touching(literal), clauses) = &CLAUSES[i];
+                lits[CLAUSES[i].n_literals++] = lits[k];
+                clauses_touching(lits[k])->n_clauses++;
             }
-            scanf("%d", &literal);
+        }
+    }
+
+    // carve every literal's clause list out of one array, then fill them
+    struct clause **occurs = malloc((dimacs.n_lits + 1) * sizeof(*occurs));
+    for (unsigned id = 0; id < 2 * N_VARS; id++) {
+        LIT_TO_CLAUSES[id].clauses = occurs;
+        occurs += LIT_TO_CLAUSES[id].n_clauses;
+        LIT_TO_CLAUSES[id].n_clauses = 0;
+    }
+    for (unsigned i = 0; i < N_CLAUSES; i++) {
+        for (int j = 0; j < CLAUSES[i].n_literals; j++) {
+            struct clause_list *list = clauses_touching(CLAUSES[i].literals[j]);
+            list->clauses[list->n_clauses++] = &CLAUSES[i];
         }
     }
 
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <stdint.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include "smt.h"
@@ -24,10 +26,25 @@ enum op {
     OP_BRANCH_EQ,   // If the two registers have identical values, jump
     OP_FAIL,        // If this point is reached, there is a bug
     OP_ADD,         // Addition of registers
+    OP_SUB,         // The other arithmetic and bitwise operations, modulo
+    OP_MUL,         // 2^WORD_SIZE; division by zero gives all ones (udiv)
+    OP_UDIV,        // or the dividend (urem), shifting by WORD_SIZE or more
+    OP_UREM,        // gives 0 (or all sign bits, ashr)
+    OP_AND,
+    OP_OR,
+    OP_XOR,
+    OP_NOT,
+    OP_SHL,
+    OP_LSHR,
+    OP_ASHR,
+    OP_BRANCH_ULT,  // If the first register is less than the second as an
+    OP_BRANCH_SLT,  // unsigned/signed number, jump
 };
 
 static const char *op_names[] = {
     "exit", "immediate", "move", "store", "load", "branch_eq", "fail", "add",
+    "sub", "mul", "udiv", "urem", "and", "or", "xor", "not", "shl", "lshr",
+    "ashr", "branch_ult", "branch_slt",
 };
 
 // An instruction is an opcode and some arguments
@@ -40,6 +57,264 @@ struct instruction {
 static struct instruction *PROGRAM = NULL;
 static int N_PROGRAM = 0;
 
+// How many times any path has executed each instruction
+static int *COVERAGE = NULL;
+
+// Options; see usage()
+enum search { SEARCH_DFS, SEARCH_BFS, SEARCH_RANDOM_PATH, SEARCH_COVNEW };
+static const char *search_names[] = { "dfs", "bfs", "random-path", "covnew" };
+static enum search SEARCH = SEARCH_DFS;
+static int N_THREADS = 0, MAX_PATHS = 0, TRACE = 0, NO_CACHE = 0, CONCOLIC = 0;
+static double TIMEOUT = 0;
+
+/**** TERMS ****/
+
+// Register and memory values are terms. A term is immutable once built, so
+// every state that has it shares it, across threads too. Terms are
+// hash-consed: building the same term twice, on any path, gives the same
+// one, so the query cache sees the same conditions as the same literals.
+// Terms are never freed; the budget bounds how many a run makes. Building
+// a term folds constants, so concrete code never reaches the solver.
+enum term_kind {
+    T_CONST,        // value
+    T_INPUT,        // a register's value as the program starts (value: which)
+    T_ADD,          // a + b
+    T_SUB,          // a - b, and so on, with the semantics of the opcodes
+    T_MUL,
+    T_UDIV,
+    T_UREM,
+    T_AND,
+    T_OR,
+    T_XOR,
+    T_NOT,          // ~a
+    T_SHL,
+    T_LSHR,
+    T_ASHR,
+    T_EQ,           // a == b; a condition, not a word
+    T_ULT,          // a < b, unsigned; a condition too
+    T_SLT,          // a < b, signed
+    T_LOAD,         // mem[a]
+    M_INITIAL,      // memory as the program starts
+    M_STORE,        // mem, except [a] = b
+};
+
+// the term each arithmetic, bitwise and (non-eq) branch opcode builds
+static const enum term_kind ALU_TERMS[] = {
+    [OP_ADD] = T_ADD, [OP_SUB] = T_SUB, [OP_MUL] = T_MUL, [OP_UDIV] = T_UDIV,
+    [OP_UREM] = T_UREM, [OP_AND] = T_AND, [OP_OR] = T_OR, [OP_XOR] = T_XOR,
+    [OP_SHL] = T_SHL, [OP_LSHR] = T_LSHR, [OP_ASHR] = T_ASHR,
+    [OP_BRANCH_ULT] = T_ULT, [OP_BRANCH_SLT] = T_SLT,
+};
+
+struct term {
+    enum term_kind kind;
+    int id;         // dense, indexes the per-query handle memo
+    int64_t value;
+    struct term *mem, *a, *b;
+
+    // the T_INPUTs and M_INITIAL this term depends on, as sorted ids
+    // (often shared with an operand's)
+    const int *syms;
+    int n_syms;
+
+    struct term *next;  // hash chain
+};
+static int N_TERMS = 0;
+static struct term *INITIAL_MEMORY = NULL;
+
+#define TERM_BUCKETS (1 << 18)
+#define TERM_LOCKS 256
+static struct term *TERMS[TERM_BUCKETS];
+static pthread_mutex_t TERM_LOCK[TERM_LOCKS];
+
+// Sorted union of two symbol sets; reuses one of them if it already has all.
+static const int *syms_union(const int *a, int n_a, const int *b, int n_b, int *n) {
+    int i = 0, j = 0, k = 0;
+    while (i < n_a && j < n_b) {
+        if (a[i] == b[j]) i++, j++;
+        else if (a[i] < b[j]) i++;
+        else break;
+    }
+    if (j == n_b) {
+        *n = n_a;
+        return a;
+    }
+    int *out = malloc((n_a + n_b) * sizeof(out[0]));
+    for (i = j = 0; i < n_a || j < n_b; ) {
+        if (j == n_b || (i < n_a && a[i] < b[j])) out[k++] = a[i++];
+        else if (i == n_a || b[j] < a[i]) out[k++] = b[j++];
+        else out[k++] = a[i++], j++;
+    }
+    *n = k;
+    return out;
+}
+
+static struct term *term_new(enum term_kind kind, int64_t value,
+                             struct term *mem, struct term *a, struct term *b) {
+    uint64_t hash = ((uint64_t) kind * 0x9e3779b97f4a7c15UL) ^ (uint64_t) value;
+    hash = (hash ^ (uintptr_t) mem) * 0xff51afd7ed558ccdUL;
+    hash = (hash ^ (uintptr_t) a) * 0xc4ceb9fe1a85ec53UL;
+    hash = (hash ^ (uintptr_t) b) * 0xff51afd7ed558ccdUL;
+    hash ^= hash >> 29;
+    struct term **bucket = &TERMS[hash % TERM_BUCKETS];
+    pthread_mutex_t *lock = &TERM_LOCK[hash % TERM_LOCKS];
+    pthread_mutex_lock(lock);
+    for (struct term *t = *bucket; t; t = t->next) {
+        if (t->kind == kind && t->value == value && t->mem == mem && t->a == a && t->b == b) {
+            pthread_mutex_unlock(lock);
+            return t;
+        }
+    }
+
+    struct term *t = malloc(sizeof(*t));
+    *t = (struct term){
+        .kind = kind,
+        .id = __atomic_fetch_add(&N_TERMS, 1, __ATOMIC_RELAXED),
+        .value = value,
+        .mem = mem,
+        .a = a,
+        .b = b,
+    };
+    if (kind == T_INPUT || kind == M_INITIAL) {
+        int *sym = malloc(sizeof(*sym));
+        *sym = t->id;
+        t->syms = sym;
+        t->n_syms = 1;
+    }
+    struct term *ops[] = { mem, a, b };
+    for (int i = 0; i < 3; i++) {
+        if (ops[i])
+            t->syms = syms_union(ops[i]->syms, ops[i]->n_syms, t->syms, t->n_syms, &t->n_syms);
+    }
+    t->next = *bucket;
+    *bucket = t;
+    pthread_mutex_unlock(lock);
+    return t;
+}
+
+static struct term *term_const(int64_t value) {
+    return term_new(T_CONST, value & ((1L << WORD_SIZE) - 1), NULL, NULL, NULL);
+}
+
+static int64_t word_signed(int64_t x) {
+    return (x & (1L << (WORD_SIZE - 1))) ? x - (1L << WORD_SIZE) : x;
+}
+
+// What a T_ADD..T_SLT term computes from its operands' values (words
+// 0..2^WORD_SIZE-1); conditions are 0 or 1.
+static int64_t concrete(enum term_kind kind, int64_t x, int64_t y) {
+    int64_t mask = (1L << WORD_SIZE) - 1;
+    switch (kind) {
+        case T_ADD:  return (x + y) & mask;
+        case T_SUB:  return (x - y) & mask;
+        case T_MUL:  return (x * y) & mask;
+        case T_UDIV: return y ? x / y : mask;
+        case T_UREM: return y ? x % y : x;
+        case T_AND:  return x & y;
+        case T_OR:   return x | y;
+        case T_XOR:  return x ^ y;
+        case T_NOT:  return ~x & mask;
+        case T_SHL:  return (y < WORD_SIZE) ? (x << y) & mask : 0;
+        case T_LSHR: return (y < WORD_SIZE) ? x >> y : 0;
+        case T_ASHR: return (word_signed(x) >> (y < WORD_SIZE ? y : WORD_SIZE - 1)) & mask;
+        case T_EQ:   return x == y;
+        case T_ULT:  return x < y;
+        case T_SLT:  return word_signed(x) < word_signed(y);
+        default:     assert(!"not an operation");
+    }
+    return 0;
+}
+
+static int is_const(struct term *t, int64_t value) {
+    return t->kind == T_CONST && t->value == value;
+}
+
+// a <kind> b (b is NULL for T_NOT), folding constants and the identities
+// that leave an operand or a constant.
+static struct term *term_op(enum term_kind kind, struct term *a, struct term *b) {
+    if (a->kind == T_CONST && (!b || b->kind == T_CONST))
+        return term_const(concrete(kind, a->value, b ? b->value : 0));
+    switch (kind) {
+        case T_ADD:
+        case T_OR:
+        case T_XOR:
+            if (is_const(a, 0)) return b;
+            // fall through
+        case T_SUB:
+        case T_SHL:
+        case T_LSHR:
+        case T_ASHR:
+            if (is_const(b, 0)) return a;
+            break;
+        case T_MUL:
+            if (is_const(a, 1)) return b;
+            if (is_const(b, 1)) return a;
+            // fall through
+        case T_AND:
+            if (is_const(a, 0) || is_const(b, 0)) return term_const(0);
+            break;
+        case T_UDIV:
+            if (is_const(b, 1)) return a;
+            break;
+        default:
+            break;
+    }
+    if (a == b) {
+        if (kind == T_SUB || kind == T_XOR || kind == T_ULT || kind == T_SLT)
+            return term_const(0);
+        if (kind == T_AND || kind == T_OR) return a;
+    }
+    return term_new(kind, 0, NULL, a, b);
+}
+
+// 1 if @a and @b are the same word in every model, 0 if they differ in every
+// model, -1 if we can't tell without the solver.
+static int term_same(struct term *a, struct term *b) {
+    if (a == b) return 1;
+    if (a->kind == T_CONST && b->kind == T_CONST) return a->value == b->value;
+    return -1;
+}
+
+static struct term *term_eq(struct term *a, struct term *b) {
+    int same = term_same(a, b);
+    if (same >= 0) return term_const(same);
+    return term_new(T_EQ, 0, NULL, a, b);
+}
+
+static struct term *term_store(struct term *mem, struct term *addr, struct term *value) {
+    return term_new(M_STORE, 0, mem, addr, value);
+}
+
+// Read-over-write as far as it can be decided without the solver: a store
+// to the same address gives its value, a store to a provably different one
+// is skipped.
+static struct term *term_load(struct term *mem, struct term *addr) {
+    for (; mem->kind == M_STORE; mem = mem->mem) {
+        int same = term_same(mem->a, addr);
+        if (same == 1) return mem->b;
+        if (same < 0) break;
+    }
+    return term_new(T_LOAD, 0, mem, addr, NULL);
+}
+
+/**** STATES ****/
+
+// A path through the program. Forking one shares everything: the path
+// condition and the input list are persistent lists that only ever grow at
+// the head, memory is a term, and the register file is copied on the first
+// write after a fork.
+struct regs {
+    int refs;
+    int n;
+    struct term **r;    // NULL: not written yet
+};
+
+struct constraint {
+    struct term *cond;
+    int holds;
+    struct constraint *next;
+};
+
 // An input variable is a register whose value we use without ever loading or
 // moving a value into it, *OR* a memory read that hasn't been read before. We
 // use this list to print out just the parts of the solution that we need (the
@@ -48,143 +323,1008 @@ static int N_PROGRAM = 0;
 // load/store (they will be dedup'd at the printing stage).
 struct in_var {
     int register_number;
-    int bv_id;
+    struct term *value;
 
     // If this is a memory lookup...
-    int bv_key, is_store;
+    struct term *key;
+    int is_store;
+
+    struct in_var *next;
+};
+
+struct model;
+
+struct state {
+    int id, pc, depth;
+    struct regs *regs;
+    struct term *mem;
+    struct constraint *path;    // newest first
+    struct in_var *in_vars;     // newest first
+
+    // Concolic runs only: the concrete inputs it runs on, how many of the
+    // oldest path constraints its children must leave alone, and how many
+    // instructions the run that made it covered first.
+    struct model *input;
+    int bound, score;
 };
-static struct in_var *IN_VARS = NULL;
-static int N_IN_VARS = 0;
+static int N_STATES = 0;
+
+static struct state *new_state(void) {
+    struct state *s = calloc(1, sizeof(*s));
+    s->id = __atomic_fetch_add(&N_STATES, 1, __ATOMIC_RELAXED);
+    s->regs = calloc(1, sizeof(*s->regs));
+    s->regs->refs = 1;
+    s->mem = INITIAL_MEMORY;
+    return s;
+}
+
+static struct state *fork_state(struct state *s) {
+    struct state *child = malloc(sizeof(*child));
+    *child = *s;
+    child->id = __atomic_fetch_add(&N_STATES, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->regs->refs, 1, __ATOMIC_RELAXED);
+    return child;
+}
+
+static void release_regs(struct regs *regs) {
+    if (__atomic_sub_fetch(&regs->refs, 1, __ATOMIC_ACQ_REL)) return;
+    free(regs->r);
+    free(regs);
+}
 
-static int *REGS = NULL, N_REGS = 0;
-static void set_register(int n, int val) {
-    while (n >= N_REGS)
-        APPEND_GLOBAL(REGS) = -1;
-    REGS[n] = val;
+static void free_state(struct state *s) {
+    release_regs(s->regs);
+    free(s);
 }
 
-static int get_register(int n) {
-    if (n < N_REGS && REGS[n] >= 0) return REGS[n];
-    set_register(n, new_bv(WORD_SIZE));
-    APPEND_GLOBAL(IN_VARS) = (struct in_var){
+static void constrain(struct state *s, struct term *cond, int holds) {
+    struct constraint *c = malloc(sizeof(*c));
+    *c = (struct constraint){ cond, holds, s->path };
+    s->path = c;
+}
+
+static void add_in_var(struct state *s, struct in_var in_var) {
+    struct in_var *v = malloc(sizeof(*v));
+    *v = in_var;
+    v->next = s->in_vars;
+    s->in_vars = v;
+}
+
+static void set_register(struct state *s, int n, struct term *val) {
+    struct regs *regs = s->regs;
+    if (__atomic_load_n(&regs->refs, __ATOMIC_ACQUIRE) > 1) {
+        struct regs *copy = malloc(sizeof(*copy));
+        copy->refs = 1;
+        copy->n = regs->n;
+        copy->r = malloc(regs->n * sizeof(copy->r[0]));
+        memcpy(copy->r, regs->r, regs->n * sizeof(copy->r[0]));
+        release_regs(regs);
+        s->regs = regs = copy;
+    }
+    if (n >= regs->n) {
+        regs->r = realloc(regs->r, (n + 1) * sizeof(regs->r[0]));
+        memset(regs->r + regs->n, 0, (n + 1 - regs->n) * sizeof(regs->r[0]));
+        regs->n = n + 1;
+    }
+    regs->r[n] = val;
+}
+
+static struct term *get_register(struct state *s, int n) {
+    if (n < s->regs->n && s->regs->r[n]) return s->regs->r[n];
+    struct term *input = term_new(T_INPUT, n, NULL, NULL, NULL);
+    set_register(s, n, input);
+    add_in_var(s, (struct in_var){
         .register_number = n,
-        .bv_id = REGS[n],
+        .value = input,
+    });
+    return input;
+}
+
+/**** SOLVER ****/
+
+// Each query is built from scratch on the asking thread (smt.c keeps its
+// state per thread), so states can move between threads freely. HANDLE
+// memoizes the smt.h handle of every term for the current query.
+static _Thread_local int *HANDLE = NULL, *HANDLE_QUERY = NULL, N_HANDLE = 0;
+static _Thread_local int QUERY = 0;
+static int N_QUERIES = 0;
+
+// the T_INPUT and T_LOAD terms of the current query, to read a model back
+static _Thread_local struct term **LEAF_TERMS = NULL;
+static _Thread_local int N_LEAF_TERMS = 0;
+
+static int blast(struct term *t) {
+    if (t->id >= N_HANDLE) {
+        int n = 2 * t->id + 1;
+        HANDLE = realloc(HANDLE, n * sizeof(HANDLE[0]));
+        HANDLE_QUERY = realloc(HANDLE_QUERY, n * sizeof(HANDLE_QUERY[0]));
+        memset(HANDLE_QUERY + N_HANDLE, 0, (n - N_HANDLE) * sizeof(HANDLE_QUERY[0]));
+        N_HANDLE = n;
+    }
+    if (HANDLE_QUERY[t->id] == QUERY) return HANDLE[t->id];
+
+    // a term's operands are always older, so they have smaller ids
+    int handle = 0;
+    switch (t->kind) {
+        case T_CONST:   handle = const_bv(t->value, WORD_SIZE); break;
+        case T_INPUT:   handle = new_bv(WORD_SIZE); APPEND_GLOBAL(LEAF_TERMS) = t; break;
+        case T_ADD:     handle = bv_add(blast(t->a), blast(t->b)); break;
+        case T_SUB:     handle = bv_sub(blast(t->a), blast(t->b)); break;
+        case T_MUL:     handle = bv_mul(blast(t->a), blast(t->b)); break;
+        case T_UDIV:    handle = bv_udiv(blast(t->a), blast(t->b)); break;
+        case T_UREM:    handle = bv_urem(blast(t->a), blast(t->b)); break;
+        case T_AND:     handle = bv_and(blast(t->a), blast(t->b)); break;
+        case T_OR:      handle = bv_or(blast(t->a), blast(t->b)); break;
+        case T_XOR:     handle = bv_xor(blast(t->a), blast(t->b)); break;
+        case T_NOT:     handle = bv_not(blast(t->a)); break;
+        case T_SHL:     handle = bv_shl(blast(t->a), blast(t->b)); break;
+        case T_LSHR:    handle = bv_lshr(blast(t->a), blast(t->b)); break;
+        case T_ASHR:    handle = bv_ashr(blast(t->a), blast(t->b)); break;
+        case T_EQ:      handle = bv_eq(blast(t->a), blast(t->b)); break;
+        case T_ULT:     handle = bv_ult(blast(t->a), blast(t->b)); break;
+        case T_SLT:     handle = bv_slt(blast(t->a), blast(t->b)); break;
+        case T_LOAD:
+            handle = array_get(blast(t->mem), blast(t->a), WORD_SIZE);
+            APPEND_GLOBAL(LEAF_TERMS) = t;
+            break;
+        case M_INITIAL: handle = new_array(); break;
+        case M_STORE:   handle = array_store(blast(t->mem), blast(t->a), blast(t->b)); break;
+    }
+    HANDLE[t->id] = handle;
+    HANDLE_QUERY[t->id] = QUERY;
+    return handle;
+}
+
+/**** QUERY CACHE ****/
+
+// Branch queries go through a cache in front of the solver, after KLEE's.
+// A query is first cut down to the constraints that share symbols with the
+// branch condition, directly or through other such constraints: the path
+// condition is known to be satisfiable, so the rest can't change the
+// answer. The slice, as a sorted set of literals (constraint term id * 2 +
+// polarity), is then looked up:
+//  - the same set was solved before: same answer;
+//  - a subset of it was UNSAT: UNSAT;
+//  - a superset of it was SAT: SAT;
+//  - the model of an earlier SAT answer satisfies it: SAT.
+// Only then does the solver run, and its answer (with the model) goes into
+// the cache. Subsets, supersets and models are only tried against the last
+// CACHE_RECENT answers. Entries are never freed, like terms.
+struct model {
+    int n_inputs;
+    int *input_ids;             // sorted
+    int64_t *input_values;
+    int n_memory;
+    int64_t *memory_keys;       // sorted; initial memory is 0 elsewhere
+    int64_t *memory_values;
+};
+
+struct cache_entry {
+    int *lits, n_lits;
+    uint64_t hash;
+    int sat;
+    struct model *model;
+    struct cache_entry *next;   // hash chain
+};
+
+#define CACHE_BUCKETS (1 << 16)
+#define CACHE_RECENT 128
+static struct cache_entry *CACHE[CACHE_BUCKETS];
+static struct cache_entry *RECENT[CACHE_RECENT];
+static int N_RECENT = 0;        // RECENT[i % CACHE_RECENT] for the last ones
+static pthread_rwlock_t CACHE_LOCK = PTHREAD_RWLOCK_INITIALIZER;
+
+enum outcome { HIT_EXACT, HIT_UNSAT_SUBSET, HIT_SAT_SUPERSET, HIT_MODEL, MISS, N_OUTCOMES };
+static int OUTCOMES[N_OUTCOMES];
+static long N_SLICED = 0, N_UNSLICED = 0;   // constraints, over branch queries
+
+static int64_t model_input(const struct model *m, int id) {
+    int lo = 0, hi = m->n_inputs;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m->input_ids[mid] < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < m->n_inputs && m->input_ids[lo] == id) ? m->input_values[lo] : 0;
+}
+
+static int64_t model_memory(const struct model *m, int64_t key) {
+    int lo = 0, hi = m->n_memory;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m->memory_keys[mid] < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < m->n_memory && m->memory_keys[lo] == key) ? m->memory_values[lo] : 0;
+}
+
+// Concrete value of @t under @m, memoized per EVAL_ROUND like blast().
+static _Thread_local int64_t *EVAL = NULL;
+static _Thread_local int *EVAL_ROUND = NULL, N_EVAL = 0, ROUND = 0;
+
+static int64_t eval(struct term *t, const struct model *m) {
+    if (t->id >= N_EVAL) {
+        int n = 2 * t->id + 1;
+        EVAL = realloc(EVAL, n * sizeof(EVAL[0]));
+        EVAL_ROUND = realloc(EVAL_ROUND, n * sizeof(EVAL_ROUND[0]));
+        memset(EVAL_ROUND + N_EVAL, 0, (n - N_EVAL) * sizeof(EVAL_ROUND[0]));
+        N_EVAL = n;
+    }
+    if (EVAL_ROUND[t->id] == ROUND) return EVAL[t->id];
+
+    int64_t value = 0;
+    switch (t->kind) {
+        case T_CONST:   value = t->value; break;
+        case T_INPUT:   value = model_input(m, t->id); break;
+        case T_NOT:     value = concrete(T_NOT, eval(t->a, m), 0); break;
+        case T_LOAD: {
+            int64_t key = eval(t->a, m);
+            struct term *mem = t->mem;
+            while (mem->kind == M_STORE && eval(mem->a, m) != key) mem = mem->mem;
+            value = (mem->kind == M_STORE) ? eval(mem->b, m) : model_memory(m, key);
+            break;
+        }
+        case M_INITIAL:
+        case M_STORE:
+            break;  // only read through loads
+        default:
+            value = concrete(t->kind, eval(t->a, m), eval(t->b, m));
+            break;
+    }
+    EVAL[t->id] = value;
+    EVAL_ROUND[t->id] = ROUND;
+    return value;
+}
+
+static int model_satisfies(const struct model *m, struct constraint **slice, int n) {
+    ROUND++;
+    for (int i = 0; i < n; i++)
+        if (eval(slice[i]->cond, m) != slice[i]->holds) return 0;
+    return 1;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *) a, y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_int64_pair(const void *a, const void *b) {
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+// After a SAT solve(): the model, over the inputs and initial memory the
+// query read.
+static struct model *read_model(void) {
+    struct model *m = calloc(1, sizeof(*m));
+    int64_t (*inputs)[2] = malloc(N_LEAF_TERMS * sizeof(inputs[0]));
+    int64_t (*memory)[2] = malloc(N_LEAF_TERMS * sizeof(memory[0]));
+    for (int i = 0; i < N_LEAF_TERMS; i++) {
+        struct term *t = LEAF_TERMS[i];
+        int64_t value = get_solution(blast(t), 0);
+        if (t->kind == T_INPUT) {
+            inputs[m->n_inputs][0] = t->id;
+            inputs[m->n_inputs++][1] = value;
+            continue;
+        }
+        // a load that got past every store reads initial memory
+        int64_t key = get_solution(blast(t->a), 0);
+        struct term *mem = t->mem;
+        while (mem->kind == M_STORE && get_solution(blast(mem->a), 0) != key) mem = mem->mem;
+        if (mem->kind == M_STORE) continue;
+        memory[m->n_memory][0] = key;
+        memory[m->n_memory++][1] = value;
+    }
+    qsort(inputs, m->n_inputs, sizeof(inputs[0]), cmp_int64_pair);
+    qsort(memory, m->n_memory, sizeof(memory[0]), cmp_int64_pair);
+    m->input_ids = malloc(m->n_inputs * sizeof(m->input_ids[0]));
+    m->input_values = malloc(m->n_inputs * sizeof(m->input_values[0]));
+    for (int i = 0; i < m->n_inputs; i++) {
+        m->input_ids[i] = inputs[i][0];
+        m->input_values[i] = inputs[i][1];
+    }
+    m->memory_keys = malloc(m->n_memory * sizeof(m->memory_keys[0]));
+    m->memory_values = malloc(m->n_memory * sizeof(m->memory_values[0]));
+    int n = 0;
+    for (int i = 0; i < m->n_memory; i++) {
+        if (n && m->memory_keys[n - 1] == memory[i][0]) continue;
+        m->memory_keys[n] = memory[i][0];
+        m->memory_values[n++] = memory[i][1];
+    }
+    m->n_memory = n;
+    free(inputs);
+    free(memory);
+    return m;
+}
+
+static int is_subset(const int *a, int n_a, const int *b, int n_b) {
+    int j = 0;
+    for (int i = 0; i < n_a; i++) {
+        while (j < n_b && b[j] < a[i]) j++;
+        if (j == n_b || b[j] != a[i]) return 0;
+        j++;
+    }
+    return 1;
+}
+
+static struct cache_entry *cache_lookup(const int *lits, int n, uint64_t hash,
+                                        struct constraint **slice, int n_slice,
+                                        enum outcome *outcome) {
+    struct cache_entry *hit = NULL;
+    pthread_rwlock_rdlock(&CACHE_LOCK);
+    for (struct cache_entry *e = CACHE[hash % CACHE_BUCKETS]; e && !hit; e = e->next) {
+        if (e->hash == hash && e->n_lits == n && !memcmp(e->lits, lits, n * sizeof(lits[0]))) {
+            hit = e;
+            *outcome = HIT_EXACT;
+        }
+    }
+    int n_recent = (N_RECENT < CACHE_RECENT) ? N_RECENT : CACHE_RECENT;
+    for (int i = 0; i < n_recent && !hit; i++) {
+        struct cache_entry *e = RECENT[i];
+        if (!e->sat && is_subset(e->lits, e->n_lits, lits, n)) {
+            hit = e;
+            *outcome = HIT_UNSAT_SUBSET;
+        } else if (e->sat && is_subset(lits, n, e->lits, e->n_lits)) {
+            hit = e;
+            *outcome = HIT_SAT_SUPERSET;
+        }
+    }
+    for (int i = 0; i < n_recent && !hit; i++) {
+        struct cache_entry *e = RECENT[i];
+        if (e->sat && model_satisfies(e->model, slice, n_slice)) {
+            hit = e;
+            *outcome = HIT_MODEL;
+        }
+    }
+    pthread_rwlock_unlock(&CACHE_LOCK);
+    return hit;
+}
+
+static void cache_insert(const int *lits, int n, uint64_t hash, int sat, struct model *model) {
+    struct cache_entry *e = malloc(sizeof(*e));
+    *e = (struct cache_entry){
+        .lits = malloc(n * sizeof(lits[0])),
+        .n_lits = n,
+        .hash = hash,
+        .sat = sat,
+        .model = model,
     };
-    return REGS[n];
+    memcpy(e->lits, lits, n * sizeof(lits[0]));
+    pthread_rwlock_wrlock(&CACHE_LOCK);
+    e->next = CACHE[hash % CACHE_BUCKETS];
+    CACHE[hash % CACHE_BUCKETS] = e;
+    RECENT[N_RECENT++ % CACHE_RECENT] = e;
+    pthread_rwlock_unlock(&CACHE_LOCK);
 }
 
-/**** main symbolic interpreter ****/
-int main() {
-    // Parse the input program
-    char opcode[20];
-    int64_t args[3];
-    while (!feof(stdin)) {
-        memset(args, 0, sizeof(args));
-        assert(scanf("%s %ld %ld %ld ", opcode, &(args[0]), &(args[1]), &(args[2])));
-        if (!strcmp(opcode, ";")) {
-            while (getc(stdin) != '\n');
+static void print_cache_stats(void) {
+    if (NO_CACHE) return;
+    int n = 0;
+    for (int i = 0; i < N_OUTCOMES; i++) n += OUTCOMES[i];
+    if (!n) return;
+    fprintf(stderr, "query cache: %d branch queries, %d exact, %d unsat-subset, "
+            "%d sat-superset, %d model-reuse, %d solved (%.1f%% hits); "
+            "slicing kept %.1f%% of the constraints\n", n, OUTCOMES[HIT_EXACT],
+            OUTCOMES[HIT_UNSAT_SUBSET], OUTCOMES[HIT_SAT_SUPERSET], OUTCOMES[HIT_MODEL],
+            OUTCOMES[MISS], 100.0 * (n - OUTCOMES[MISS]) / n,
+            N_UNSLICED ? 100.0 * N_SLICED / N_UNSLICED : 100.0);
+}
+
+// Solves @slice[0..n) from scratch; *model gets the model if it is SAT.
+static int solve_constraints(struct constraint **slice, int n, struct model **model) {
+    smt_reset();
+    QUERY++;
+    N_LEAF_TERMS = 0;
+    for (int i = 0; i < n; i++) {
+        int lit = blast(slice[i]->cond);
+        clause(slice[i]->holds ? lit : -lit);
+    }
+    int sat = solve();
+    if (sat && model) *model = read_model();
+    return sat;
+}
+
+static _Thread_local struct constraint **SLICE = NULL;
+static _Thread_local int N_SLICE = 0;
+static _Thread_local int *LITS = NULL, N_LITS = 0;
+
+// With @input, the values are what @s computed from it; without, they come
+// from the model of the last solve() on this thread.
+static int64_t value_of(struct term *t, const struct model *input) {
+    return input ? eval(t, input) : get_solution(blast(t), 0);
+}
+
+static void print_solution(struct state *s, const struct model *input) {
+    int n = 0;
+    for (struct in_var *v = s->in_vars; v; v = v->next) n++;
+    // oldest first
+    struct in_var **in_vars = malloc(n * sizeof(in_vars[0]));
+    int i = n;
+    for (struct in_var *v = s->in_vars; v; v = v->next) in_vars[--i] = v;
+
+    // one write, so solutions from different threads don't interleave
+    char *buf = NULL;
+    size_t buf_sz = 0;
+    FILE *out = open_memstream(&buf, &buf_sz);
+    fprintf(out, "[%d] Found solution:\n", s->id);
+    for (int i = 0; i < n; i++) {
+        if (in_vars[i]->register_number >= 0) {
+            fprintf(out, "\t[%d] Register %d = %ld\n", s->id,
+                    in_vars[i]->register_number,
+                    value_of(in_vars[i]->value, input));
+        } else if (in_vars[i]->is_store) {
             continue;
+        } else {
+            int key = value_of(in_vars[i]->key, input);
+            // Make sure we haven't read from/wrote to this key before
+            int found = 0;
+            for (int j = 0; j < i; j++) {
+                if (in_vars[j]->register_number == -1
+                        && value_of(in_vars[j]->key, input) == key) {
+                    found = 1;
+                    break;
+                }
+            }
+            if (found) continue;
+            fprintf(out, "\t[%d] Memory[%d] = %ld\n", s->id,
+                    key, value_of(in_vars[i]->value, input));
         }
-        enum op op = OP_EXIT;
-        for (int i = 0; i < sizeof(op_names) / sizeof(op_names[0]); i++) {
-            if (!strcmp(opcode, op_names[i])) {
-                op = i;
-                break;
+    }
+    fclose(out);
+    fputs(buf, stdout);
+    fflush(stdout);
+    free(buf);
+    free(in_vars);
+}
+
+// Solves @s's whole path condition and prints the inputs of the solution.
+static void print_failure(struct state *s) {
+    __atomic_fetch_add(&N_QUERIES, 1, __ATOMIC_RELAXED);
+    smt_reset();
+    QUERY++;
+    N_LEAF_TERMS = 0;
+    for (struct constraint *c = s->path; c; c = c->next) {
+        int lit = blast(c->cond);
+        clause(c->holds ? lit : -lit);
+    }
+    // everything print_solution() reads must exist before solve()
+    for (struct in_var *v = s->in_vars; v; v = v->next) {
+        if (v->value) blast(v->value);
+        if (v->key) blast(v->key);
+    }
+    // The path condition is satisfiable, so this always finds one.
+    if (solve()) print_solution(s, NULL);
+}
+
+// Is @path, a satisfiable path condition, still satisfiable with @cond
+// holding iff @holds? If so and @model is given, *model gets a model of the
+// constraints that matter to @cond (inputs it does not mention are free).
+static int query(struct constraint *path, struct term *cond, int holds, struct model **model) {
+    __atomic_fetch_add(&N_QUERIES, 1, __ATOMIC_RELAXED);
+    struct constraint branch = { cond, holds, path };
+    N_SLICE = 0;
+    for (struct constraint *c = &branch; c; c = c->next)
+        APPEND_GLOBAL(SLICE) = c;
+    if (NO_CACHE) return solve_constraints(SLICE, N_SLICE, model);
+
+    // Slice: SLICE[0] is the branch; pull the constraints that share a
+    // symbol with what is in already to the front until none do.
+    int n = 1, n_syms = cond->n_syms;
+    const int *syms = cond->syms;
+    int *own = NULL;
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = n; i < N_SLICE; i++) {
+            struct term *t = SLICE[i]->cond;
+            int k = 0, meet = 0;
+            for (int j = 0; j < t->n_syms && !meet; j++) {
+                while (k < n_syms && syms[k] < t->syms[j]) k++;
+                meet = k < n_syms && syms[k] == t->syms[j];
+            }
+            if (!meet) continue;
+            struct constraint *c = SLICE[i];
+            SLICE[i] = SLICE[n];
+            SLICE[n++] = c;
+            const int *u = syms_union(syms, n_syms, t->syms, t->n_syms, &n_syms);
+            if (u != syms && u != t->syms) {
+                free(own);
+                own = (int *) u;
             }
+            syms = u;
+            changed = 1;
         }
-        APPEND_GLOBAL(PROGRAM).op = op;
-        memcpy(PROGRAM[N_PROGRAM - 1].args, args, sizeof(args));
     }
+    free(own);
+    __atomic_fetch_add(&N_SLICED, n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&N_UNSLICED, N_SLICE, __ATOMIC_RELAXED);
+
+    N_LITS = 0;
+    for (int i = 0; i < n; i++)
+        APPEND_GLOBAL(LITS) = SLICE[i]->cond->id * 2 + SLICE[i]->holds;
+    qsort(LITS, N_LITS, sizeof(LITS[0]), cmp_int);
+    int n_lits = 0;
+    uint64_t hash = 14695981039346656037UL;
+    for (int i = 0; i < N_LITS; i++) {
+        if (n_lits && LITS[n_lits - 1] == LITS[i]) continue;
+        LITS[n_lits++] = LITS[i];
+        hash = (hash ^ LITS[i]) * 1099511628211UL;
+    }
+
+    enum outcome outcome = MISS;
+    struct cache_entry *hit = cache_lookup(LITS, n_lits, hash, SLICE, n, &outcome);
+    __atomic_fetch_add(&OUTCOMES[outcome], 1, __ATOMIC_RELAXED);
+    if (hit) {
+        int sat = (outcome == HIT_UNSAT_SUBSET) ? 0 : hit->sat;
+        if (outcome != HIT_EXACT) cache_insert(LITS, n_lits, hash, sat, hit->model);
+        if (sat && model) *model = hit->model;
+        return sat;
+    }
+    struct model *found = NULL;
+    int sat = solve_constraints(SLICE, n, &found);
+    cache_insert(LITS, n_lits, hash, sat, found);
+    if (sat && model) *model = found;
+    return sat;
+}
+
+/**** SCHEDULER ****/
+
+// Every worker thread has its own queue of states. It takes from its own
+// queue by the search strategy and, when that is empty, steals from
+// another's. LIVE counts states that still have to run: queued, or running
+// on some worker. QUEUED counts just the queued ones; idle workers sleep
+// on IDLE until it or LIVE changes.
+struct worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    struct state **states;
+    int n_states;
+    unsigned seed;
+};
+static struct worker *WORKERS = NULL;
+
+static pthread_mutex_t POOL_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t IDLE = PTHREAD_COND_INITIALIZER;
+static int LIVE = 0, QUEUED = 0, STOP = 0;
+static int N_PATHS = 0, N_FAILURES = 0;
+static struct timespec START;
+
+static double elapsed(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - START.tv_sec) + 1e-9 * (now.tv_nsec - START.tv_nsec);
+}
+
+static void wake_all(void) {
+    pthread_mutex_lock(&POOL_LOCK);
+    pthread_cond_broadcast(&IDLE);
+    pthread_mutex_unlock(&POOL_LOCK);
+}
+
+// Out of budget: everything not yet finished is abandoned.
+static void check_budget(void) {
+    if (TIMEOUT > 0 && elapsed() > TIMEOUT && !__atomic_exchange_n(&STOP, 1, __ATOMIC_RELAXED))
+        wake_all();
+}
+
+static void push(struct worker *w, struct state *s) {
+    pthread_mutex_lock(&w->lock);
+    APPEND_FIELD(*w, states) = s;
+    pthread_mutex_unlock(&w->lock);
+    __atomic_fetch_add(&QUEUED, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&POOL_LOCK);
+    pthread_cond_signal(&IDLE);
+    pthread_mutex_unlock(&POOL_LOCK);
+}
+
+// Which of @w's states the search strategy runs next. A thief takes the
+// oldest state in DFS, the root of the biggest unexplored subtree.
+static int pick(struct worker *w, unsigned *seed, int stealing) {
+    switch (SEARCH) {
+        case SEARCH_DFS:
+            return stealing ? 0 : w->n_states - 1;
+        case SEARCH_BFS:
+            return 0;
+        case SEARCH_RANDOM_PATH: {
+            // a random walk down the execution tree ends at a state with
+            // probability 2^-depth
+            int min_depth = w->states[0]->depth;
+            for (int i = 1; i < w->n_states; i++)
+                if (w->states[i]->depth < min_depth) min_depth = w->states[i]->depth;
+            double total = 0;
+            for (int i = 0; i < w->n_states; i++) {
+                int d = w->states[i]->depth - min_depth;
+                total += 1.0 / (double) (1UL << (d < 62 ? d : 62));
+            }
+            double r = total * rand_r(seed) / ((double) RAND_MAX + 1);
+            for (int i = 0; i < w->n_states; i++) {
+                int d = w->states[i]->depth - min_depth;
+                r -= 1.0 / (double) (1UL << (d < 62 ? d : 62));
+                if (r < 0) return i;
+            }
+            return w->n_states - 1;
+        }
+        case SEARCH_COVNEW: {
+            if (CONCOLIC) {
+                // the child of the run that covered the most; the newest
+                // one on ties
+                int best = w->n_states - 1;
+                for (int i = w->n_states - 1; i >= 0; i--)
+                    if (w->states[i]->score > w->states[best]->score) best = i;
+                return best;
+            }
+            // the state about to run the least-covered instruction; the
+            // newest one on ties
+            int best = w->n_states - 1;
+            for (int i = w->n_states - 1; i >= 0; i--) {
+                int pc = w->states[i]->pc;
+                int cov = (pc < N_PROGRAM) ? __atomic_load_n(&COVERAGE[pc], __ATOMIC_RELAXED) : 0;
+                int pc_best = w->states[best]->pc;
+                int cov_best = (pc_best < N_PROGRAM) ? __atomic_load_n(&COVERAGE[pc_best], __ATOMIC_RELAXED) : 0;
+                if (cov < cov_best) best = i;
+            }
+            return best;
+        }
+    }
+    return 0;
+}
+
+static struct state *take_from(struct worker *w, unsigned *seed, int stealing) {
+    struct state *s = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->n_states) {
+        int i = pick(w, seed, stealing);
+        s = w->states[i];
+        memmove(w->states + i, w->states + i + 1, (w->n_states - i - 1) * sizeof(s));
+        w->n_states--;
+    }
+    pthread_mutex_unlock(&w->lock);
+    if (s) __atomic_fetch_sub(&QUEUED, 1, __ATOMIC_RELAXED);
+    return s;
+}
+
+static struct state *take(struct worker *w) {
+    struct state *s = take_from(w, &w->seed, 0);
+    int start = rand_r(&w->seed) % N_THREADS;
+    for (int i = 0; !s && i < N_THREADS; i++) {
+        struct worker *victim = &WORKERS[(start + i) % N_THREADS];
+        if (victim != w) s = take_from(victim, &w->seed, 1);
+    }
+    return s;
+}
+
+// Concolic mode (-concolic): every state runs the program on concrete
+// inputs, s->input, following them at each branch and only recording the
+// symbolic condition. When a run ends, generational search (after SAGE)
+// expands it: for each recorded branch past the run's bound, the solver
+// is asked for inputs that agree with the path up to that branch and then
+// go the other way, and each answer becomes a new run. A child's bound is
+// one past the branch it flipped, so the branches its parent already
+// flipped are left to the parent's other children, and every feasible path
+// runs exactly once. Under covnew, the children of the run that covered
+// the most new instructions go first.
+
+// @over's inputs and initial memory, and @base's for the rest.
+static struct model *merge_models(const struct model *over, const struct model *base) {
+    struct model *m = calloc(1, sizeof(*m));
+    int n_inputs = over->n_inputs + base->n_inputs;
+    m->input_ids = malloc(n_inputs * sizeof(m->input_ids[0]));
+    m->input_values = malloc(n_inputs * sizeof(m->input_values[0]));
+    for (int i = 0, j = 0; i < over->n_inputs || j < base->n_inputs; ) {
+        int take_over = j == base->n_inputs
+            || (i < over->n_inputs && over->input_ids[i] <= base->input_ids[j]);
+        if (take_over && j < base->n_inputs && over->input_ids[i] == base->input_ids[j]) j++;
+        m->input_ids[m->n_inputs] = take_over ? over->input_ids[i] : base->input_ids[j];
+        m->input_values[m->n_inputs++] = take_over ? over->input_values[i++] : base->input_values[j++];
+    }
+    int n_memory = over->n_memory + base->n_memory;
+    m->memory_keys = malloc(n_memory * sizeof(m->memory_keys[0]));
+    m->memory_values = malloc(n_memory * sizeof(m->memory_values[0]));
+    for (int i = 0, j = 0; i < over->n_memory || j < base->n_memory; ) {
+        int take_over = j == base->n_memory
+            || (i < over->n_memory && over->memory_keys[i] <= base->memory_keys[j]);
+        if (take_over && j < base->n_memory && over->memory_keys[i] == base->memory_keys[j]) j++;
+        m->memory_keys[m->n_memory] = take_over ? over->memory_keys[i] : base->memory_keys[j];
+        m->memory_values[m->n_memory++] = take_over ? over->memory_values[i++] : base->memory_values[j++];
+    }
+    return m;
+}
+
+static void free_model(struct model *m) {
+    free(m->input_ids);
+    free(m->input_values);
+    free(m->memory_keys);
+    free(m->memory_values);
+    free(m);
+}
 
-    // Create an array to represent program memory (uncomment once your solver
-    // supports arrays!)
-    // int array_memory = new_array();
+// Queues the children of @s, a concolic run that just ended, on @w.
+static void expand(struct worker *w, struct state *s) {
+    int n = 0;
+    for (struct constraint *c = s->path; c; c = c->next) n++;
+    struct constraint **path = malloc(n * sizeof(path[0]));     // oldest first
+    int i = n;
+    for (struct constraint *c = s->path; c; c = c->next) path[--i] = c;
+
+    for (int j = s->bound; j < n && !__atomic_load_n(&STOP, __ATOMIC_RELAXED); j++) {
+        check_budget();
+        struct constraint *c = path[j];
+        struct model *model = NULL;
+        if (!query(c->next, c->cond, !c->holds, &model)) continue;
+
+        // The model only has to cover the constraints the branch shares
+        // symbols with, so keep the old inputs for the rest. A model the
+        // cache reused can still disagree with the old inputs elsewhere;
+        // then solve the whole prefix.
+        struct model *input = merge_models(model, s->input);
+        struct constraint flipped = { c->cond, !c->holds, c->next };
+        N_SLICE = 0;
+        for (struct constraint *d = &flipped; d; d = d->next) APPEND_GLOBAL(SLICE) = d;
+        if (!model_satisfies(input, SLICE, N_SLICE)) {
+            free_model(input);
+            input = NULL;
+            __atomic_fetch_add(&N_QUERIES, 1, __ATOMIC_RELAXED);
+            // query() said SAT, so this should be too; if the cache was
+            // wrong, drop the child rather than run it without inputs.
+            if (!solve_constraints(SLICE, N_SLICE, &input)) continue;
+        }
+
+        struct state *child = new_state();
+        child->input = input;
+        child->bound = child->depth = j + 1;
+        child->score = s->score;
+        __atomic_fetch_add(&LIVE, 1, __ATOMIC_RELAXED);
+        push(w, child);
+    }
+    free(path);
+    free_model(s->input);
+}
+
+static void finish(struct worker *w, struct state *s, int failed) {
+    if (s->input) expand(w, s);
+    int paths = __atomic_add_fetch(&N_PATHS, 1, __ATOMIC_RELAXED);
+    if (failed) __atomic_fetch_add(&N_FAILURES, 1, __ATOMIC_RELAXED);
+    free_state(s);
+    if (MAX_PATHS && paths >= MAX_PATHS) __atomic_store_n(&STOP, 1, __ATOMIC_RELAXED);
+    if (!__atomic_sub_fetch(&LIVE, 1, __ATOMIC_ACQ_REL) || STOP) wake_all();
+}
 
-    // Do the symbolic interpretation. We generally use dst src ordering.
-    int pc = 0;
-    while (pc < N_PROGRAM) {
-        struct instruction instruction = PROGRAM[pc++];
-        printf("[%d] %s\n", getpid(), op_names[instruction.op]);
-        int bv_lhs, bv_rhs, bv_dst_addr, bv_src;
+// Runs @s until it ends or forks; a fork pushes both halves back on @w's
+// queue, so the search strategy decides what runs next.
+static void run(struct worker *w, struct state *s) {
+    if (s->input) {
+        ROUND++;        // eval() memo, for this run's input
+        s->score = 0;   // from here on, what this run covers first
+    }
+    while (1) {
+        if (__atomic_load_n(&STOP, __ATOMIC_RELAXED)) {
+            free_state(s);      // abandoned; stays counted in LIVE
+            return;
+        }
+        if (s->pc >= N_PROGRAM) {
+            finish(w, s, 0);
+            return;
+        }
+        if (!__atomic_fetch_add(&COVERAGE[s->pc], 1, __ATOMIC_RELAXED)) s->score++;
+        struct instruction instruction = PROGRAM[s->pc++];
+        if (TRACE) printf("[%d] %s\n", s->id, op_names[instruction.op]);
+        int64_t *args = instruction.args;
         switch (instruction.op) {
             // Register Operations
             case OP_IMMEDIATE:  // immediate dstreg value
-                assert(!"Implement me");
+                set_register(s, args[0], term_const(args[1]));
                 break;
             case OP_MOVE:       // move dstreg srcreg
-                assert(!"Implement me");
+                set_register(s, args[0], get_register(s, args[1]));
                 break;
             case OP_ADD:        // add dstreg op1reg op2reg
-                assert(!"Implement me");
+            case OP_SUB:        // (and likewise)
+            case OP_MUL:
+            case OP_UDIV:
+            case OP_UREM:
+            case OP_AND:
+            case OP_OR:
+            case OP_XOR:
+            case OP_SHL:
+            case OP_LSHR:
+            case OP_ASHR:
+                set_register(s, args[0], term_op(ALU_TERMS[instruction.op],
+                                                 get_register(s, args[1]),
+                                                 get_register(s, args[2])));
+                break;
+            case OP_NOT:        // not dstreg srcreg
+                set_register(s, args[0], term_op(T_NOT, get_register(s, args[1]), NULL));
                 break;
 
             // Memory operations
-            case OP_STORE:      // store addrreg valuereg
-                // Get a bv for the destination address register and source
-                // register value, then do a set to memory.
-                // IMPORTANT: Afterwards, append to IN_VARS like so:
-                // APPEND_GLOBAL(IN_VARS) = (struct in_var){
-                //     .register_number = -1,
-                //     .bv_key = bv_dst_addr,
-                //     .is_store = 1,
-                // };
-                assert(!"Implement me");
+            case OP_STORE: {    // store addrreg valuereg
+                struct term *addr = get_register(s, args[0]);
+                s->mem = term_store(s->mem, addr, get_register(s, args[1]));
+                add_in_var(s, (struct in_var){
+                    .register_number = -1,
+                    .key = addr,
+                    .is_store = 1,
+                });
                 break;
-            case OP_LOAD:       // load addrreg dstvaluereg
-                // Get a bv for the source address register, do a get from
-                // memory, then set the destination register to the result.
-                // IMPORTANT: Afterwards, append to IN_VARS like so:
-                // APPEND_GLOBAL(IN_VARS) = (struct in_var){
-                //     .register_number = -1,
-                //     .bv_id = bv_dst_register_value,
-                //     .bv_key = bv_source_address_register,
-                //     .is_store = 0,
-                // };
-                assert(!"Implement me");
+            }
+            case OP_LOAD: {     // load addrreg dstvaluereg
+                struct term *addr = get_register(s, args[0]);
+                struct term *value = term_load(s->mem, addr);
+                set_register(s, args[1], value);
+                add_in_var(s, (struct in_var){
+                    .register_number = -1,
+                    .value = value,
+                    .key = addr,
+                    .is_store = 0,
+                });
                 break;
+            }
 
             // Branching
             case OP_BRANCH_EQ:  // branch_eq op1 op2 offset_if_eq
-                // Get bvs for the two register arguments. Fork, asserting
-                // equality/disequality in each process and update the pc as
-                // necessary. Note that, if the values are equal, we should
-                // jump to the pc of this instruction + offset_if_eq. But above
-                // we've already done pc++, so you need one fewer.
-                assert(!"Implement me");
+            case OP_BRANCH_ULT: // (and likewise)
+            case OP_BRANCH_SLT: {
+                // Note that, if the values are equal, we should jump to the
+                // pc of this instruction + offset_if_eq. But above we've
+                // already done pc++, so we need one fewer.
+                int target = s->pc - 1 + args[2];
+                struct term *cond = (instruction.op == OP_BRANCH_EQ)
+                    ? term_eq(get_register(s, args[0]), get_register(s, args[1]))
+                    : term_op(ALU_TERMS[instruction.op], get_register(s, args[0]),
+                              get_register(s, args[1]));
+                if (cond->kind == T_CONST) {
+                    if (cond->value) s->pc = target;
+                    break;
+                }
+                if (s->input) {
+                    // concolic: follow the input, remember the condition
+                    int holds = eval(cond, s->input);
+                    constrain(s, cond, holds);
+                    if (holds) s->pc = target;
+                    break;
+                }
+                // The path condition is satisfiable, so if one side is not,
+                // the other one is.
+                check_budget();
+                int taken = query(s->path, cond, 1, NULL);
+                int not_taken = !taken || query(s->path, cond, 0, NULL);
+                if (taken && not_taken) {
+                    struct state *child = fork_state(s);
+                    constrain(child, cond, 1);
+                    child->pc = target;
+                    child->depth++;
+                    constrain(s, cond, 0);
+                    s->depth++;
+                    __atomic_fetch_add(&LIVE, 1, __ATOMIC_RELAXED);
+                    push(w, s);
+                    push(w, child);
+                    return;
+                }
+                if (taken) s->pc = target;
                 break;
+            }
 
             // Success & failure
             case OP_FAIL:
-                if (solve()) {
-                    printf("[%d] Found solution:\n", getpid());
-                    for (int i = 0; i < N_IN_VARS; i++) {
-                        if (IN_VARS[i].register_number >= 0) {
-                            printf("\t[%d] Register %d = %ld\n", getpid(),
-                                   IN_VARS[i].register_number,
-                                   get_solution(IN_VARS[i].bv_id, 0));
-                        } else if (IN_VARS[i].is_store) {
-                            continue;
-                        } else {
-                            int key = get_solution(IN_VARS[i].bv_key, 0);
-                            // Make sure we haven't read from/wrote to this key
-                            // before
-                            int found = 0;
-                            for (int j = 0; j < i; j++) {
-                                if (IN_VARS[j].register_number == -1
-                                        && get_solution(IN_VARS[j].bv_key, 0) == key) {
-                                    found = 1;
-                                    break;
-                                }
-                            }
-                            if (found) continue;
-                            printf("\t[%d] Memory[%d] = %ld\n", getpid(),
-                                   key, get_solution(IN_VARS[i].bv_id, 0));
-                        }
-                    }
-                }
+                if (s->input) print_solution(s, s->input);
+                else print_failure(s);
+                finish(w, s, 1);
+                return;
             case OP_EXIT:
-                return 0;
+                finish(w, s, 0);
+                return;
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    while (1) {
+        struct state *s = take(w);
+        if (s) {
+            run(w, s);
+            check_budget();
+            continue;
         }
+        pthread_mutex_lock(&POOL_LOCK);
+        while (!__atomic_load_n(&QUEUED, __ATOMIC_RELAXED)
+                && __atomic_load_n(&LIVE, __ATOMIC_RELAXED)
+                && !__atomic_load_n(&STOP, __ATOMIC_RELAXED))
+            pthread_cond_wait(&IDLE, &POOL_LOCK);
+        int done = !__atomic_load_n(&LIVE, __ATOMIC_RELAXED)
+                || __atomic_load_n(&STOP, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&POOL_LOCK);
+        if (done) break;
     }
+    return NULL;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options] < program\n"
+            "  -threads=N      worker threads (default: one per core)\n"
+            "  -search=S       dfs (default), bfs, random-path or covnew\n"
+            "                  (coverage-new-first)\n"
+            "  -max-paths=N    stop after N paths have ended (0: no limit)\n"
+            "  -timeout=S      stop after S seconds (0: no limit)\n"
+            "  -trace          print every instruction as it runs\n"
+            "  -no-cache       send every branch query to the solver whole\n"
+            "  -concolic       run on concrete inputs and solve for new ones,\n"
+            "                  one flipped branch at a time\n",
+            argv0);
+    exit(1);
+}
+
+/**** main symbolic interpreter ****/
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!strncmp(arg, "-threads=", 9)) N_THREADS = atoi(arg + 9);
+        else if (!strncmp(arg, "-max-paths=", 11)) MAX_PATHS = atoi(arg + 11);
+        else if (!strncmp(arg, "-timeout=", 9)) TIMEOUT = atof(arg + 9);
+        else if (!strcmp(arg, "-trace")) TRACE = 1;
+        else if (!strcmp(arg, "-no-cache")) NO_CACHE = 1;
+        else if (!strcmp(arg, "-concolic")) CONCOLIC = 1;
+        else if (!strncmp(arg, "-search=", 8)) {
+            int found = 0;
+            for (int s = 0; s < sizeof(search_names) / sizeof(search_names[0]); s++) {
+                if (!strcmp(arg + 8, search_names[s])) {
+                    SEARCH = s;
+                    found = 1;
+                }
+            }
+            if (!found) usage(argv[0]);
+        } else usage(argv[0]);
+    }
+    if (N_THREADS <= 0) N_THREADS = sysconf(_SC_NPROCESSORS_ONLN);
+    if (N_THREADS <= 0) N_THREADS = 1;
+
+    // Parse the input program
+    char opcode[20];
+    int64_t args[3];
+    while (!feof(stdin)) {
+        memset(args, 0, sizeof(args));
+        if (scanf("%s %ld %ld %ld ", opcode, &(args[0]), &(args[1]), &(args[2])) < 1) break;
+        if (!strcmp(opcode, ";")) {
+            while (getc(stdin) != '\n');
+            continue;
+        }
+        enum op op = OP_EXIT;
+        for (int i = 0; i < sizeof(op_names) / sizeof(op_names[0]); i++) {
+            if (!strcmp(opcode, op_names[i])) {
+                op = i;
+                break;
+            }
+        }
+        APPEND_GLOBAL(PROGRAM).op = op;
+        memcpy(PROGRAM[N_PROGRAM - 1].args, args, sizeof(args));
+    }
+    COVERAGE = calloc(N_PROGRAM + 1, sizeof(COVERAGE[0]));
+    for (int i = 0; i < TERM_LOCKS; i++) pthread_mutex_init(&TERM_LOCK[i], NULL);
+
+    // Memory starts out as an array of inputs
+    INITIAL_MEMORY = term_new(M_INITIAL, 0, NULL, NULL, NULL);
+
+    // Do the symbolic interpretation, starting from one state at pc 0. We
+    // generally use dst src ordering. The first concolic run has all inputs
+    // and memory 0.
+    clock_gettime(CLOCK_MONOTONIC, &START);
+    WORKERS = calloc(N_THREADS, sizeof(WORKERS[0]));
+    for (int i = 0; i < N_THREADS; i++) {
+        pthread_mutex_init(&WORKERS[i].lock, NULL);
+        WORKERS[i].seed = i + 1;
+    }
+    LIVE = 1;
+    struct state *initial = new_state();
+    if (CONCOLIC) initial->input = calloc(1, sizeof(struct model));
+    push(&WORKERS[0], initial);
+    for (int i = 0; i < N_THREADS; i++)
+        pthread_create(&WORKERS[i].thread, NULL, worker_main, &WORKERS[i]);
+    for (int i = 0; i < N_THREADS; i++)
+        pthread_join(WORKERS[i].thread, NULL);
+
+    fprintf(stderr, "%d paths (%d failing), %d unexplored, %d queries, "
+            "%d threads, %s%s, %.2fs\n", N_PATHS, N_FAILURES, LIVE, N_QUERIES,
+            N_THREADS, search_names[SEARCH], CONCOLIC ? ", concolic" : "", elapsed());
+    print_cache_stats();
     return 0;
 }
@@ -5,13 +5,18 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include "smt.h"
+#include "cdcl.h"
+
+// All of the solver state below is per thread: each thread builds and
+// solves its own queries, and smt_reset() clears the thread's state for the
+// next one. Handles are only meaningful on the thread that made them.
 
 // Keep track of clauses to be sent to the SAT solver
 struct clause {
     int *literals, n_literals;
 };
-static struct clause *CLAUSES = NULL;
-static int N_CLAUSES = 0;
+static _Thread_local struct clause *CLAUSES = NULL;
+static _Thread_local int N_CLAUSES = 0;
 
 void clause_arr(int *literals) {
     int i = N_CLAUSES;
@@ -39,181 +44,788 @@ struct array {
     struct bv_lookup *bv_lookups;
     int n_bv_lookups;
 };
-static struct array *ARRAYS = NULL;
-static int N_ARRAYS = 0;
+static _Thread_local struct array *ARRAYS = NULL;
+static _Thread_local int N_ARRAYS = 0;
+
+// And-inverter graph. Every bit is a literal of it: a node id, negated for
+// the node's negation, so literals go straight into clause(). Node 1 is the
+// constant TRUE (AIG_TRUE = 1, AIG_FALSE = -1); every other node is an
+// input (a fresh variable) or the AND of two literals. ANDs are
+// hash-consed: asking for the same AND twice gives the same node, after
+// constants and trivial cases are folded away. Children always have
+// smaller ids than their parents. Nothing becomes CNF until solve(), and
+// then only the nodes the clauses reach.
+#define AIG_TRUE 1
+#define AIG_FALSE (-1)
+
+struct aig_node {
+    int lhs, rhs;           // both 0 for inputs and the constant
+};
+static _Thread_local struct aig_node *AIG = NULL;
+static _Thread_local int N_AIG = 0;
+
+// open addressing over AND nodes, keyed by (lhs, rhs); 0 is empty
+static _Thread_local int *AIG_TABLE = NULL;
+static _Thread_local unsigned AIG_TABLE_SIZE = 0, AIG_TABLE_USED = 0;
+
+static unsigned aig_hash(int lhs, int rhs) {
+    return ((unsigned) lhs * 2654435761u) ^ ((unsigned) rhs * 40503u);
+}
+
+// The two nodes every AIG has; a query of only constants has no others.
+static void aig_init(void) {
+    if (N_AIG) return;
+    APPEND_GLOBAL(AIG) = (struct aig_node){ 0, 0 };   // unused: 0 ends clauses
+    APPEND_GLOBAL(AIG) = (struct aig_node){ 0, 0 };   // TRUE
+}
+
+static int aig_node(int lhs, int rhs) {
+    aig_init();
+    APPEND_GLOBAL(AIG) = (struct aig_node){ lhs, rhs };
+    return N_AIG - 1;
+}
 
-// Keep track of bitvectors
+// You can get a fresh SAT variable with aig_input()
+static int aig_input(void) {
+    return aig_node(0, 0);
+}
+
+static void aig_table_insert(int node) {
+    unsigned mask = AIG_TABLE_SIZE - 1;
+    unsigned h = aig_hash(AIG[node].lhs, AIG[node].rhs) & mask;
+    while (AIG_TABLE[h]) h = (h + 1) & mask;
+    AIG_TABLE[h] = node;
+    AIG_TABLE_USED++;
+}
+
+static int aig_and(int a, int b) {
+    if (a > b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    if (a == AIG_FALSE || a == -b) return AIG_FALSE;
+    if (a == AIG_TRUE || a == b) return b;
+    if (b == AIG_TRUE) return a;
+    if (b == AIG_FALSE) return AIG_FALSE;
+
+    if (2 * (AIG_TABLE_USED + 1) > AIG_TABLE_SIZE) {
+        free(AIG_TABLE);
+        AIG_TABLE_SIZE = AIG_TABLE_SIZE ? 2 * AIG_TABLE_SIZE : 1024;
+        AIG_TABLE = calloc(AIG_TABLE_SIZE, sizeof(AIG_TABLE[0]));
+        AIG_TABLE_USED = 0;
+        for (int n = 2; n < N_AIG; n++)
+            if (AIG[n].lhs) aig_table_insert(n);
+    }
+    unsigned mask = AIG_TABLE_SIZE - 1;
+    for (unsigned h = aig_hash(a, b) & mask; AIG_TABLE[h]; h = (h + 1) & mask) {
+        struct aig_node *n = &AIG[AIG_TABLE[h]];
+        if (n->lhs == a && n->rhs == b) return AIG_TABLE[h];
+    }
+    int node = aig_node(a, b);
+    aig_table_insert(node);
+    return node;
+}
+
+static int aig_or(int a, int b) { return -aig_and(-a, -b); }
+
+static int aig_xor(int a, int b) {
+    return aig_or(aig_and(a, -b), aig_and(-a, b));
+}
+
+// s ? x : y
+static int aig_mux(int s, int x, int y) {
+    if (x == y) return x;
+    return aig_or(aig_and(s, x), aig_and(-s, y));
+}
+
+// Keep track of bitvectors; bits[i] is the AIG literal for bit i
 struct bv {
     int *bits;
     int n_bits;
 };
-static struct bv *BVS = NULL;
-static int N_BVS = 0;
-
-// You can get a fresh SAT variable like NEXT_SAT_VAR++
-static int NEXT_SAT_VAR = 1;
+static _Thread_local struct bv *BVS = NULL;
+static _Thread_local int N_BVS = 0;
+
+static int bv_from_bits(const int *bits, int width) {
+    int bv = N_BVS;
+    APPEND_GLOBAL(BVS) = (struct bv){ NULL, 0 };
+    for (int i = 0; i < width; i++)
+        APPEND_FIELD(BVS[bv], bits) = bits[i];
+    return bv;
+}
 
 int new_array() {
-    // Create a new array. It has no parent (-1) and no lookups yet (NULL, 0).
-    // Returns its index in the ARRAYS vector.
-    assert(!"Implement me!");
+    APPEND_GLOBAL(ARRAYS) = (struct array){
+        .array_parent = -1,
+        .bv_lookups = NULL,
+        .n_bv_lookups = 0,
+    };
+    return N_ARRAYS - 1;
 }
 
 int array_store(int old_array, int bv_key, int bv_value) {
-    // Construct a new array that is the same as old_array except bv_key is
-    // updated to bv_value. This should look like new_array() except you set
-    // array_parent, bv_store_key, bv_store_value correctly.
-    assert(!"Implement me!");
+    APPEND_GLOBAL(ARRAYS) = (struct array){
+        .array_parent = old_array,
+        .bv_store_key = bv_key,
+        .bv_store_value = bv_value,
+        .bv_lookups = NULL,
+        .n_bv_lookups = 0,
+    };
+    return N_ARRAYS - 1;
 }
 
+// The value is a fresh bitvector; what ties it to the stores and the other
+// lookups is left to solve(), which adds only the axioms a model breaks.
 int array_get(int array, int bv_key, int out_width) {
-    // Create a new bitvector and (on the corresponding array) record this
-    // key/value pair lookup.
-    assert(!"Implement me!");
+    int bv_value = new_bv(out_width);
+    APPEND_FIELD(ARRAYS[array], bv_lookups) = (struct bv_lookup){
+        .bv_key = bv_key,
+        .bv_value = bv_value,
+    };
+    return bv_value;
 }
 
 int new_bv(int width) {
-    // Create a fresh bitvector of the given width. Note here you need to
-    // append to the BVS vector as well as initialize all its bits to fresh SAT
-    // variables.
-    assert(!"Implement me!");
+    int bv = N_BVS;
+    APPEND_GLOBAL(BVS) = (struct bv){ NULL, 0 };
+    for (int i = 0; i < width; i++)
+        APPEND_FIELD(BVS[bv], bits) = aig_input();
+    return bv;
 }
 
+// Constant bits are the constant literals; no variables, no clauses.
 int const_bv(int64_t value, int width) {
-    // Like new_bv, except also add clauses asserting its bits are the same as
-    // those of @value. Please do little-endian; bits[0] should be value & 1.
-    assert(!"Implement me!");
+    int bv = N_BVS;
+    APPEND_GLOBAL(BVS) = (struct bv){ NULL, 0 };
+    for (int i = 0; i < width; i++)
+        APPEND_FIELD(BVS[bv], bits) = ((value >> i) & 1) ? AIG_TRUE : AIG_FALSE;
+    return bv;
 }
 
 int bv_eq(int bv_1, int bv_2) {
     int width = BVS[bv_1].n_bits;
     assert(width == BVS[bv_2].n_bits);
 
-    // This one is a doozy: add a fresh SAT variable and enough SAT clauses to
-    // assert that this variable is true iff all the bits of bv_1 and bv_2 are
-    // equal. I suggest using as many of intermediate/temp SAT variables as you
-    // need; generally, BCP does a great job at handling those so they're more
-    // or less "free" (at least, for our purposes rn!).
-    assert(!"Implement me!");
+    // the AND of the bitwise XNORs
+    int eq = AIG_TRUE;
+    for (int i = 0; i < width && eq != AIG_FALSE; i++)
+        eq = aig_and(eq, -aig_xor(BVS[bv_1].bits[i], BVS[bv_2].bits[i]));
+    return eq;
+}
+
+// a + b + carry, as one full adder; *carry becomes the carry out
+static int full_add(int a, int b, int *carry) {
+    int half = aig_xor(a, b);
+    int sum = aig_xor(half, *carry);
+    *carry = aig_or(aig_and(a, b), aig_and(*carry, half));
+    return sum;
 }
 
 int bv_add(int bv_1, int bv_2) {
     int width = BVS[bv_1].n_bits;
     assert(width == BVS[bv_2].n_bits);
 
-    int out = new_bv(width);
+    // ripple carry
+    int *bits = malloc(width * sizeof(bits[0]));
+    int carry = AIG_FALSE;
+    for (int i = 0; i < width; i++)
+        bits[i] = full_add(BVS[bv_1].bits[i], BVS[bv_2].bits[i], &carry);
+    int out = bv_from_bits(bits, width);
+    free(bits);
+    return out;
+}
 
-    // This one is similarly big; basically you want to do a ripple-carry
-    // adder to assign the bits of @out based on the bits of @bv_1, @bv_2. I
-    // would recommend just trying to encode it as a truth table.
-    assert(!"Implement me!");
+// The bit-level circuits below are all built out of aig_and(), so constant
+// operand bits fold away as they are built (multiplying by a constant
+// leaves only its shifted adds, shifting by one only wires) and the same
+// sub-circuit on the same bits is only built once.
+
+// out = a - b over @width bits, as a + ~b + 1; returns the carry out, which
+// is set iff a >= b (unsigned).
+static int subtract(const int *a, const int *b, int width, int *out) {
+    int carry = AIG_TRUE;
+    for (int i = 0; i < width; i++) out[i] = full_add(a[i], -b[i], &carry);
+    return carry;
 }
 
-static void array_axioms(struct array array, int compare_up_to,
-                         struct bv_lookup bv_lookup, int already_handled) {
-    if (array.array_parent >= 0) {
-        // This array is of the form (store parent k v), where k and v are
-        // array.bv_store_*. Add clauses here of the form:
-        // ((k == lookup.key) ^ !already_handled) => (store_val == bv_val)
-        // Hint: use bv_eq!
-        assert(!"Implement me!");
+// Comparisons scan from the bottom bit up: where the bits differ, the
+// higher bit decides, so each bit is one XOR and one mux. The XORs are
+// the ones bv_eq() and the adders build on the same bits, and ult and slt
+// of the same operands share every bit but the sign bit, where slt says
+// a < b if a is the negative one.
+static int less_than(int bv_1, int bv_2, int is_signed) {
+    int width = BVS[bv_1].n_bits;
+    assert(width == BVS[bv_2].n_bits);
 
-        // Now we need to record if that worked or not. If this is picking up
-        // that store, then we don't need the value to match with any prior
-        // values (because they were overridden). So make a fresh SAT variable
-        // new_already_handled and assign it:
-        // (already_handled or (k == lookup.key)) <=> new_already_handled
-        assert(!"Implement me!");
+    int lt = AIG_FALSE;
+    for (int i = 0; i < width; i++) {
+        int a = BVS[bv_1].bits[i], b = BVS[bv_2].bits[i];
+        int sign = is_signed && i == width - 1;
+        lt = aig_mux(aig_xor(a, b), sign ? a : b, lt);
+    }
+    return lt;
+}
+
+int bv_ult(int bv_1, int bv_2) {
+    return less_than(bv_1, bv_2, 0);
+}
+
+int bv_slt(int bv_1, int bv_2) {
+    return less_than(bv_1, bv_2, 1);
+}
+
+enum bitwise { BITWISE_AND, BITWISE_OR, BITWISE_XOR };
+
+static int bitwise(int bv_1, int bv_2, enum bitwise op) {
+    int width = BVS[bv_1].n_bits;
+    assert(width == BVS[bv_2].n_bits);
+
+    int *bits = malloc(width * sizeof(bits[0]));
+    for (int i = 0; i < width; i++) {
+        int a = BVS[bv_1].bits[i], b = BVS[bv_2].bits[i];
+        switch (op) {
+            case BITWISE_AND: bits[i] = aig_and(a, b); break;
+            case BITWISE_OR:  bits[i] = aig_or(a, b); break;
+            case BITWISE_XOR: bits[i] = aig_xor(a, b); break;
+        }
+    }
+    int out = bv_from_bits(bits, width);
+    free(bits);
+    return out;
+}
+
+int bv_and(int bv_1, int bv_2) { return bitwise(bv_1, bv_2, BITWISE_AND); }
+int bv_or(int bv_1, int bv_2) { return bitwise(bv_1, bv_2, BITWISE_OR); }
+int bv_xor(int bv_1, int bv_2) { return bitwise(bv_1, bv_2, BITWISE_XOR); }
+
+// Negated literals are free in the AIG, so this adds no nodes at all.
+int bv_not(int bv) {
+    int width = BVS[bv].n_bits;
+    int *bits = malloc(width * sizeof(bits[0]));
+    for (int i = 0; i < width; i++) bits[i] = -BVS[bv].bits[i];
+    int out = bv_from_bits(bits, width);
+    free(bits);
+    return out;
+}
 
-        // Then update already_handled = new_already_handled
-        assert(!"Implement me!");
+int bv_sub(int bv_1, int bv_2) {
+    int width = BVS[bv_1].n_bits;
+    assert(width == BVS[bv_2].n_bits);
+
+    int *bits = malloc(width * sizeof(bits[0]));
+    subtract(BVS[bv_1].bits, BVS[bv_2].bits, width, bits);
+    int out = bv_from_bits(bits, width);
+    free(bits);
+    return out;
+}
+
+// Wallace tree: the partial products a_j & b_(i-j) of each output column
+// are reduced with full adders, three bits to a sum in the same column and
+// a carry into the next, layer by layer, until every column has at most
+// two; one ripple-carry adder then adds the two rows. That takes about as
+// many full adders as the shift-and-add array, but the depth is
+// logarithmic instead of linear, so the SAT solver's implication chains
+// are much shorter.
+// Columns from @width up are never built.
+int bv_mul(int bv_1, int bv_2) {
+    int width = BVS[bv_1].n_bits;
+    assert(width == BVS[bv_2].n_bits);
+    const int *a = BVS[bv_1].bits, *b = BVS[bv_2].bits;
+
+    // column i holds the bits of weight 2^i still to be added
+    int **column = calloc(width, sizeof(column[0]));
+    int *n_column = calloc(width, sizeof(n_column[0]));
+    for (int i = 0; i < width; i++) {
+        column[i] = malloc(2 * width * sizeof(column[i][0]));
+        for (int j = 0; j <= i; j++) {
+            int bit = aig_and(a[j], b[i - j]);
+            if (bit != AIG_FALSE) column[i][n_column[i]++] = bit;
+        }
     }
 
-    // If we haven't found a set yet, compare lookup[key] to all prior lookups
-    // on the array. If keys eq, vals should be eq too.
-    for (int i = 0; i < compare_up_to; i++) {
-        struct bv_lookup sub_lookup = array.bv_lookups[i];
-        // We want:
-        // !already_handled ^ (sub_lookup.key == bv_lookup.key)
-        // => sub_lookup.value == bv_lookup.value
-        assert(!"Implement me!");
+    int **next = calloc(width, sizeof(next[0]));
+    int *n_next = calloc(width, sizeof(n_next[0]));
+    for (int i = 0; i < width; i++) next[i] = malloc(2 * width * sizeof(next[i][0]));
+    for (int tall = 1; tall; ) {
+        tall = 0;
+        memset(n_next, 0, width * sizeof(n_next[0]));
+        for (int i = 0; i < width; i++) {
+            int k = 0;
+            for (; n_column[i] > 2 && k + 3 <= n_column[i]; k += 3) {
+                int carry = column[i][k + 2];
+                next[i][n_next[i]++] = full_add(column[i][k], column[i][k + 1], &carry);
+                if (i + 1 < width) next[i + 1][n_next[i + 1]++] = carry;
+            }
+            for (; k < n_column[i]; k++) next[i][n_next[i]++] = column[i][k];
+        }
+        for (int i = 0; i < width; i++) {
+            int *t = column[i];
+            column[i] = next[i];
+            next[i] = t;
+            n_column[i] = n_next[i];
+            tall |= n_column[i] > 2;
+        }
     }
 
-    // If we haven't found a set yet, go back through parents and repeat this
-    // reasoning.
-    if (array.array_parent >= 0) {
-        array_axioms(ARRAYS[array.array_parent],
-                     ARRAYS[array.array_parent].n_bv_lookups,
-                     bv_lookup, already_handled);
+    int *bits = calloc(width, sizeof(bits[0]));
+    int carry = AIG_FALSE;
+    for (int i = 0; i < width; i++) {
+        int x = n_column[i] > 0 ? column[i][0] : AIG_FALSE;
+        int y = n_column[i] > 1 ? column[i][1] : AIG_FALSE;
+        bits[i] = full_add(x, y, &carry);
     }
+    int out = bv_from_bits(bits, width);
+    free(bits);
+    for (int i = 0; i < width; i++) {
+        free(column[i]);
+        free(next[i]);
+    }
+    free(column);
+    free(next);
+    free(n_column);
+    free(n_next);
+    return out;
 }
 
-int *SAT_SOLUTION = NULL;
-int solve() {
-    assert(!SAT_SOLUTION);
-    char constraint_path[256] = "";
-    sprintf(constraint_path, "temp_files/constraints.%d.dimacs", getpid());
+// Restoring division, one row per quotient bit from the top: shift the
+// next bit of the dividend into the remainder, and if the remainder is at
+// least the divisor, subtract it (a mux between the two) and set the bit.
+// The comparison is the subtractor's own carry out. Division by zero
+// gives all ones and the dividend back, as in SMT-LIB.
+static void divide(int bv_1, int bv_2, int *quotient, int *remainder) {
+    int width = BVS[bv_1].n_bits;
+    assert(width == BVS[bv_2].n_bits);
 
-    FILE *fout = fopen(constraint_path, "w");
+    // the remainder gets one bit wider while the next dividend bit is in
+    int *rem = malloc((width + 1) * sizeof(rem[0]));
+    int *divisor = malloc((width + 1) * sizeof(divisor[0]));
+    int *diff = malloc((width + 1) * sizeof(diff[0]));
+    for (int i = 0; i < width; i++) {
+        rem[i] = AIG_FALSE;
+        divisor[i] = BVS[bv_2].bits[i];
+    }
+    divisor[width] = AIG_FALSE;
+    for (int i = width - 1; i >= 0; i--) {
+        memmove(rem + 1, rem, width * sizeof(rem[0]));
+        rem[0] = BVS[bv_1].bits[i];
+        int ge = subtract(rem, divisor, width + 1, diff);
+        quotient[i] = ge;
+        for (int k = 0; k < width; k++) rem[k] = aig_mux(ge, diff[k], rem[k]);
+    }
+    memcpy(remainder, rem, width * sizeof(rem[0]));
+    free(rem);
+    free(divisor);
+    free(diff);
+}
+
+int bv_udiv(int bv_1, int bv_2) {
+    int width = BVS[bv_1].n_bits;
+    int *quotient = malloc(width * sizeof(quotient[0]));
+    int *remainder = malloc(width * sizeof(remainder[0]));
+    divide(bv_1, bv_2, quotient, remainder);
+    int out = bv_from_bits(quotient, width);
+    free(quotient);
+    free(remainder);
+    return out;
+}
+
+int bv_urem(int bv_1, int bv_2) {
+    int width = BVS[bv_1].n_bits;
+    int *quotient = malloc(width * sizeof(quotient[0]));
+    int *remainder = malloc(width * sizeof(remainder[0]));
+    divide(bv_1, bv_2, quotient, remainder);
+    int out = bv_from_bits(remainder, width);
+    free(quotient);
+    free(remainder);
+    return out;
+}
+
+enum shift { SHIFT_LEFT, SHIFT_LOGICAL_RIGHT, SHIFT_ARITHMETIC_RIGHT };
+
+// Barrel shifter: one row of muxes per bit k of the shift amount, each
+// shifting by 2^k or not, so width * log2(width) muxes instead of a mux
+// tree over every amount for every bit. Amount bits worth width or more
+// shift everything out; they are ORed into one "too far" bit.
+static int shift(int bv, int bv_amount, enum shift kind) {
+    int width = BVS[bv].n_bits;
+    assert(width == BVS[bv_amount].n_bits);
+
+    int *bits = malloc(width * sizeof(bits[0]));
+    int *shifted = malloc(width * sizeof(shifted[0]));
+    memcpy(bits, BVS[bv].bits, width * sizeof(bits[0]));
+    const int *amount = BVS[bv_amount].bits;
+    int fill = (kind == SHIFT_ARITHMETIC_RIGHT) ? bits[width - 1] : AIG_FALSE;
+    int too_far = AIG_FALSE;
+    for (int k = 0; k < width && k < 31; k++) {
+        int by = 1 << k;
+        if (by >= width) {
+            too_far = aig_or(too_far, amount[k]);
+            continue;
+        }
+        for (int i = 0; i < width; i++) {
+            int from = (kind == SHIFT_LEFT) ? i - by : i + by;
+            int in = (from >= 0 && from < width) ? bits[from] : fill;
+            shifted[i] = aig_mux(amount[k], in, bits[i]);
+        }
+        memcpy(bits, shifted, width * sizeof(bits[0]));
+    }
+    for (int k = 31; k < width; k++) too_far = aig_or(too_far, amount[k]);
+    for (int i = 0; i < width; i++) bits[i] = aig_mux(too_far, fill, bits[i]);
+
+    int out = bv_from_bits(bits, width);
+    free(bits);
+    free(shifted);
+    return out;
+}
+
+int bv_shl(int bv, int bv_amount) { return shift(bv, bv_amount, SHIFT_LEFT); }
+int bv_lshr(int bv, int bv_amount) { return shift(bv, bv_amount, SHIFT_LOGICAL_RIGHT); }
+int bv_ashr(int bv, int bv_amount) { return shift(bv, bv_amount, SHIFT_ARITHMETIC_RIGHT); }
+
+// The CNF solve() hands to the SAT solver, each clause 0-terminated, over
+// N_SAT_VARS variables. SAT_VAR maps an AIG node to its variable (0: not
+// in the CNF); it has an entry for the first N_SAT_VAR_MAP nodes.
+static _Thread_local int *CNF = NULL, N_CNF = 0;
+static _Thread_local int *SAT_VAR = NULL, N_SAT_VARS = 0, N_SAT_VAR_MAP = 0;
 
-    int zero = NEXT_SAT_VAR++;
-    clause(-zero);
+static int sat_literal(int lit) {
+    return (lit < 0) ? -SAT_VAR[-lit] : SAT_VAR[lit];
+}
+
+// If node @n is NOT(s ? x : y), built by aig_mux() (or aig_xor(): p ^ q
+// is p ? -q : q) out of two ANDs nothing else uses and that are not in the
+// CNF yet, sets *s, *x and *y and returns 1.
+static int aig_is_mux(int n, const int *refs, int *s, int *x, int *y) {
+    int l = -AIG[n].lhs, r = -AIG[n].rhs;
+    if (l <= 0 || r <= 0 || !AIG[l].lhs || !AIG[r].lhs) return 0;
+    if (refs[l] != 1 || refs[r] != 1 || SAT_VAR[l] > 0 || SAT_VAR[r] > 0) return 0;
+    int a[] = { AIG[l].lhs, AIG[l].rhs }, b[] = { AIG[r].lhs, AIG[r].rhs };
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            if (a[i] != -b[j]) continue;
+            *s = a[i];
+            *x = a[1 - i];
+            *y = b[1 - j];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The inputs of the widest AND rooted at node @n: positive AND children
+// used nowhere else are flattened into it. With @absorb they are marked
+// (SAT_VAR -1) so they get no variable of their own; afterwards they are
+// recognised by having none. Nodes already in the CNF are always leaves.
+static _Thread_local int *LEAVES = NULL, N_LEAVES = 0;
+static _Thread_local int *STACK = NULL, N_STACK = 0;
+static void aig_leaves(int n, const int *refs, int absorb) {
+    int s, x, y;
+    N_LEAVES = N_STACK = 0;
+    APPEND_GLOBAL(STACK) = AIG[n].rhs;
+    APPEND_GLOBAL(STACK) = AIG[n].lhs;
+    while (N_STACK) {
+        int lit = STACK[--N_STACK];
+        int flatten = lit > 0 && AIG[lit].lhs && refs[lit] == 1 && !SAT_VAR[lit]
+                   && !(absorb && aig_is_mux(lit, refs, &s, &x, &y));
+        if (!flatten) {
+            APPEND_GLOBAL(LEAVES) = lit;
+            continue;
+        }
+        if (absorb) SAT_VAR[lit] = -1;
+        APPEND_GLOBAL(STACK) = AIG[lit].rhs;
+        APPEND_GLOBAL(STACK) = AIG[lit].lhs;
+    }
+}
+
+// Tseitin-encodes the AIG nodes that clauses @from.. reach and are not in
+// the CNF yet, then adds those clauses with the constants folded out.
+// Muxes (and so XORs) get their 4-clause encoding and chains of ANDs
+// become one wide AND, instead of a variable and 3 clauses per AIG node.
+static void encode_clauses(int from) {
+    SAT_VAR = realloc(SAT_VAR, (N_AIG + 1) * sizeof(SAT_VAR[0]));
+    memset(SAT_VAR + N_SAT_VAR_MAP, 0, (N_AIG + 1 - N_SAT_VAR_MAP) * sizeof(SAT_VAR[0]));
+    N_SAT_VAR_MAP = N_AIG + 1;
+
+    // fanout within the new part of the cone; children have smaller ids, so
+    // one downward pass does it. Nodes the clauses use directly always get
+    // a variable.
+    int *refs = calloc(N_AIG + 1, sizeof(refs[0]));
+    for (int i = from; i < N_CLAUSES; i++)
+        for (int j = 0; j < CLAUSES[i].n_literals; j++)
+            refs[abs(CLAUSES[i].literals[j])] += 2;
+    for (int n = N_AIG - 1; n >= 2; n--) {
+        if (!refs[n] || !AIG[n].lhs || SAT_VAR[n]) continue;
+        refs[abs(AIG[n].lhs)]++;
+        refs[abs(AIG[n].rhs)]++;
+    }
+
+    // pick the gates, top down, and number what is left
+    int s, x, y, first_var = N_SAT_VARS + 1;
+    for (int n = N_AIG - 1; n >= 2; n--) {
+        if (!refs[n] || !AIG[n].lhs || SAT_VAR[n]) continue;
+        if (aig_is_mux(n, refs, &s, &x, &y))
+            SAT_VAR[-AIG[n].lhs] = SAT_VAR[-AIG[n].rhs] = -1;
+        else
+            aig_leaves(n, refs, 1);
+    }
+    for (int n = 2; n < N_AIG; n++) {
+        if (SAT_VAR[n] < 0) SAT_VAR[n] = 0;
+        else if (refs[n] && !SAT_VAR[n]) SAT_VAR[n] = ++N_SAT_VARS;
+    }
 
-    // Go through array stores & lookups and set up the N^2 bv_eq implications
-    // implied
-    for (int i = 0; i < N_ARRAYS; i++) {
-        for (int j = 0; j < ARRAYS[i].n_bv_lookups; j++) {
-            array_axioms(ARRAYS[i], j, ARRAYS[i].bv_lookups[j], zero);
+    for (int n = 2; n < N_AIG; n++) {
+        if (SAT_VAR[n] < first_var || !AIG[n].lhs) continue;
+        int g = SAT_VAR[n];
+        if (aig_is_mux(n, refs, &s, &x, &y)) {
+            // g <=> (c ? -a : -b)
+            int c = sat_literal(s), a = sat_literal(x), b = sat_literal(y);
+            int gate[] = { -g, -c, -a, 0, -g, c, -b, 0, g, -c, a, 0, g, c, b, 0 };
+            for (int k = 0; k < 16; k++) APPEND_GLOBAL(CNF) = gate[k];
+            continue;
+        }
+        // g <=> leaves[0] & leaves[1] & ...
+        aig_leaves(n, refs, 0);
+        for (int k = 0; k < N_LEAVES; k++) {
+            APPEND_GLOBAL(CNF) = -g;
+            APPEND_GLOBAL(CNF) = sat_literal(LEAVES[k]);
+            APPEND_GLOBAL(CNF) = 0;
+        }
+        APPEND_GLOBAL(CNF) = g;
+        for (int k = 0; k < N_LEAVES; k++)
+            APPEND_GLOBAL(CNF) = -sat_literal(LEAVES[k]);
+        APPEND_GLOBAL(CNF) = 0;
+    }
+    free(refs);
+
+    for (int i = from; i < N_CLAUSES; i++) {
+        int start = N_CNF, sat = 0;
+        for (int j = 0; j < CLAUSES[i].n_literals && !sat; j++) {
+            int lit = CLAUSES[i].literals[j];
+            if (lit == AIG_TRUE) sat = 1;
+            else if (lit != AIG_FALSE) APPEND_GLOBAL(CNF) = sat_literal(lit);
         }
+        if (sat) N_CNF = start;
+        else APPEND_GLOBAL(CNF) = 0;
     }
+}
 
-    // Print the clauses and some info about the variable interpretations
+// Writes CNF as DIMACS, with the SAT variables of every bitvector in
+// comments (0 for a bit that is constant or not in the CNF), to
+// @dir/constraints.<pid>.<n>.dimacs for the process's n-th query. Only for
+// debugging (set SMT_DUMP_DIMACS=dir); solve() hands the clauses to the
+// solver directly.
+static int N_DUMPS = 0;
+static void dump_dimacs(const char *dir) {
+    char path[1024] = "";
+    snprintf(path, sizeof(path), "%s/constraints.%d.%d.dimacs", dir, getpid(),
+             __atomic_fetch_add(&N_DUMPS, 1, __ATOMIC_RELAXED));
+    FILE *fout = fopen(path, "w");
+    if (!fout) {
+        perror(path);
+        return;
+    }
     for (int i = 0; i < N_BVS; i++) {
         fprintf(fout, "c bitvector %d:", i);
         for (int j = 0; j < BVS[i].n_bits; j++)
-            fprintf(fout, " %d", BVS[i].bits[j]);
+            fprintf(fout, " %d", sat_literal(BVS[i].bits[j]));
         fprintf(fout, "\n");
     }
-    fprintf(fout, "p cnf %d %d\n", NEXT_SAT_VAR - 1, N_CLAUSES);
+    int n_clauses = 0;
+    for (int i = 0; i < N_CNF; i++) n_clauses += !CNF[i];
+    fprintf(fout, "p cnf %d %d\n", N_SAT_VARS, n_clauses);
+    for (int i = 0; i < N_CNF; i++)
+        fprintf(fout, CNF[i] ? "%d " : "%d\n", CNF[i]);
+    fclose(fout);
+}
+
+// The model, per AIG node: SAT_SOLUTION[n] is 1 if node n is true, else 0.
+// Inputs outside the CNF are unconstrained and read as 0.
+static _Thread_local int *SAT_SOLUTION = NULL;
+
+static void read_model(cdcl_t *sat) {
+    // AND nodes evaluate bottom-up, whether or not they made it into the CNF
+    SAT_SOLUTION = realloc(SAT_SOLUTION, (N_AIG + 1) * sizeof(SAT_SOLUTION[0]));
+    SAT_SOLUTION[AIG_TRUE] = 1;
+    for (int n = 2; n < N_AIG; n++) {
+        struct aig_node *node = &AIG[n];
+        if (!node->lhs) {
+            SAT_SOLUTION[n] = SAT_VAR[n] && cdcl_value(sat, SAT_VAR[n]);
+            continue;
+        }
+        int a = SAT_SOLUTION[abs(node->lhs)] ^ (node->lhs < 0);
+        int b = SAT_SOLUTION[abs(node->rhs)] ^ (node->rhs < 0);
+        SAT_SOLUTION[n] = a & b;
+    }
+}
 
-    // Iterate through the clauses and print them in DIMACS format.
-    assert(!"Implement me!");
+static uint64_t model_bv(int bv) {
+    uint64_t value = 0;
+    assert(BVS[bv].n_bits <= 64);
+    for (int i = 0; i < BVS[bv].n_bits; i++) {
+        int lit = BVS[bv].bits[i];
+        value |= (uint64_t) (SAT_SOLUTION[abs(lit)] ^ (lit < 0)) << i;
+    }
+    return value;
+}
 
-    fclose(fout);
+// Array axioms are added lazily. solve() first solves without any. In the
+// model, every lookup is then followed up its array's stores to the first
+// one whose key equals the lookup key (read-over-write), or to the root
+// array if none does. A lookup that stops at a store must give the stored
+// value; lookups that reach the same root with equal keys must give equal
+// values. Each violation adds the one lemma the model breaks,
+//     (key == store key) ^ (key != each store key passed) => value == stored
+//     (key_1 == key_2) ^ (key_i != each store key passed) => value_1 == value_2
+// and we solve again, until the model is consistent. bv_eq() folds
+// syntactically equal keys to a constant, so those drop out of the lemmas.
+
+// a lookup that got past every store, in the model
+struct root_read {
+    int root;
+    uint64_t key;
+    int array, lookup;
+};
+
+static int cmp_root_read(const void *a, const void *b) {
+    const struct root_read *x = a, *y = b;
+    if (x->root != y->root) return (x->root < y->root) ? -1 : 1;
+    if (x->key != y->key) return (x->key < y->key) ? -1 : 1;
+    return 0;
+}
+
+static _Thread_local int *LEMMA = NULL, N_LEMMA = 0;
 
-    char result_path[256] = "";
-    sprintf(result_path, "temp_files/results.%d.txt", getpid());
-
-    char cmd[1024] = "";
-#ifdef USE_MINISAT
-    sprintf(cmd, "minisat %s %s > /dev/null", constraint_path, result_path);
-#else
-    sprintf(cmd, "cat %s | ./fast > %s", constraint_path, result_path);
-#endif
-    assert(system(cmd) != -1);
-
-    FILE *results = fopen(result_path, "r");
-    char sat_or_unsat[10] = "NONE";
-    assert(fscanf(results, "%s ", sat_or_unsat));
-    if (!strcmp(sat_or_unsat, "UNSAT")) {
-        fclose(results);
-        return 0;
-    } else if (!strcmp(sat_or_unsat, "SAT")) {
-        SAT_SOLUTION = malloc(NEXT_SAT_VAR * sizeof(SAT_SOLUTION[0]));
-        int literal = 0;
-        while (!feof(results) && fscanf(results, " %d ", &literal)) {
-            if (literal < 0)    SAT_SOLUTION[-literal] = 0;
-            else                SAT_SOLUTION[literal] = 1;
+// Appends (store key == @bv_key) for each store from @array up to, not
+// including, array @upto.
+static void lemma_passed(int array, int upto, int bv_key) {
+    for (; array != upto && ARRAYS[array].array_parent >= 0;
+         array = ARRAYS[array].array_parent)
+        APPEND_GLOBAL(LEMMA) = bv_eq(ARRAYS[array].bv_store_key, bv_key);
+}
+
+static void add_lemma(void) {
+    APPEND_GLOBAL(LEMMA) = 0;
+    clause_arr(LEMMA);
+    N_LEMMA = 0;
+}
+
+// Adds the array lemmas the current model violates; returns how many.
+static int array_lemmas(void) {
+    int n_lemmas = 0;
+    uint64_t *store_key = malloc((N_ARRAYS + 1) * sizeof(store_key[0]));
+    for (int a = 0; a < N_ARRAYS; a++)
+        if (ARRAYS[a].array_parent >= 0) store_key[a] = model_bv(ARRAYS[a].bv_store_key);
+
+    struct root_read *reads = NULL;
+    int n_reads = 0;
+    for (int a = 0; a < N_ARRAYS; a++) {
+        for (int j = 0; j < ARRAYS[a].n_bv_lookups; j++) {
+            struct bv_lookup lookup = ARRAYS[a].bv_lookups[j];
+            uint64_t key = model_bv(lookup.bv_key);
+            int at = a;
+            while (ARRAYS[at].array_parent >= 0 && store_key[at] != key)
+                at = ARRAYS[at].array_parent;
+            if (ARRAYS[at].array_parent < 0) {
+                reads = realloc(reads, (n_reads + 1) * sizeof(reads[0]));
+                reads[n_reads++] = (struct root_read){ at, key, a, j };
+                continue;
+            }
+            if (model_bv(ARRAYS[at].bv_store_value) == model_bv(lookup.bv_value))
+                continue;
+            APPEND_GLOBAL(LEMMA) = -bv_eq(ARRAYS[at].bv_store_key, lookup.bv_key);
+            lemma_passed(a, at, lookup.bv_key);
+            APPEND_GLOBAL(LEMMA) = bv_eq(ARRAYS[at].bv_store_value, lookup.bv_value);
+            add_lemma();
+            n_lemmas++;
+        }
+    }
+
+    // equal keys at the same root: every value must match the group's first
+    if (n_reads) qsort(reads, n_reads, sizeof(reads[0]), cmp_root_read);
+    for (int i = 0, first = 0; i < n_reads; i++) {
+        if (cmp_root_read(&reads[first], &reads[i])) first = i;
+        struct bv_lookup x = ARRAYS[reads[first].array].bv_lookups[reads[first].lookup];
+        struct bv_lookup y = ARRAYS[reads[i].array].bv_lookups[reads[i].lookup];
+        if (model_bv(x.bv_value) == model_bv(y.bv_value)) continue;
+        APPEND_GLOBAL(LEMMA) = -bv_eq(x.bv_key, y.bv_key);
+        lemma_passed(reads[first].array, reads[i].root, x.bv_key);
+        lemma_passed(reads[i].array, reads[i].root, y.bv_key);
+        APPEND_GLOBAL(LEMMA) = bv_eq(x.bv_value, y.bv_value);
+        add_lemma();
+        n_lemmas++;
+    }
+    free(reads);
+    free(store_key);
+    return n_lemmas;
+}
+
+int solve() {
+    assert(!SAT_SOLUTION);
+    assert(!N_CNF);
+
+    // The CDCL solver from the SAT lab, linked in (see cdcl.h): no files,
+    // no extra process per query. It is kept across the array rounds, so
+    // each round only adds the new lemmas and keeps what it learnt.
+    aig_init();
+    cdcl_t *sat = cdcl_new();
+    int result, from = 0;
+    while (1) {
+        int cnf_from = N_CNF;
+        encode_clauses(from);
+        from = N_CLAUSES;
+        for (int i = cnf_from, start = cnf_from; i < N_CNF; i++) {
+            if (CNF[i]) continue;
+            cdcl_add_clause(sat, CNF + start, i - start);
+            start = i + 1;
         }
-        fclose(results);
-        return 1;
+        result = cdcl_solve(sat, NULL, 0);
+        if (!result) break;
+        read_model(sat);
+        if (!array_lemmas()) break;
     }
-    exit(1);
+    if (!result) {
+        free(SAT_SOLUTION);
+        SAT_SOLUTION = NULL;
+    }
+    cdcl_delete(sat);
+
+    const char *dump_dir = getenv("SMT_DUMP_DIMACS");
+    if (dump_dir) dump_dimacs(dump_dir);
+    return result;
 }
 
 int64_t get_solution(int bv, int as_signed) {
     assert(SAT_SOLUTION);
 
-    // Read the bits for @bv from SAT_SOLUTION into an int64_t.
-    assert(!"Implement me!");
+    int64_t value = model_bv(bv);
+    int width = BVS[bv].n_bits;
+    if (as_signed && width < 64 && ((value >> (width - 1)) & 1))
+        value -= (int64_t) 1 << width;
+    return value;
+}
+
+void smt_reset(void) {
+    for (int i = 0; i < N_CLAUSES; i++) free(CLAUSES[i].literals);
+    for (int i = 0; i < N_ARRAYS; i++) free(ARRAYS[i].bv_lookups);
+    for (int i = 0; i < N_BVS; i++) free(BVS[i].bits);
+    free(CLAUSES);
+    free(ARRAYS);
+    free(BVS);
+    free(AIG);
+    free(AIG_TABLE);
+    free(CNF);
+    free(SAT_VAR);
+    free(SAT_SOLUTION);
+    CLAUSES = NULL;
+    ARRAYS = NULL;
+    BVS = NULL;
+    AIG = NULL;
+    AIG_TABLE = NULL;
+    CNF = NULL;
+    SAT_VAR = NULL;
+    SAT_SOLUTION = NULL;
+    N_CLAUSES = N_ARRAYS = N_BVS = N_AIG = N_CNF = 0;
+    N_SAT_VARS = N_SAT_VAR_MAP = 0;
+    AIG_TABLE_SIZE = AIG_TABLE_USED = 0;
 }
@@ -23,22 +23,53 @@ int new_bv(int width);
 // Create a *constant* bitvector of the given width with the given value and
 // return a handle to it
 int const_bv(int64_t value, int width);
-// Create a new literal/variable that is true iff the bitvectors represented by
-// handles bv_1 and bv_2 are equal.
+// Return a literal that is true iff the bitvectors represented by handles
+// bv_1 and bv_2 are equal. Equal sub-terms share their literals, so this may
+// be a literal returned before, or constant true/false (1/-1).
 int bv_eq(int bv_1, int bv_2);
-// Return a handle to a fresh bitvector with value equal to the sum of that of
+// Return a handle to a bitvector with value equal to the sum of that of
 // bv_1, bv_2.
 int bv_add(int bv_1, int bv_2);
+// Likewise for the difference, the product, and unsigned quotient and
+// remainder, all modulo 2^width. Dividing by zero gives all ones and bv_1
+// back, as in SMT-LIB.
+int bv_sub(int bv_1, int bv_2);
+int bv_mul(int bv_1, int bv_2);
+int bv_udiv(int bv_1, int bv_2);
+int bv_urem(int bv_1, int bv_2);
+// Bitwise operations
+int bv_and(int bv_1, int bv_2);
+int bv_or(int bv_1, int bv_2);
+int bv_xor(int bv_1, int bv_2);
+int bv_not(int bv);
+// Shift bv left, logically right or arithmetically right by bv_amount (an
+// unsigned bitvector of the same width); shifting by the width or more
+// leaves nothing but the fill.
+int bv_shl(int bv, int bv_amount);
+int bv_lshr(int bv, int bv_amount);
+int bv_ashr(int bv, int bv_amount);
+// Return a literal that is true iff bv_1 < bv_2, as unsigned or as two's
+// complement numbers. Negate it, or swap the operands, for the other
+// comparisons.
+int bv_ult(int bv_1, int bv_2);
+int bv_slt(int bv_1, int bv_2);
 
 // Add a clause/assertion to the underlying SAT instance. E.g., to assert that
 // bv1 and bv2 are handles to distinct bitvectors, use clause(-bv_eq(bv1, bv2))
+// Literals are those of the and-inverter graph in smt.c; it only becomes CNF,
+// and only the part the clauses reach, in solve().
 void clause_arr(int *literals);
 #define clause(...) clause_arr((int[]){__VA_ARGS__, 0})
 
 // Try to find a solution to the current set of constraints. Should only be
-// called once (per process). Returns 0 for unsat, 1 for sat. In the latter
-// case, the satisfying model can be queried with get_solution.
+// called once per query (see smt_reset). Returns 0 for unsat, 1 for sat. In
+// the latter case, the satisfying model can be queried with get_solution.
 int solve();
 // Query the model that satisfies the current constraints. Can only be called
 // once solve() is called and returns 1.
 int64_t get_solution(int bv, int as_signed);
+
+// Throw away every handle, clause and model of this thread and start a new
+// query. The state is per thread, so threads can build and solve queries
+// side by side, but handles never cross threads.
+void smt_reset(void);
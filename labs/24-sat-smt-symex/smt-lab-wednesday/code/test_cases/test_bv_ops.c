@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <assert.h>
+#include "smt.h"
+
+// Tests the other arithmetic, the bitwise operations, shifts and
+// comparisons. Uses the SMT solver to factor, i.e., solve for x and y
+// such that x * y = 143 with neither of them 1, and checks the rest on it.
+int main() {
+    printf("Testing bitvector operations...\n");
+
+    int bv_x = new_bv(8),
+        bv_y = new_bv(8);
+    int bv_const_1 = const_bv(1, 8),
+        bv_const_3 = const_bv(3, 8),
+        bv_const_143 = const_bv(143, 8);
+
+    // assert x * y == 143, 1 < x < y
+    clause(bv_eq(bv_mul(bv_x, bv_y), bv_const_143));
+    clause(bv_ult(bv_const_1, bv_x));
+    clause(bv_ult(bv_x, bv_y));
+    // ... and that y < 16, so it doesn't wrap around
+    clause(bv_ult(bv_y, const_bv(16, 8)));
+
+    int bv_quot = bv_udiv(bv_const_143, bv_x),
+        bv_rem = bv_urem(bv_const_143, bv_const_3),
+        bv_diff = bv_sub(bv_x, bv_y),
+        bv_and_xy = bv_and(bv_x, bv_y),
+        bv_or_xy = bv_or(bv_x, bv_y),
+        bv_xor_xy = bv_xor(bv_x, bv_y),
+        bv_not_x = bv_not(bv_x),
+        bv_shl_x = bv_shl(bv_x, bv_const_3),
+        bv_lshr_y = bv_lshr(bv_y, const_bv(2, 8)),
+        bv_ashr_diff = bv_ashr(bv_diff, const_bv(1, 8));
+    // x - y = -2 is less than x signed, but not unsigned (254)
+    clause(bv_slt(bv_diff, bv_x));
+    clause(-bv_ult(bv_diff, bv_x));
+
+    // Should be sat...
+    assert(solve());
+
+    // And x = 11, y = 13 is the only answer
+    assert(get_solution(bv_x, 0)            == 11);
+    assert(get_solution(bv_y, 0)            == 13);
+    assert(get_solution(bv_quot, 0)         == 13);
+    assert(get_solution(bv_rem, 0)          == 2);
+    assert(get_solution(bv_diff, 1)         == -2);
+    assert(get_solution(bv_and_xy, 0)       == (11 & 13));
+    assert(get_solution(bv_or_xy, 0)        == (11 | 13));
+    assert(get_solution(bv_xor_xy, 0)       == (11 ^ 13));
+    assert(get_solution(bv_not_x, 0)        == 255 - 11);
+    assert(get_solution(bv_shl_x, 0)        == 88);
+    assert(get_solution(bv_lshr_y, 0)       == 3);
+    assert(get_solution(bv_ashr_diff, 1)    == -1);
+
+    // A symbolic shift amount: 1 << s == 32 for s = 5 and nothing else
+    smt_reset();
+    int bv_s = new_bv(8);
+    clause(bv_eq(bv_shl(const_bv(1, 8), bv_s), const_bv(32, 8)));
+    assert(solve());
+    assert(get_solution(bv_s, 0) == 5);
+    smt_reset();
+    bv_s = new_bv(8);
+    clause(bv_eq(bv_shl(const_bv(1, 8), bv_s), const_bv(32, 8)));
+    clause(-bv_eq(bv_s, const_bv(5, 8)));
+    assert(!solve());
+
+    // Shifting x = 0x96 (negative) by 8 or more leaves only the fill: no
+    // such s gives anything else
+    smt_reset();
+    bv_s = new_bv(8);
+    bv_x = new_bv(8);
+    clause(bv_ult(const_bv(7, 8), bv_s));
+    clause(bv_eq(bv_x, const_bv(0x96, 8)));
+    clause(-bv_eq(bv_shl(bv_x, bv_s), const_bv(0, 8)),
+           -bv_eq(bv_lshr(bv_x, bv_s), const_bv(0, 8)),
+           -bv_eq(bv_ashr(bv_x, bv_s), const_bv(0xff, 8)));
+    assert(!solve());
+
+    // Dividing by zero gives all ones, and the dividend as the remainder,
+    // for every x
+    smt_reset();
+    bv_x = new_bv(8);
+    int bv_d = new_bv(8);
+    clause(bv_eq(bv_d, const_bv(0, 8)));
+    clause(-bv_eq(bv_udiv(bv_x, bv_d), const_bv(0xff, 8)),
+           -bv_eq(bv_urem(bv_x, bv_d), bv_x));
+    assert(!solve());
+    // ... and is the only way to get x / d == 0xff with x < 0xff
+    smt_reset();
+    bv_x = new_bv(8);
+    bv_d = new_bv(8);
+    clause(bv_ult(bv_x, const_bv(0xff, 8)));
+    clause(bv_eq(bv_udiv(bv_x, bv_d), const_bv(0xff, 8)));
+    assert(solve());
+    assert(get_solution(bv_d, 0) == 0);
+
+    printf("Passed!\n");
+    return 0;
+}
@@ -0,0 +1,527 @@
+// Basic-block JIT from RV32I to x86-64: machine_jit.
+//
+// Execution starts out in the interpreter (machine_exec), counting how many
+// times each pc is run. A pc that gets hot starts a block: the instructions
+// from it up to and including the next branch or jump, which are translated
+// to x86-64 in an mmap'd executable buffer. Anything the translator doesn't
+// handle (ecall, ebreak, illegal instructions) ends a block before it and is
+// left to the interpreter.
+//
+// In translated code the guest registers stay in machine_t (rbx points at
+// them), guest memory is at r12, the jit_ctx_t at r13 and the code-word flags
+// at r14. A block leaves through an exit stub that returns the next guest pc
+// to machine_jit. Once the block at that pc is translated too, the stub is
+// patched to jump straight to it, so hot loops run block to block without
+// coming back out. jalr always comes back out, to look its target up.
+//
+// A store to a word that translated code was made from (self-modifying code,
+// in generated code or through the interpreter) throws all translations away
+// and continues after the store in the interpreter.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "rvsim.h"
+#include "bits.h"
+
+#if defined(__x86_64__)
+
+#define JIT_HOT 32              // runs of a pc before it is translated
+#define JIT_MAX_BLOCK 128       // instructions per block
+#define JIT_CODE_SIZE (64 << 20)
+#define JIT_MAX_BLOCK_CODE (JIT_MAX_BLOCK * 96)
+
+#define SLOT_PAGE_BITS 12
+#define SLOT_PAGE_INSNS ((1 << SLOT_PAGE_BITS) / 4)
+
+// shared with translated code, at r13
+typedef struct {
+    uint64_t count;     // instructions executed by translated code
+    uint8_t flush;      // translated code stored to a code word
+} jit_ctx_t;
+
+// what a block returns: the next guest pc, and the exit stub to patch to
+// jump to that pc's block (NULL for jalr)
+typedef struct {
+    uint64_t pc;
+    uint8_t* stub;
+} jit_exit_t;
+
+typedef jit_exit_t (*jit_enter_t)(int32_t* regs, uint8_t* mem, jit_ctx_t* ctx,
+                                  uint8_t* code_words, uint8_t* code);
+
+typedef struct {
+    uint8_t* code;      // NULL if not translated
+    int32_t count;      // runs so far; negative if it can't be translated
+} jit_slot_t;
+
+struct jit {
+    uint8_t* buf;
+    uint8_t* end;       // of what has been emitted
+    jit_enter_t enter;
+    uint8_t* epilogue;
+
+    // by guest pc, per page of memory
+    jit_slot_t** slots;
+    // per guest word: 1 if some translated code was made from it
+    uint8_t* code_words;
+    bool flush;         // set by jit_invalidate
+
+    jit_ctx_t ctx;
+};
+
+/**** EMITTING ****/
+
+static uint8_t* P;  // where the next byte goes
+
+static void emit(int n, ...) {
+    __builtin_va_list args;
+    __builtin_va_start(args, n);
+    for (int i = 0; i < n; i++) {
+        *P++ = __builtin_va_arg(args, int);
+    }
+    __builtin_va_end(args);
+}
+
+static void emit32(uint32_t x) {
+    memcpy(P, &x, 4);
+    P += 4;
+}
+
+// rel32 from the end of a 4-byte field at 'at' to 'to'
+static void patch_rel32(uint8_t* at, uint8_t* to) {
+    int32_t rel = to - (at + 4);
+    memcpy(at, &rel, 4);
+}
+
+enum { EAX = 0, ECX = 1 };
+
+// mov reg, guest register 'r' (x0 reads as 0)
+static void emit_get(int reg, int r) {
+    if (r == 0) {
+        emit(2, 0x31, 0xc0 | (reg << 3) | reg);     // xor reg, reg
+    } else {
+        emit(3, 0x8b, 0x43 | (reg << 3), 4 * r);    // mov reg, [rbx + 4r]
+    }
+}
+
+// mov guest register 'r', eax
+static void emit_set(int r) {
+    emit(3, 0x89, 0x43, 4 * r);
+}
+
+// add/sub qword [r13] (ctx->count), n
+static void emit_count(int32_t n) {
+    if (n > 0) {
+        emit(4, 0x49, 0x81, 0x45, 0x00);
+    } else {
+        emit(4, 0x49, 0x81, 0x6d, 0x00);
+        n = -n;
+    }
+    emit32(n);
+}
+
+static void emit_jmp(uint8_t* to) {
+    emit(1, 0xe9);
+    patch_rel32(P, to);
+    P += 4;
+}
+
+// An exit to guest 'pc' that can later be patched into a jmp to its block:
+//   mov eax, pc; lea rdx, [this stub]; jmp epilogue
+#define STUB_SIZE 17
+
+static void emit_stub(jit_t* jit, uint32_t pc) {
+    emit(1, 0xb8);
+    emit32(pc);
+    emit(3, 0x48, 0x8d, 0x15);
+    emit32(-12);
+    emit_jmp(jit->epilogue);
+}
+
+// An exit to guest 'pc' that is never patched, having run all but 'undo'
+// of the block's instructions (sets ctx->flush too if 'flush').
+static int emit_exit(jit_t* jit, uint32_t pc, int undo, bool flush) {
+    uint8_t* start = P;
+    if (flush) {
+        emit(5, 0x41, 0xc6, 0x45, offsetof(jit_ctx_t, flush), 1);
+    }
+    if (undo) {
+        emit_count(-undo);
+    }
+    emit(1, 0xb8);
+    emit32(pc);
+    emit(2, 0x31, 0xd2);    // xor edx, edx
+    emit_jmp(jit->epilogue);
+    return P - start;
+}
+
+// eax = guest address rs1 + imm as an offset into memory, rounded down to
+// 'size' like mem.c; exits to the interpreter (which faults) if it is out of
+// range. 'undo' is for emit_exit.
+static void emit_address(jit_t* jit, machine_t* m, uint32_t insn, int32_t imm,
+                         uint32_t size, uint32_t pc, int undo) {
+    emit_get(EAX, RS1(insn));
+    emit(1, 0x05);
+    emit32(imm - m->mem.base);                      // add eax, imm - base
+    emit(1, 0x25);
+    emit32(~(size - 1));                            // and eax, ~(size - 1)
+    emit(1, 0x3d);
+    emit32(m->mem.size);                            // cmp eax, size
+    emit(2, 0x72, 0);                               // jb ok
+    uint8_t* jb = P;
+    int n = emit_exit(jit, pc, undo, false);
+    jb[-1] = n;
+}
+
+/**** TRANSLATING ****/
+
+static jit_slot_t* jit_slot(machine_t* m, uint32_t pc) {
+    uint32_t off = pc - m->mem.base;
+    if (off >= m->mem.size || off % 4) {
+        return NULL;
+    }
+    jit_slot_t** page = &m->jit->slots[off >> SLOT_PAGE_BITS];
+    if (!*page) {
+        *page = calloc(SLOT_PAGE_INSNS, sizeof(jit_slot_t));
+        assert(*page);
+    }
+    return &(*page)[(off % (1 << SLOT_PAGE_BITS)) / 4];
+}
+
+// Whether 'insn' can go in a block, and whether it ends one.
+static bool translatable(uint32_t insn, bool* ends) {
+    *ends = false;
+    if (insn == INSN_ECALL || insn == INSN_EBREAK) {
+        return false;
+    }
+    switch (bits_get(insn, 6, 0)) {
+        case OP_RARITH: {
+            alu_op_t op = (FUNCT7(insn) << 3) | FUNCT3(insn);
+            return op == ALU_ADD || op == ALU_SUB || op == ALU_SLL || op == ALU_SLT ||
+                   op == ALU_SLTU || op == ALU_XOR || op == ALU_SRL || op == ALU_SRA ||
+                   op == ALU_OR || op == ALU_AND;
+        }
+        case OP_IARITH: {
+            alu_op_t op = iarith_op(insn);
+            return op != ALU_SUB && (op <= ALU_AND || op == ALU_SRA);
+        }
+        case OP_LUI:
+        case OP_AUIPC:
+        case OP_FENCE:
+            return true;
+        case OP_BRANCH:
+            *ends = true;
+            return FUNCT3(insn) != 0b010 && FUNCT3(insn) != 0b011;
+        case OP_JAL:
+        case OP_JALR:
+            *ends = true;
+            return true;
+        case OP_LOAD:
+            return FUNCT3(insn) <= EXT_HALFU && FUNCT3(insn) != 0b011;
+        case OP_STORE:
+            return FUNCT3(insn) <= EXT_WORD;
+    }
+    return false;
+}
+
+// Translates the instruction 'insn' at 'pc', the 'i'th of a block of 'len'.
+static void translate(jit_t* jit, machine_t* m, uint32_t insn, uint32_t pc, int i, int len) {
+    uint32_t rd = RD(insn);
+    switch (bits_get(insn, 6, 0)) {
+        case OP_RARITH: {
+            // add, sub, xor, or, and eax, ecx; shl, shr, sar eax, cl (x86
+            // masks the amount to 5 bits too); cmp eax, ecx + setl/setb
+            static const uint8_t ops[] = {
+                [ALU_ADD] = 0x01, [ALU_SUB] = 0x29, [ALU_XOR] = 0x31,
+                [ALU_OR] = 0x09, [ALU_AND] = 0x21,
+            };
+            alu_op_t op = (FUNCT7(insn) << 3) | FUNCT3(insn);
+            if (rd == 0) {
+                break;
+            }
+            emit_get(EAX, RS1(insn));
+            emit_get(ECX, RS2(insn));
+            switch (op) {
+                case ALU_SLL: emit(2, 0xd3, 0xe0); break;
+                case ALU_SRL: emit(2, 0xd3, 0xe8); break;
+                case ALU_SRA: emit(2, 0xd3, 0xf8); break;
+                case ALU_SLT: emit(8, 0x39, 0xc8, 0x0f, 0x9c, 0xc0, 0x0f, 0xb6, 0xc0); break;
+                case ALU_SLTU: emit(8, 0x39, 0xc8, 0x0f, 0x92, 0xc0, 0x0f, 0xb6, 0xc0); break;
+                default: emit(2, ops[op], 0xc8); break;
+            }
+            emit_set(rd);
+            break;
+        }
+        case OP_IARITH: {
+            // op eax, imm32, or shift eax, imm8
+            static const uint8_t ops[] = {
+                [ALU_ADD] = 0x05, [ALU_XOR] = 0x35, [ALU_OR] = 0x0d, [ALU_AND] = 0x25,
+            };
+            alu_op_t op = iarith_op(insn);
+            int32_t imm = extract_imm(insn, IMM_I);
+            if (rd == 0) {
+                break;
+            }
+            emit_get(EAX, RS1(insn));
+            switch (op) {
+                case ALU_SLL: emit(3, 0xc1, 0xe0, SHAMT(insn)); break;
+                case ALU_SRL: emit(3, 0xc1, 0xe8, SHAMT(insn)); break;
+                case ALU_SRA: emit(3, 0xc1, 0xf8, SHAMT(insn)); break;
+                case ALU_SLT:
+                case ALU_SLTU:
+                    emit(1, 0x3d);
+                    emit32(imm);
+                    emit(6, 0x0f, op == ALU_SLT ? 0x9c : 0x92, 0xc0, 0x0f, 0xb6, 0xc0);
+                    break;
+                default:
+                    emit(1, ops[op]);
+                    emit32(imm);
+                    break;
+            }
+            emit_set(rd);
+            break;
+        }
+        case OP_LUI:
+        case OP_AUIPC:
+            if (rd != 0) {
+                uint32_t imm = extract_imm(insn, IMM_U);
+                emit(3, 0xc7, 0x43, 4 * rd);    // mov dword [rbx + 4rd], imm32
+                emit32(bits_get(insn, 6, 0) == OP_AUIPC ? pc + imm : imm);
+            }
+            break;
+        case OP_FENCE:
+            break;
+        case OP_LOAD: {
+            // movsx/movzx eax, byte/word [r12 + rax]; mov eax, [r12 + rax]
+            static const uint8_t ops[][3] = {
+                [EXT_BYTE] = { 0x0f, 0xbe }, [EXT_HALF] = { 0x0f, 0xbf }, [EXT_WORD] = { 0x8b },
+                [EXT_BYTEU] = { 0x0f, 0xb6 }, [EXT_HALFU] = { 0x0f, 0xb7 },
+            };
+            uint32_t funct3 = FUNCT3(insn);
+            if (rd == 0) {
+                break;
+            }
+            emit_address(jit, m, insn, extract_imm(insn, IMM_I), 1 << (funct3 & 3), pc, len - i);
+            emit(1, 0x41);
+            if (ops[funct3][0] == 0x0f) {
+                emit(2, 0x0f, ops[funct3][1]);
+            } else {
+                emit(1, ops[funct3][0]);
+            }
+            emit(2, 0x04, 0x04);
+            emit_set(rd);
+            break;
+        }
+        case OP_STORE: {
+            uint32_t size = 1 << FUNCT3(insn);
+            emit_address(jit, m, insn, extract_imm(insn, IMM_S), size, pc, len - i);
+            emit_get(ECX, RS2(insn));
+            switch (size) {
+                case 1: emit(4, 0x41, 0x88, 0x0c, 0x04); break;        // mov [r12 + rax], cl
+                case 2: emit(5, 0x66, 0x41, 0x89, 0x0c, 0x04); break;  // ... cx
+                case 4: emit(4, 0x41, 0x89, 0x0c, 0x04); break;        // ... ecx
+            }
+            // shr eax, 2; cmp byte [r14 + rax], 0; je ok
+            emit(3, 0xc1, 0xe8, 2);
+            emit(5, 0x41, 0x80, 0x3c, 0x06, 0x00);
+            emit(2, 0x74, 0);
+            uint8_t* je = P;
+            int n = emit_exit(jit, pc + 4, len - i - 1, true);
+            je[-1] = n;
+            break;
+        }
+        case OP_BRANCH: {
+            // cmp eax, ecx; jcc taken; fall-through stub; taken: stub
+            static const uint8_t jcc[] = { 0x84, 0x85, 0, 0, 0x8c, 0x8d, 0x82, 0x83 };
+            emit_get(EAX, RS1(insn));
+            emit_get(ECX, RS2(insn));
+            emit(2, 0x39, 0xc8);
+            emit(2, 0x0f, jcc[FUNCT3(insn)]);
+            emit32(STUB_SIZE);
+            emit_stub(jit, pc + 4);
+            emit_stub(jit, pc + extract_imm(insn, IMM_B));
+            break;
+        }
+        case OP_JAL:
+            if (rd != 0) {
+                emit(3, 0xc7, 0x43, 4 * rd);
+                emit32(pc + 4);
+            }
+            emit_stub(jit, pc + extract_imm(insn, IMM_J));
+            break;
+        case OP_JALR:
+            // read rs1 before writing rd, in case they are the same
+            emit_get(EAX, RS1(insn));
+            emit(1, 0x05);
+            emit32(extract_imm(insn, IMM_I));
+            emit(3, 0x83, 0xe0, 0xfe);          // and eax, ~1
+            if (rd != 0) {
+                emit(3, 0xc7, 0x43, 4 * rd);
+                emit32(pc + 4);
+            }
+            emit(2, 0x31, 0xd2);
+            emit_jmp(jit->epilogue);
+            break;
+    }
+}
+
+static void jit_flush(machine_t* m);
+
+// Translates the block at 'pc' into 'slot'. Returns false if its first
+// instruction can't be translated.
+static bool compile(machine_t* m, jit_slot_t* slot, uint32_t pc) {
+    jit_t* jit = m->jit;
+    uint32_t insns[JIT_MAX_BLOCK];
+    int len = 0;
+    bool ends = false;
+    while (len < JIT_MAX_BLOCK && !ends && pc + 4 * len - m->mem.base < m->mem.size) {
+        uint32_t insn = mem_read32(&m->mem, pc + 4 * len);
+        if (!translatable(insn, &ends)) {
+            break;
+        }
+        insns[len++] = insn;
+    }
+    if (len == 0) {
+        slot->count = -1;
+        return false;
+    }
+
+    if (jit->end + JIT_MAX_BLOCK_CODE > jit->buf + JIT_CODE_SIZE) {
+        jit_flush(m);
+    }
+    P = jit->end;
+    slot->code = P;
+    emit_count(len);
+    for (int i = 0; i < len; i++) {
+        translate(jit, m, insns[i], pc + 4 * i, i, len);
+        jit->code_words[(pc + 4 * i - m->mem.base) / 4] = 1;
+    }
+    if (!ends) {
+        emit_stub(jit, pc + 4 * len);
+    }
+    assert(P <= jit->end + JIT_MAX_BLOCK_CODE);
+    jit->end = P;
+    return true;
+}
+
+// Throws every translation away.
+static void jit_flush(machine_t* m) {
+    jit_t* jit = m->jit;
+    for (uint32_t i = 0; i <= m->mem.size >> SLOT_PAGE_BITS; i++) {
+        if (jit->slots[i]) {
+            for (int j = 0; j < SLOT_PAGE_INSNS; j++) {
+                jit->slots[i][j].code = NULL;
+            }
+        }
+    }
+    memset(jit->code_words, 0, m->mem.size / 4);
+    jit->end = jit->epilogue + 16;
+    jit->flush = false;
+    jit->ctx.flush = 0;
+}
+
+void jit_invalidate(machine_t* m, uint32_t addr, uint32_t size) {
+    uint32_t first = (addr - m->mem.base) / 4, last = (addr - m->mem.base + size - 1) / 4;
+    for (uint32_t w = first; w <= last && w < m->mem.size / 4; w++) {
+        if (m->jit->code_words[w]) {
+            m->jit->flush = true;
+        }
+    }
+}
+
+// The entry and exit code at the start of the buffer:
+//   push rbx, r12-r15; mov rbx, rdi; mov r12, rsi; mov r13, rdx; mov r14, rcx;
+//   jmp r8
+// epilogue:
+//   pop r15-r12, rbx; ret
+static void emit_trampoline(jit_t* jit) {
+    P = jit->buf;
+    jit->enter = (jit_enter_t) P;
+    emit(9, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);
+    emit(12, 0x48, 0x89, 0xfb, 0x49, 0x89, 0xf4, 0x49, 0x89, 0xd5, 0x49, 0x89, 0xce);
+    emit(3, 0x41, 0xff, 0xe0);
+    jit->epilogue = P;
+    emit(10, 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0xc3);
+    jit->end = jit->epilogue + 16;
+}
+
+uint64_t machine_jit(machine_t* m) {
+    jit_t* jit = calloc(1, sizeof(*jit));
+    assert(jit);
+    jit->buf = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->buf == MAP_FAILED) {
+        free(jit);
+        return machine_run(m);
+    }
+    jit->slots = calloc((m->mem.size >> SLOT_PAGE_BITS) + 1, sizeof(jit->slots[0]));
+    jit->code_words = calloc(m->mem.size / 4 + 1, 1);
+    assert(jit->slots && jit->code_words);
+    emit_trampoline(jit);
+    m->jit = jit;
+
+    uint64_t n = 0;
+    while (true) {
+        if (jit->flush) {
+            jit_flush(m);
+        }
+        jit_slot_t* slot = jit_slot(m, m->pc);
+        if (slot && !slot->code && slot->count >= 0 && ++slot->count >= JIT_HOT) {
+            compile(m, slot, m->pc);
+        }
+        if (!slot || !slot->code) {
+            // cold, or not translatable: the interpreter (which also faults
+            // on a bad pc)
+            n++;
+            if (machine_exec(m)) {
+                break;
+            }
+            continue;
+        }
+
+        jit_exit_t exit = jit->enter(m->regs, m->mem.data, &jit->ctx, jit->code_words, slot->code);
+        m->pc = exit.pc;
+        if (jit->ctx.flush) {
+            jit->flush = true;
+            continue;
+        }
+        // chain: patch the stub into a jmp to the next block, if it has one
+        jit_slot_t* next = exit.stub ? jit_slot(m, exit.pc) : NULL;
+        if (next && next->code) {
+            P = exit.stub;
+            emit_jmp(next->code);
+        }
+    }
+
+    n += jit->ctx.count;
+    m->jit = NULL;
+    for (uint32_t i = 0; i <= m->mem.size >> SLOT_PAGE_BITS; i++) {
+        free(jit->slots[i]);
+    }
+    free(jit->slots);
+    free(jit->code_words);
+    munmap(jit->buf, JIT_CODE_SIZE);
+    free(jit);
+    return n;
+}
+
+#else
+
+// not an x86-64 host: run the threaded interpreter instead
+uint64_t machine_jit(machine_t* m) {
+    return machine_run(m);
+}
+
+void jit_invalidate(machine_t* m, uint32_t addr, uint32_t size) {
+    (void) m;
+    (void) addr;
+    (void) size;
+}
+
+#endif
@@ -1,21 +1,46 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
 #include "rvsim.h"
 
+static void usage() {
+    printf("usage: rvsim [-interp | -jit] [-stats] ELF\n");
+    printf("  -interp  decode every instruction every time (machine_exec)\n");
+    printf("  -jit     translate hot code to x86-64 (machine_jit)\n");
+    printf("  -stats   print the run time and MIPS to stderr\n");
+    exit(1);
+}
+
 int main(int argc, char** argv) {
-    if (argc <= 1) {
-        printf("usage: rvsim ELF\n");
-        return 1;
+    char* file = NULL;
+    bool interp = false, jit = false, stats = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-interp")) {
+            interp = true;
+        } else if (!strcmp(argv[i], "-jit")) {
+            jit = true;
+        } else if (!strcmp(argv[i], "-stats")) {
+            stats = true;
+        } else if (argv[i][0] == '-' || file) {
+            usage();
+        } else {
+            file = argv[i];
+        }
     }
-    int fd = open(argv[1], O_RDONLY);
+    if (!file) {
+        usage();
+    }
+    int fd = open(file, O_RDONLY);
     if (fd < 0) {
-        printf("rvsim: file %s not found\n", argv[1]);
+        printf("rvsim: file %s not found\n", file);
         return 1;
     }
 
@@ -29,16 +54,28 @@ int main(int argc, char** argv) {
     machine_new(&m, 0, 0x1000000);
     machine_load(&m, fdata);
 
-    bool halt = false;
-
-    int count = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    while (!halt) {
-        halt = machine_exec(&m);
-        count++;
+    uint64_t count = 0;
+    if (interp) {
+        bool halt = false;
+        while (!halt) {
+            halt = machine_exec(&m);
+            count++;
+        }
+    } else if (jit) {
+        count = machine_jit(&m);
+    } else {
+        count = machine_run(&m);
     }
 
-    printf("executed instructions: %d\n", count);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("executed instructions: %" PRIu64 "\n", count);
+    if (stats) {
+        double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "%.3f s, %.1f MIPS\n", secs, count / secs / 1e6);
+    }
 
 #if DUMPREG
     printf("registers:\n");
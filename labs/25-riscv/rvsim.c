@@ -25,68 +25,110 @@ static bool do_branch(machine_t* m, int32_t pc, bool cond) {
 }
 
 // Returns the result of applying 'op' to 'a' and 'b'.
-static int32_t alu_compute(int32_t a, int32_t b, alu_op_t op) {
-    assert(!"unimplemented");
+int32_t alu_compute(int32_t a, int32_t b, alu_op_t op) {
+    switch (op) {
+        case ALU_ADD:
+            return (uint32_t) a + (uint32_t) b;
+        case ALU_SUB:
+            return (uint32_t) a - (uint32_t) b;
+        case ALU_SLT:
+            return a < b;
+        case ALU_SLTU:
+            return (uint32_t) a < (uint32_t) b;
+        case ALU_XOR:
+            return a ^ b;
+        case ALU_SLL:
+            return (uint32_t) a << (b & 31);
+        case ALU_SRL:
+            return (uint32_t) a >> (b & 31);
+        case ALU_SRA:
+            return a >> (b & 31);
+        case ALU_OR:
+            return a | b;
+        case ALU_AND:
+            return a & b;
+    }
+    printf("unknown alu op: %x\n", op);
+    assert(false);
+    return 0;
 }
 
 // Extracts the immediate from 'insn', assuming the immediate is encoded in the
 // instruction with the corresponding type.
-static uint32_t extract_imm(uint32_t insn, imm_type_t type) {
-    // Implement the immediate decoder for each type of immediate encoding.
-    assert(!"unimplemented");
+uint32_t extract_imm(uint32_t insn, imm_type_t type) {
+    switch (type) {
+        case IMM_I:
+            return sext(bits_get(insn, 31, 20), 12);
+        case IMM_S:
+            return sext(bits_remap(insn, 31, 25, 11, 5) | bits_remap(insn, 11, 7, 4, 0), 12);
+        case IMM_B:
+            return sext(bit_remap(insn, 31, 12) | bit_remap(insn, 7, 11) |
+                        bits_remap(insn, 30, 25, 10, 5) | bits_remap(insn, 11, 8, 4, 1), 13);
+        case IMM_J:
+            return sext(bit_remap(insn, 31, 20) | bits_remap(insn, 19, 12, 19, 12) |
+                        bit_remap(insn, 20, 11) | bits_remap(insn, 30, 21, 10, 1), 21);
+        case IMM_U:
+            return bits_get(insn, 31, 12) << 12;
+    }
+    assert(false);
+    return 0;
+}
+
+// The ALU operation of an I-type instruction: funct3, plus funct7 for the
+// right shifts (srai is the only one whose immediate has the funct7 bit).
+alu_op_t iarith_op(uint32_t insn) {
+    uint32_t funct3 = FUNCT3(insn);
+    if (funct3 == 0b101) {
+        return (FUNCT7(insn) << 3) | funct3;
+    }
+    return funct3;
 }
 
-#define RD(x) bits_get(x, 11, 7)
-#define RS1(x) bits_get(x, 19, 15)
-#define RS2(x) bits_get(x, 24, 20)
-#define SHAMT(x) bits_get(x, 24, 20)
-#define FUNCT3(x) bits_get(x, 14, 12)
-#define FUNCT7(x) bits_get(x, 31, 25)
+// The ALU operation and whether the branch jumps when its result is zero,
+// for a branch's funct3.
+alu_op_t branch_op(uint32_t insn, bool* jump_if_zero) {
+    uint32_t funct3 = FUNCT3(insn);
+    // beq/bne compare with xor, blt/bge with slt, bltu/bgeu with sltu. beq
+    // jumps if the xor is zero; blt and bltu jump if the slt is not zero.
+    static const alu_op_t ops[] = { ALU_XOR, ALU_XOR, 0, 0, ALU_SLT, ALU_SLT, ALU_SLTU, ALU_SLTU };
+    assert(funct3 != 0b010 && funct3 != 0b011);
+    *jump_if_zero = (funct3 < 0b100) ? !(funct3 & 1) : (funct3 & 1);
+    return ops[funct3];
+}
 
 // Executes an R-type arithmetic instruction.
 static void rarith(machine_t* m, uint32_t insn) {
-    // Decode the ALU operation, rs1, rs2, and rd from the instruction. Then
-    // run alu_compute and write the result back to the register file.
-    assert(!"unimplemented");
+    alu_op_t op = (FUNCT7(insn) << 3) | FUNCT3(insn);
+    write_reg(m, RD(insn), alu_compute(m->regs[RS1(insn)], m->regs[RS2(insn)], op));
 }
 
 // Executes an I-type arithmetic instruction.
 static void iarith(machine_t* m, uint32_t insn) {
-    // Decode the ALU operation, rs1, rd, and immediate. Then run alu_compute
-    // and write the result back to the register file.
-    // NOTE: for shift instructions, the immediate is encoded in the SHAMT
-    // field (this matters for SRL).
-    assert(!"unimplemented");
+    // For shift instructions, the immediate is the SHAMT field; for srai,
+    // the bits above it are funct7 (see iarith_op), not immediate.
+    int32_t imm = extract_imm(insn, IMM_I);
+    alu_op_t op = iarith_op(insn);
+    if (op == ALU_SLL || op == ALU_SRL || op == ALU_SRA) {
+        imm = SHAMT(insn);
+    }
+    write_reg(m, RD(insn), alu_compute(m->regs[RS1(insn)], imm, op));
 }
 
 // Executes a branch instruction. Returns true if a jump occurred.
 static bool branch(machine_t* m, uint32_t insn) {
-    // Decode the immediate for a branch instruction.
-
-    // Compute the condition for the jump.
-    // HINT: you can use the ALU for this. Each branch instruction performs an
-    // ALU computation, and then branches if the result is 0, or if the result
-    // is not zero (depending on the branch type). First do the ALU operation,
-    // (some branches use XOR, some use SLT, some use SLTU), and then compare
-    // the result to 0 (some branches jump if equal to 0, and some jump if not
-    // equal to 0).
-
-    // If the condition is true, jump to pc + imm (and return whether you
-    // jumped).
-
-    assert(!"unimplemented");
-
-    return false;
+    int32_t imm = extract_imm(insn, IMM_B);
+    bool jump_if_zero;
+    alu_op_t op = branch_op(insn, &jump_if_zero);
+    int32_t result = alu_compute(m->regs[RS1(insn)], m->regs[RS2(insn)], op);
+    return do_branch(m, m->pc + imm, (result == 0) == jump_if_zero);
 }
 
 static void lui(machine_t* m, uint32_t insn) {
-    // Load the U-type immediate into rd.
-    assert(!"unimplemented");
+    write_reg(m, RD(insn), extract_imm(insn, IMM_U));
 }
 
 static void auipc(machine_t* m, uint32_t insn) {
-    // Decode the U-type immediate, add it to the PC, and write it into rd.
-    assert(!"unimplemented");
+    write_reg(m, RD(insn), m->pc + extract_imm(insn, IMM_U));
 }
 
 // Example instruction: jal
@@ -101,27 +143,59 @@ static void jal(machine_t* m, uint32_t insn) {
 }
 
 static void jalr(machine_t* m, uint32_t insn) {
-    // Similar to jal but the jump target is in rs1.
-    assert(!"unimplemented");
+    // Similar to jal but the jump target is rs1 + imm, with the low bit
+    // cleared. Read rs1 before writing rd, in case they are the same.
+    int32_t imm = extract_imm(insn, IMM_I);
+    int32_t pc = ((uint32_t) m->regs[RS1(insn)] + imm) & ~1;
+    write_reg(m, RD(insn), m->pc + 4);
+    do_branch(m, pc, true);
 }
 
 static void load(machine_t* m, uint32_t insn) {
-    // First compute the load address, which is rs1 + imm.
-
-    // Next perform the read by use mem_readX(&m->mem, addr). The size of the
-    // read is determined by the immext (funct3) type (to support all load
-    // instructions: lb, lbu, lh, lhu, lw).
-
-    // Write the value returned by the read to rd.
-    assert(!"unimplemented");
+    uint32_t addr = m->regs[RS1(insn)] + extract_imm(insn, IMM_I);
+    int32_t val;
+    switch (FUNCT3(insn)) {
+        case EXT_BYTE:
+            val = mem_read8(&m->mem, addr);
+            break;
+        case EXT_HALF:
+            val = mem_read16(&m->mem, addr);
+            break;
+        case EXT_WORD:
+            val = mem_read32(&m->mem, addr);
+            break;
+        case EXT_BYTEU:
+            val = mem_read8u(&m->mem, addr);
+            break;
+        case EXT_HALFU:
+            val = mem_read16u(&m->mem, addr);
+            break;
+        default:
+            printf("unknown load: %x\n", insn);
+            assert(false);
+            return;
+    }
+    write_reg(m, RD(insn), val);
 }
 
 static void store(machine_t* m, uint32_t insn) {
-    // First compute the store address, which is rs1 + imm.
-
-    // Perform the store with mem_writeX(&mm->mem, addr, rs2). Use the immext
-    // (funct3) to determine the size of the store (sb, sh, sw).
-    assert(!"unimplemented");
+    uint32_t addr = m->regs[RS1(insn)] + extract_imm(insn, IMM_S);
+    int32_t val = m->regs[RS2(insn)];
+    switch (FUNCT3(insn)) {
+        case EXT_BYTE:
+            mem_write8(&m->mem, addr, val);
+            break;
+        case EXT_HALF:
+            mem_write16(&m->mem, addr, val);
+            break;
+        case EXT_WORD:
+            mem_write32(&m->mem, addr, val);
+            break;
+        default:
+            printf("unknown store: %x\n", insn);
+            assert(false);
+    }
+    icache_invalidate(m, addr, 1 << FUNCT3(insn));
 }
 
 // Syscall handler: dispatches to the appriopriate syscall implementation in
@@ -142,6 +216,10 @@ static bool ecall(machine_t* m) {
             return false;
         case SYSCALL_FSTAT:
             m->regs[REG_A0] = sys_fstat(m, m->regs[REG_A0], m->regs[REG_A1]);
+            icache_invalidate(m, m->regs[REG_A1], 112);
+            return false;
+        case SYSCALL_SYMBOLIC:
+            m->regs[REG_A0] = 0;
             return false;
         default:
             printf("unknown syscall: %d\n", sysno);
@@ -173,8 +251,43 @@ bool machine_exec(machine_t* m) {
             return true;
     }
 
-    // Decode the opcode, and dispatch to the appropriate helper function.
-    assert(!"unimplemented");
+    switch (bits_get(insn, 6, 0)) {
+        case OP_RARITH:
+            rarith(m, insn);
+            break;
+        case OP_IARITH:
+            iarith(m, insn);
+            break;
+        case OP_BRANCH:
+            jmp = branch(m, insn);
+            break;
+        case OP_LUI:
+            lui(m, insn);
+            break;
+        case OP_AUIPC:
+            auipc(m, insn);
+            break;
+        case OP_JAL:
+            jal(m, insn);
+            jmp = true;
+            break;
+        case OP_JALR:
+            jalr(m, insn);
+            jmp = true;
+            break;
+        case OP_LOAD:
+            load(m, insn);
+            break;
+        case OP_STORE:
+            store(m, insn);
+            break;
+        case OP_FENCE:
+            // single hart, no caches: fences are no-ops
+            break;
+        default:
+            printf("unknown instruction: %x at %x\n", insn, m->pc);
+            assert(false);
+    }
 
     if (!jmp) {
         // if we didn't jump, increment pc to the next instruction.
@@ -184,6 +297,334 @@ bool machine_exec(machine_t* m) {
     return halt;
 }
 
+// Threaded interpreter: machine_run.
+//
+// machine_exec fetches and decodes every instruction every time it runs it.
+// machine_run decodes each instruction once, into a decoded_t that holds its
+// operands, its immediate and the address of the code that executes it (a
+// label in machine_run, jumped to with computed goto). The decoded
+// instructions of a page of memory sit in an array in address order, so the
+// next instruction is the next entry, and a basic block runs from one entry
+// to the next without going back through a loop or a switch. Branches and
+// jal keep a pointer to their target's entry.
+//
+// Entries are decoded a basic block at a time, the first time one of them
+// is run. A store to memory that has been decoded (self-modifying code, or
+// data next to code) puts the entries it overlaps back to "not decoded", so
+// they are decoded again from the new bytes when they are next reached.
+
+#define ICACHE_PAGE_BITS 12
+#define ICACHE_PAGE_INSNS ((1 << ICACHE_PAGE_BITS) / 4)
+
+typedef enum {
+    H_DECODE,       // not decoded yet
+    H_PAGE_END,     // past the last instruction of a page
+    H_NOP,          // also any non-jump instruction with rd = 0
+    H_ADD, H_SUB, H_SLL, H_SLT, H_SLTU, H_XOR, H_SRL, H_SRA, H_OR, H_AND,
+    H_ADDI, H_SLTI, H_SLTIU, H_XORI, H_ORI, H_ANDI, H_SLLI, H_SRLI, H_SRAI,
+    H_LI,           // lui, and auipc (the immediate is pc + imm)
+    H_BEQ, H_BNE, H_BLT, H_BGE, H_BLTU, H_BGEU,
+    H_JAL, H_JALR,
+    H_LB, H_LH, H_LW, H_LBU, H_LHU,
+    H_SB, H_SH, H_SW,
+    H_ECALL, H_EBREAK,
+    H_ILLEGAL,
+    N_HANDLERS,
+} handler_t;
+
+typedef struct decoded {
+    const void* handler;
+    struct decoded* target;     // branches and jal, NULL if not in memory
+    uint32_t pc;
+    int32_t imm;
+    uint8_t rd, rs1, rs2;
+} decoded_t;
+
+struct icache_page {
+    // one more, past the end, that moves on to the next page
+    decoded_t insns[ICACHE_PAGE_INSNS + 1];
+};
+
+// machine_run's labels, by handler_t
+static const void* const* HANDLERS = NULL;
+
+// The entry for 'pc', allocating its page; NULL if 'pc' is not an
+// instruction address in memory.
+static decoded_t* icache_lookup(machine_t* m, uint32_t pc) {
+    uint32_t off = pc - m->mem.base;
+    if (off >= m->mem.size || off % 4) {
+        return NULL;
+    }
+    icache_page_t** slot = &m->icache[off >> ICACHE_PAGE_BITS];
+    if (!*slot) {
+        icache_page_t* page = malloc(sizeof(*page));
+        assert(page);
+        uint32_t base = pc & ~((1 << ICACHE_PAGE_BITS) - 1);
+        for (int i = 0; i <= ICACHE_PAGE_INSNS; i++) {
+            page->insns[i] = (decoded_t){
+                .handler = HANDLERS[i == ICACHE_PAGE_INSNS ? H_PAGE_END : H_DECODE],
+                .pc = base + 4 * i,
+            };
+        }
+        *slot = page;
+    }
+    return &(*slot)->insns[(off % (1 << ICACHE_PAGE_BITS)) / 4];
+}
+
+void icache_invalidate(machine_t* m, uint32_t addr, uint32_t size) {
+    if (m->jit && size) {
+        jit_invalidate(m, addr, size);
+    }
+    if (!HANDLERS || !size) {
+        return;
+    }
+    uint32_t first = (addr - m->mem.base) & ~3, last = (addr - m->mem.base + size - 1) & ~3;
+    for (uint32_t off = first; off <= last && off < m->mem.size; off += 4) {
+        icache_page_t* page = m->icache[off >> ICACHE_PAGE_BITS];
+        if (page) {
+            page->insns[(off % (1 << ICACHE_PAGE_BITS)) / 4].handler = HANDLERS[H_DECODE];
+        }
+    }
+}
+
+// Decodes 'insn' into 'e' (whose pc is set); returns true if it ends a basic
+// block.
+static bool decode(machine_t* m, decoded_t* e, uint32_t insn) {
+    static const handler_t rarith[] = {
+        [ALU_ADD] = H_ADD, [ALU_SUB] = H_SUB, [ALU_SLL] = H_SLL, [ALU_SLT] = H_SLT,
+        [ALU_SLTU] = H_SLTU, [ALU_XOR] = H_XOR, [ALU_SRL] = H_SRL, [ALU_SRA] = H_SRA,
+        [ALU_OR] = H_OR, [ALU_AND] = H_AND,
+    };
+    static const handler_t iarith[] = {
+        [ALU_ADD] = H_ADDI, [ALU_SLL] = H_SLLI, [ALU_SLT] = H_SLTI, [ALU_SLTU] = H_SLTIU,
+        [ALU_XOR] = H_XORI, [ALU_SRL] = H_SRLI, [ALU_SRA] = H_SRAI, [ALU_OR] = H_ORI,
+        [ALU_AND] = H_ANDI,
+    };
+    static const handler_t branches[] = {
+        H_BEQ, H_BNE, H_ILLEGAL, H_ILLEGAL, H_BLT, H_BGE, H_BLTU, H_BGEU,
+    };
+    static const handler_t loads[] = {
+        H_LB, H_LH, H_LW, H_ILLEGAL, H_LBU, H_LHU, H_ILLEGAL, H_ILLEGAL,
+    };
+    static const handler_t stores[] = {
+        H_SB, H_SH, H_SW, H_ILLEGAL, H_ILLEGAL, H_ILLEGAL, H_ILLEGAL, H_ILLEGAL,
+    };
+
+    handler_t h = H_ILLEGAL;
+    bool ends = false;
+    e->rd = RD(insn);
+    e->rs1 = RS1(insn);
+    e->rs2 = RS2(insn);
+    e->imm = 0;
+    e->target = NULL;
+
+    uint32_t op = bits_get(insn, 6, 0);
+    if (insn == INSN_ECALL) {
+        h = H_ECALL;
+        ends = true;
+    } else if (insn == INSN_EBREAK) {
+        h = H_EBREAK;
+        ends = true;
+    } else if (op == OP_RARITH) {
+        alu_op_t alu = (FUNCT7(insn) << 3) | FUNCT3(insn);
+        if (alu < sizeof(rarith) / sizeof(rarith[0]) && rarith[alu]) {
+            h = rarith[alu];
+        }
+    } else if (op == OP_IARITH) {
+        alu_op_t alu = iarith_op(insn);
+        e->imm = extract_imm(insn, IMM_I);
+        if (alu == ALU_SLL || alu == ALU_SRL || alu == ALU_SRA) {
+            e->imm = SHAMT(insn);
+        }
+        if (alu < sizeof(iarith) / sizeof(iarith[0]) && iarith[alu]) {
+            h = iarith[alu];
+        }
+    } else if (op == OP_LUI || op == OP_AUIPC) {
+        h = H_LI;
+        e->imm = extract_imm(insn, IMM_U) + (op == OP_AUIPC ? e->pc : 0);
+    } else if (op == OP_BRANCH) {
+        h = branches[FUNCT3(insn)];
+        e->imm = extract_imm(insn, IMM_B);
+        e->target = icache_lookup(m, e->pc + e->imm);
+        ends = true;
+    } else if (op == OP_JAL) {
+        h = H_JAL;
+        e->imm = extract_imm(insn, IMM_J);
+        e->target = icache_lookup(m, e->pc + e->imm);
+        ends = true;
+    } else if (op == OP_JALR) {
+        h = H_JALR;
+        e->imm = extract_imm(insn, IMM_I);
+        ends = true;
+    } else if (op == OP_LOAD) {
+        h = loads[FUNCT3(insn)];
+        e->imm = extract_imm(insn, IMM_I);
+    } else if (op == OP_STORE) {
+        h = stores[FUNCT3(insn)];
+        e->imm = extract_imm(insn, IMM_S);
+    } else if (op == OP_FENCE) {
+        h = H_NOP;
+    }
+
+    // a write to x0 does nothing (a load to x0 doesn't fault here)
+    if (e->rd == 0 && ((h >= H_ADD && h <= H_LI) || (h >= H_LB && h <= H_LHU))) {
+        h = H_NOP;
+    }
+    if (h == H_ILLEGAL) {
+        // keep the instruction, to report it if it is ever run
+        e->imm = insn;
+        ends = true;
+    }
+    e->handler = HANDLERS[h];
+    return ends;
+}
+
+// Memory access for machine_run, as mem.c's (an access is rounded down to
+// its size).
+static inline uint8_t* mem_at(machine_t* m, uint32_t addr, uint32_t size) {
+    addr -= m->mem.base;
+    assert(addr < m->mem.size);
+    return m->mem.data + (addr & ~(size - 1));
+}
+
+// Runs the machine until it halts, and returns how many instructions it
+// executed (as many as machine_exec would have been called for).
+uint64_t machine_run(machine_t* m) {
+    static const void* const handlers[N_HANDLERS] = {
+        [H_DECODE] = &&decode, [H_PAGE_END] = &&page_end, [H_NOP] = &&nop,
+        [H_ADD] = &&add, [H_SUB] = &&sub, [H_SLL] = &&sll, [H_SLT] = &&slt,
+        [H_SLTU] = &&sltu, [H_XOR] = &&xor, [H_SRL] = &&srl, [H_SRA] = &&sra,
+        [H_OR] = &&or, [H_AND] = &&and,
+        [H_ADDI] = &&addi, [H_SLTI] = &&slti, [H_SLTIU] = &&sltiu, [H_XORI] = &&xori,
+        [H_ORI] = &&ori, [H_ANDI] = &&andi, [H_SLLI] = &&slli, [H_SRLI] = &&srli,
+        [H_SRAI] = &&srai, [H_LI] = &&li,
+        [H_BEQ] = &&beq, [H_BNE] = &&bne, [H_BLT] = &&blt, [H_BGE] = &&bge,
+        [H_BLTU] = &&bltu, [H_BGEU] = &&bgeu,
+        [H_JAL] = &&jal, [H_JALR] = &&jalr,
+        [H_LB] = &&lb, [H_LH] = &&lh, [H_LW] = &&lw, [H_LBU] = &&lbu, [H_LHU] = &&lhu,
+        [H_SB] = &&sb, [H_SH] = &&sh, [H_SW] = &&sw,
+        [H_ECALL] = &&ecall, [H_EBREAK] = &&ebreak, [H_ILLEGAL] = &&illegal,
+    };
+    HANDLERS = handlers;
+
+    int32_t* r = m->regs;
+    uint64_t n = 0;
+    uint32_t pc = m->pc;
+    decoded_t* e;
+
+// DISPATCH runs 'e'; NEXT runs the instruction after it
+#define DISPATCH do { n++; goto *e->handler; } while (0)
+#define NEXT do { e++; DISPATCH; } while (0)
+#define BRANCH(cond) do { \
+        if (!(cond)) NEXT; \
+        if (!e->target) { pc = e->pc + e->imm; goto jump; } \
+        e = e->target; \
+        DISPATCH; \
+    } while (0)
+
+jump:
+    e = icache_lookup(m, pc);
+    if (!e) {
+        printf("bad pc: %x\n", pc);
+        assert(false);
+        m->pc = pc;
+        return n;
+    }
+    DISPATCH;
+
+decode:
+    n--;
+    for (decoded_t* d = e; d->handler != handlers[H_PAGE_END] && d->pc - m->mem.base < m->mem.size; d++) {
+        if (decode(m, d, mem_read32(&m->mem, d->pc))) {
+            break;
+        }
+    }
+    DISPATCH;
+page_end:
+    n--;
+    pc = e->pc;
+    goto jump;
+
+nop: NEXT;
+add: r[e->rd] = (uint32_t) r[e->rs1] + (uint32_t) r[e->rs2]; NEXT;
+sub: r[e->rd] = (uint32_t) r[e->rs1] - (uint32_t) r[e->rs2]; NEXT;
+sll: r[e->rd] = (uint32_t) r[e->rs1] << (r[e->rs2] & 31); NEXT;
+slt: r[e->rd] = r[e->rs1] < r[e->rs2]; NEXT;
+sltu: r[e->rd] = (uint32_t) r[e->rs1] < (uint32_t) r[e->rs2]; NEXT;
+xor: r[e->rd] = r[e->rs1] ^ r[e->rs2]; NEXT;
+srl: r[e->rd] = (uint32_t) r[e->rs1] >> (r[e->rs2] & 31); NEXT;
+sra: r[e->rd] = r[e->rs1] >> (r[e->rs2] & 31); NEXT;
+or: r[e->rd] = r[e->rs1] | r[e->rs2]; NEXT;
+and: r[e->rd] = r[e->rs1] & r[e->rs2]; NEXT;
+addi: r[e->rd] = (uint32_t) r[e->rs1] + e->imm; NEXT;
+slti: r[e->rd] = r[e->rs1] < e->imm; NEXT;
+sltiu: r[e->rd] = (uint32_t) r[e->rs1] < (uint32_t) e->imm; NEXT;
+xori: r[e->rd] = r[e->rs1] ^ e->imm; NEXT;
+ori: r[e->rd] = r[e->rs1] | e->imm; NEXT;
+andi: r[e->rd] = r[e->rs1] & e->imm; NEXT;
+slli: r[e->rd] = (uint32_t) r[e->rs1] << e->imm; NEXT;
+srli: r[e->rd] = (uint32_t) r[e->rs1] >> e->imm; NEXT;
+srai: r[e->rd] = r[e->rs1] >> e->imm; NEXT;
+li: r[e->rd] = e->imm; NEXT;
+
+beq: BRANCH(r[e->rs1] == r[e->rs2]);
+bne: BRANCH(r[e->rs1] != r[e->rs2]);
+blt: BRANCH(r[e->rs1] < r[e->rs2]);
+bge: BRANCH(r[e->rs1] >= r[e->rs2]);
+bltu: BRANCH((uint32_t) r[e->rs1] < (uint32_t) r[e->rs2]);
+bgeu: BRANCH((uint32_t) r[e->rs1] >= (uint32_t) r[e->rs2]);
+jal:
+    r[e->rd] = e->pc + 4;
+    r[0] = 0;
+    BRANCH(true);
+jalr:
+    // read rs1 before writing rd, in case they are the same
+    pc = ((uint32_t) r[e->rs1] + e->imm) & ~1;
+    r[e->rd] = e->pc + 4;
+    r[0] = 0;
+    goto jump;
+
+lb: r[e->rd] = *(int8_t*) mem_at(m, (uint32_t) r[e->rs1] + e->imm, 1); NEXT;
+lh: r[e->rd] = *(int16_t*) mem_at(m, (uint32_t) r[e->rs1] + e->imm, 2); NEXT;
+lw: r[e->rd] = *(int32_t*) mem_at(m, (uint32_t) r[e->rs1] + e->imm, 4); NEXT;
+lbu: r[e->rd] = *(uint8_t*) mem_at(m, (uint32_t) r[e->rs1] + e->imm, 1); NEXT;
+lhu: r[e->rd] = *(uint16_t*) mem_at(m, (uint32_t) r[e->rs1] + e->imm, 2); NEXT;
+
+// a store to a page with decoded instructions may have changed some
+#define STORE(type, size) do { \
+        uint32_t addr = (uint32_t) r[e->rs1] + e->imm; \
+        *(type*) mem_at(m, addr, size) = r[e->rs2]; \
+        if (m->icache[(addr - m->mem.base) >> ICACHE_PAGE_BITS]) { \
+            icache_invalidate(m, addr, size); \
+        } \
+        NEXT; \
+    } while (0)
+sb: STORE(uint8_t, 1);
+sh: STORE(uint16_t, 2);
+sw: STORE(uint32_t, 4);
+
+ecall:
+    m->pc = e->pc;
+    if (ecall(m)) {
+        m->pc = e->pc + 4;
+        return n;
+    }
+    NEXT;
+ebreak:
+    m->pc = e->pc;
+    return n;
+illegal:
+    printf("unknown instruction: %x at %x\n", e->imm, e->pc);
+    assert(false);
+    m->pc = e->pc;
+    return n;
+
+#undef DISPATCH
+#undef NEXT
+#undef BRANCH
+#undef STORE
+}
+
 void machine_new(machine_t* m, uint32_t membase, uint32_t memsize) {
     m->mem = (mem_t){
         .data = (uint8_t*) malloc(memsize),
@@ -191,11 +632,18 @@ void machine_new(machine_t* m, uint32_t membase, uint32_t memsize) {
         .size = memsize,
     };
     assert(m->mem.data);
+    m->icache = calloc((memsize >> ICACHE_PAGE_BITS) + 1, sizeof(m->icache[0]));
+    assert(m->icache);
+    m->jit = NULL;
     memset(&m->regs, 0, sizeof(m->regs));
     // setup a stack at the top of memory.
     m->regs[REG_SP] = memsize - 16;
 }
 
 void machine_free(machine_t* m) {
+    for (uint32_t i = 0; i <= m->mem.size >> ICACHE_PAGE_BITS; i++) {
+        free(m->icache[i]);
+    }
+    free(m->icache);
     free(m->mem.data);
 }
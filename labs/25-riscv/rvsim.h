@@ -94,6 +94,9 @@ typedef enum {
     SYSCALL_CLOSE = 57,
     SYSCALL_FSTAT = 80,
     SYSCALL_BRK = 214,
+    // not Linux: marks a0[0..a1) as program input, for symsim (rvsim leaves
+    // the bytes as they are)
+    SYSCALL_SYMBOLIC = 1000,
 } syscall_t;
 
 typedef struct {
@@ -112,17 +115,44 @@ int16_t mem_read16(mem_t* m, uint32_t addr);
 uint16_t mem_read16u(mem_t* m, uint32_t addr);
 int32_t mem_read32(mem_t* m, uint32_t addr);
 
+typedef struct icache_page icache_page_t;
+typedef struct jit jit_t;
+
 typedef struct {
     int32_t pc;
     int32_t regs[32];
     mem_t mem;
 
     uint32_t brk;
+
+    // pre-decoded instructions for machine_run, per page of memory (NULL
+    // where nothing has been decoded)
+    icache_page_t** icache;
+    // machine_jit's translations, while it runs
+    jit_t* jit;
 } machine_t;
 
+// Instruction fields.
+#define RD(x) bits_get(x, 11, 7)
+#define RS1(x) bits_get(x, 19, 15)
+#define RS2(x) bits_get(x, 24, 20)
+#define SHAMT(x) bits_get(x, 24, 20)
+#define FUNCT3(x) bits_get(x, 14, 12)
+#define FUNCT7(x) bits_get(x, 31, 25)
+
+// Decoder helpers, shared with the symbolic back end (symsim.c).
+int32_t alu_compute(int32_t a, int32_t b, alu_op_t op);
+uint32_t extract_imm(uint32_t insn, imm_type_t type);
+alu_op_t iarith_op(uint32_t insn);
+alu_op_t branch_op(uint32_t insn, bool* jump_if_zero);
+
 void machine_new(machine_t* m, uint32_t membase, uint32_t memsize);
 void machine_free(machine_t* m);
 bool machine_exec(machine_t* m);
+uint64_t machine_run(machine_t* m);
+uint64_t machine_jit(machine_t* m);
+void icache_invalidate(machine_t* m, uint32_t addr, uint32_t size);
+void jit_invalidate(machine_t* m, uint32_t addr, uint32_t size);
 void machine_load(machine_t* m, char* elfdat);
 
 int sys_write(machine_t* m, int fd, uint32_t buf, uint32_t size);
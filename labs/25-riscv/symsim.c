@@ -0,0 +1,913 @@
+// Symbolic execution of RV32I ELF binaries.
+//
+// This runs a program the way rvsim does, decoding with the same helpers
+// (rvsim.h), except that registers and memory bytes may hold symbolic terms
+// over the program's inputs. The SYSCALL_SYMBOLIC ecall marks a buffer as
+// input. As long as the operands of an instruction are concrete it executes
+// natively, as in rvsim; only instructions that touch symbolic values build
+// terms. A branch on a symbolic condition asks the solver (the smt lab's,
+// smt.h) whether each side is feasible under the path so far, and forks the
+// path if both are. A path fails if it exits with a nonzero status, or
+// faults; for each failing path we print the input bytes that drive the
+// program down it.
+//
+// Every path keeps a model: input bytes under which it is feasible. A
+// symbolic branch goes the model's way without a query, so only the other
+// side needs one, and its model becomes the forked path's. Symbolic load and
+// store addresses and jump targets are concretized to their model value
+// (with a constraint saying so), and so are ecall arguments.
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rvsim.h"
+#include "bits.h"
+#include "smt.h"
+
+// Options; see usage()
+static long MAX_PATHS = 0, MAX_STEPS = 100000000;
+static bool VERBOSE = false;
+
+/**** TERMS ****/
+
+// Terms are 32-bit words over the input bytes. They are hash-consed and never
+// freed; building one folds constants and a few identities, so a term is only
+// ever built for a value that really depends on the input.
+typedef enum {
+    T_CONST,    // value
+    T_INPUT,    // input byte number 'value', zero-extended
+    T_ADD,      // a + b, and so on, as alu_compute
+    T_SUB,
+    T_SLL,
+    T_SLT,
+    T_SLTU,
+    T_XOR,
+    T_SRL,
+    T_SRA,
+    T_OR,
+    T_AND,
+    T_EQ,       // a == b, 0 or 1
+} term_kind_t;
+
+typedef struct term {
+    term_kind_t kind;
+    int id;         // dense, indexes the per-query and per-eval memos
+    uint32_t value;
+    struct term* a;
+    struct term* b;
+    struct term* next;  // hash chain
+} term_t;
+
+#define TERM_BUCKETS (1 << 18)
+static term_t* TERMS[TERM_BUCKETS];
+static int N_TERMS = 0;
+
+static term_t* term_new(term_kind_t kind, uint32_t value, term_t* a, term_t* b) {
+    uint64_t hash = ((uint64_t) kind * 0x9e3779b97f4a7c15UL) ^ value;
+    hash = (hash ^ (uintptr_t) a) * 0xff51afd7ed558ccdUL;
+    hash = (hash ^ (uintptr_t) b) * 0xc4ceb9fe1a85ec53UL;
+    hash ^= hash >> 29;
+    term_t** bucket = &TERMS[hash % TERM_BUCKETS];
+    for (term_t* t = *bucket; t; t = t->next) {
+        if (t->kind == kind && t->value == value && t->a == a && t->b == b) {
+            return t;
+        }
+    }
+    term_t* t = malloc(sizeof(*t));
+    *t = (term_t){ kind, N_TERMS++, value, a, b, *bucket };
+    *bucket = t;
+    return t;
+}
+
+static term_t* term_const(uint32_t value) {
+    return term_new(T_CONST, value, NULL, NULL);
+}
+
+static bool is_const(term_t* t, uint32_t value) {
+    return t->kind == T_CONST && t->value == value;
+}
+
+static const alu_op_t TERM_ALU[] = {
+    [T_ADD] = ALU_ADD, [T_SUB] = ALU_SUB, [T_SLL] = ALU_SLL, [T_SLT] = ALU_SLT,
+    [T_SLTU] = ALU_SLTU, [T_XOR] = ALU_XOR, [T_SRL] = ALU_SRL, [T_SRA] = ALU_SRA,
+    [T_OR] = ALU_OR, [T_AND] = ALU_AND,
+};
+
+static term_kind_t alu_term(alu_op_t op) {
+    switch (op) {
+        case ALU_ADD: return T_ADD;
+        case ALU_SUB: return T_SUB;
+        case ALU_SLL: return T_SLL;
+        case ALU_SLT: return T_SLT;
+        case ALU_SLTU: return T_SLTU;
+        case ALU_XOR: return T_XOR;
+        case ALU_SRL: return T_SRL;
+        case ALU_SRA: return T_SRA;
+        case ALU_OR: return T_OR;
+        case ALU_AND: return T_AND;
+    }
+    assert(false);
+    return T_CONST;
+}
+
+// Whether 'op' is one of the RV32I ALU operations (R-type encodings outside
+// RV32I, like RV32M's mul, decode to other values).
+static bool is_alu_op(alu_op_t op) {
+    switch (op) {
+        case ALU_ADD: case ALU_SUB: case ALU_SLL: case ALU_SLT: case ALU_SLTU:
+        case ALU_XOR: case ALU_SRL: case ALU_SRA: case ALU_OR: case ALU_AND:
+            return true;
+    }
+    return false;
+}
+
+static uint32_t concrete(term_kind_t kind, uint32_t a, uint32_t b) {
+    if (kind == T_EQ) {
+        return a == b;
+    }
+    return alu_compute(a, b, TERM_ALU[kind]);
+}
+
+// a <kind> b, folding constants and the identities that leave an operand or a
+// constant.
+static term_t* term_op(term_kind_t kind, term_t* a, term_t* b) {
+    if (a->kind == T_CONST && b->kind == T_CONST) {
+        return term_const(concrete(kind, a->value, b->value));
+    }
+    switch (kind) {
+        case T_ADD:
+        case T_OR:
+        case T_XOR:
+            if (is_const(a, 0)) {
+                return b;
+            }
+            // fall through
+        case T_SUB:
+        case T_SLL:
+        case T_SRL:
+        case T_SRA:
+            if (is_const(b, 0)) {
+                return a;
+            }
+            break;
+        case T_AND:
+            if (is_const(a, 0) || is_const(b, 0)) {
+                return term_const(0);
+            }
+            if (is_const(b, 0xffffffff)) {
+                return a;
+            }
+            // input bytes are already zero-extended
+            if (is_const(b, 0xff) && a->kind == T_INPUT) {
+                return a;
+            }
+            break;
+        case T_EQ:
+            // beq and bne compare the xor of their operands with zero
+            if (is_const(b, 0) && (a->kind == T_XOR || a->kind == T_SUB)) {
+                return term_op(T_EQ, a->a, a->b);
+            }
+            break;
+        default:
+            break;
+    }
+    if (a == b) {
+        switch (kind) {
+            case T_SUB:
+            case T_XOR:
+            case T_SLT:
+            case T_SLTU:
+                return term_const(0);
+            case T_AND:
+            case T_OR:
+                return a;
+            case T_EQ:
+                return term_const(1);
+            default:
+                break;
+        }
+    }
+    return term_new(kind, 0, a, b);
+}
+
+// Byte 'i' of 't', if it is plainly one of the bytes 't' was put together
+// from (as loads do), else NULL. Keeps copied input bytes input bytes.
+static term_t* term_byte(term_t* t, int i) {
+    switch (t->kind) {
+        case T_CONST:
+            return term_const((t->value >> (8 * i)) & 0xff);
+        case T_INPUT:
+            return i == 0 ? t : term_const(0);
+        case T_SLL:
+            if (t->b->kind == T_CONST && t->b->value % 8 == 0 && t->b->value < 32) {
+                int shift = t->b->value / 8;
+                return i < shift ? term_const(0) : term_byte(t->a, i - shift);
+            }
+            return NULL;
+        case T_SRL:
+        case T_SRA:
+            if (t->b->kind == T_CONST && t->b->value % 8 == 0 && i + t->b->value / 8 < 4) {
+                return term_byte(t->a, i + t->b->value / 8);
+            }
+            return NULL;
+        case T_OR: {
+            term_t* a = term_byte(t->a, i);
+            term_t* b = term_byte(t->b, i);
+            if (a && b && is_const(a, 0)) {
+                return b;
+            }
+            if (a && b && is_const(b, 0)) {
+                return a;
+            }
+            return NULL;
+        }
+        default:
+            return NULL;
+    }
+}
+
+/**** MODELS ****/
+
+// The value of 't' when the input bytes are 'input'. Memoized per call,
+// since terms share subterms.
+static uint32_t* EVAL_VALUE = NULL;
+static int* EVAL_EPOCH = NULL;
+static int N_EVAL = 0, EPOCH = 0;
+
+static uint32_t eval_rec(term_t* t, const uint8_t* input) {
+    if (t->kind == T_CONST) {
+        return t->value;
+    }
+    if (t->kind == T_INPUT) {
+        return input[t->value];
+    }
+    if (t->id >= N_EVAL) {
+        int n = 2 * t->id + 1;
+        EVAL_VALUE = realloc(EVAL_VALUE, n * sizeof(EVAL_VALUE[0]));
+        EVAL_EPOCH = realloc(EVAL_EPOCH, n * sizeof(EVAL_EPOCH[0]));
+        memset(EVAL_EPOCH + N_EVAL, 0, (n - N_EVAL) * sizeof(EVAL_EPOCH[0]));
+        N_EVAL = n;
+    }
+    if (EVAL_EPOCH[t->id] == EPOCH) {
+        return EVAL_VALUE[t->id];
+    }
+    uint32_t a = eval_rec(t->a, input);
+    uint32_t b = eval_rec(t->b, input);
+    uint32_t value = concrete(t->kind, a, b);
+    EVAL_VALUE[t->id] = value;
+    EVAL_EPOCH[t->id] = EPOCH;
+    return value;
+}
+
+static uint32_t eval(term_t* t, const uint8_t* input) {
+    EPOCH++;
+    return eval_rec(t, input);
+}
+
+/**** STATES ****/
+
+// A value is concrete ('t' is NULL) or a term.
+typedef struct {
+    uint32_t c;
+    term_t* t;
+} value_t;
+
+static value_t value_of(term_t* t) {
+    if (t->kind == T_CONST) {
+        return (value_t){ t->value, NULL };
+    }
+    return (value_t){ 0, t };
+}
+
+static term_t* term_of(value_t v) {
+    return v.t ? v.t : term_const(v.c);
+}
+
+// Memory is the ELF image, plus pages that a path has written to. Pages are
+// shared between forked paths and copied on the first write after a fork.
+#define PAGE_BITS 12
+#define PAGE_SIZE (1 << PAGE_BITS)
+
+typedef struct {
+    int refs;
+    uint8_t data[PAGE_SIZE];
+    term_t** sym;   // NULL if every byte is concrete, else NULL per concrete byte
+} page_t;
+
+static mem_t IMAGE;
+static uint32_t N_PAGES;
+
+// Constraint: ('cond' != 0) == 'holds'.
+typedef struct {
+    term_t* cond;
+    bool holds;
+} constraint_t;
+
+typedef struct {
+    uint32_t pc;
+    value_t regs[32];
+    uint32_t brk;
+    page_t** pages;     // NULL: as in the image
+    long steps;
+
+    constraint_t* path;
+    int n_path;
+    uint8_t* input;     // the model
+    int n_input;
+} state_t;
+
+static long N_PATHS = 0, N_FAILED = 0, N_QUERIES = 0, N_STEPS = 0;
+
+static state_t* fork_state(state_t* s) {
+    state_t* child = malloc(sizeof(*child));
+    *child = *s;
+    child->pages = malloc(N_PAGES * sizeof(child->pages[0]));
+    memcpy(child->pages, s->pages, N_PAGES * sizeof(child->pages[0]));
+    for (uint32_t i = 0; i < N_PAGES; i++) {
+        if (child->pages[i]) {
+            child->pages[i]->refs++;
+        }
+    }
+    child->path = malloc((s->n_path + 1) * sizeof(child->path[0]));
+    memcpy(child->path, s->path, s->n_path * sizeof(child->path[0]));
+    child->input = malloc(s->n_input + 1);
+    memcpy(child->input, s->input, s->n_input);
+    return child;
+}
+
+static void release_page(page_t* page) {
+    if (page && --page->refs == 0) {
+        free(page->sym);
+        free(page);
+    }
+}
+
+static void free_state(state_t* s) {
+    for (uint32_t i = 0; i < N_PAGES; i++) {
+        release_page(s->pages[i]);
+    }
+    free(s->pages);
+    free(s->path);
+    free(s->input);
+    free(s);
+}
+
+static void constrain(state_t* s, term_t* cond, bool holds) {
+    s->path = realloc(s->path, (s->n_path + 1) * sizeof(s->path[0]));
+    s->path[s->n_path++] = (constraint_t){ cond, holds };
+}
+
+static bool in_memory(uint32_t addr, uint32_t size) {
+    addr -= IMAGE.base;
+    return addr < IMAGE.size && size <= IMAGE.size - addr;
+}
+
+static value_t read_byte(state_t* s, uint32_t addr) {
+    uint32_t off = addr - IMAGE.base;
+    page_t* page = s->pages[off >> PAGE_BITS];
+    if (!page) {
+        return (value_t){ IMAGE.data[off], NULL };
+    }
+    off &= PAGE_SIZE - 1;
+    if (page->sym && page->sym[off]) {
+        return (value_t){ 0, page->sym[off] };
+    }
+    return (value_t){ page->data[off], NULL };
+}
+
+static void write_byte(state_t* s, uint32_t addr, value_t v) {
+    uint32_t off = addr - IMAGE.base;
+    page_t** slot = &s->pages[off >> PAGE_BITS];
+    page_t* page = *slot;
+    if (!page || page->refs > 1) {
+        page_t* copy = malloc(sizeof(*copy));
+        copy->refs = 1;
+        copy->sym = NULL;
+        if (page) {
+            memcpy(copy->data, page->data, PAGE_SIZE);
+            if (page->sym) {
+                copy->sym = malloc(PAGE_SIZE * sizeof(copy->sym[0]));
+                memcpy(copy->sym, page->sym, PAGE_SIZE * sizeof(copy->sym[0]));
+            }
+            page->refs--;
+        } else {
+            memcpy(copy->data, IMAGE.data + (off & ~(PAGE_SIZE - 1)), PAGE_SIZE);
+        }
+        *slot = page = copy;
+    }
+    off &= PAGE_SIZE - 1;
+    if (v.t && !page->sym) {
+        page->sym = calloc(PAGE_SIZE, sizeof(page->sym[0]));
+    }
+    if (page->sym) {
+        page->sym[off] = v.t;
+    }
+    page->data[off] = v.c;
+}
+
+/**** SOLVER ****/
+
+// Each query is built from scratch (see smt_reset). HANDLE memoizes the smt.h
+// handle of every term for the current query, and INPUT_HANDLE that of every
+// input byte, to read the model back.
+static int* HANDLE = NULL;
+static int* HANDLE_QUERY = NULL;
+static int N_HANDLE = 0, QUERY = 0;
+static int* INPUT_HANDLE = NULL;
+static int N_INPUT_HANDLE = 0;
+
+static int blast(term_t* t);
+
+// A word that is 1 if 'lit' is true, else 0.
+static int bool_word(int lit) {
+    int word = new_bv(32);
+    clause(-lit, bv_eq(word, const_bv(1, 32)));
+    clause(lit, bv_eq(word, const_bv(0, 32)));
+    return word;
+}
+
+// The literal for 't' != 0. Comparisons become their literal directly.
+static int nonzero_lit(term_t* t) {
+    switch (t->kind) {
+        case T_EQ: return bv_eq(blast(t->a), blast(t->b));
+        case T_SLT: return bv_slt(blast(t->a), blast(t->b));
+        case T_SLTU: return bv_ult(blast(t->a), blast(t->b));
+        default: return -bv_eq(blast(t), const_bv(0, 32));
+    }
+}
+
+static int blast(term_t* t) {
+    if (t->id >= N_HANDLE) {
+        int n = 2 * t->id + 1;
+        HANDLE = realloc(HANDLE, n * sizeof(HANDLE[0]));
+        HANDLE_QUERY = realloc(HANDLE_QUERY, n * sizeof(HANDLE_QUERY[0]));
+        memset(HANDLE_QUERY + N_HANDLE, 0, (n - N_HANDLE) * sizeof(HANDLE_QUERY[0]));
+        N_HANDLE = n;
+    }
+    if (HANDLE_QUERY[t->id] == QUERY) {
+        return HANDLE[t->id];
+    }
+
+    // RISC-V shifts only use the low 5 bits of the amount
+    int handle = 0;
+    switch (t->kind) {
+        case T_CONST: handle = const_bv(t->value, 32); break;
+        case T_INPUT:
+            handle = bv_and(new_bv(32), const_bv(0xff, 32));
+            if ((int) t->value >= N_INPUT_HANDLE) {
+                int n = 2 * t->value + 1;
+                INPUT_HANDLE = realloc(INPUT_HANDLE, n * sizeof(INPUT_HANDLE[0]));
+                memset(INPUT_HANDLE + N_INPUT_HANDLE, 0, (n - N_INPUT_HANDLE) * sizeof(INPUT_HANDLE[0]));
+                N_INPUT_HANDLE = n;
+            }
+            INPUT_HANDLE[t->value] = handle;
+            break;
+        case T_ADD: handle = bv_add(blast(t->a), blast(t->b)); break;
+        case T_SUB: handle = bv_sub(blast(t->a), blast(t->b)); break;
+        case T_SLL: handle = bv_shl(blast(t->a), bv_and(blast(t->b), const_bv(31, 32))); break;
+        case T_SRL: handle = bv_lshr(blast(t->a), bv_and(blast(t->b), const_bv(31, 32))); break;
+        case T_SRA: handle = bv_ashr(blast(t->a), bv_and(blast(t->b), const_bv(31, 32))); break;
+        case T_XOR: handle = bv_xor(blast(t->a), blast(t->b)); break;
+        case T_OR: handle = bv_or(blast(t->a), blast(t->b)); break;
+        case T_AND: handle = bv_and(blast(t->a), blast(t->b)); break;
+        case T_SLT:
+        case T_SLTU:
+        case T_EQ: handle = bool_word(nonzero_lit(t)); break;
+    }
+    HANDLE[t->id] = handle;
+    HANDLE_QUERY[t->id] = QUERY;
+    return handle;
+}
+
+// Is the path of 's' plus ('cond' != 0) == 'holds' feasible? If so, returns a
+// model for it (input bytes that no constraint mentions keep their value).
+static uint8_t* feasible(state_t* s, term_t* cond, bool holds) {
+    smt_reset();
+    QUERY++;
+    N_QUERIES++;
+    if (INPUT_HANDLE) {
+        memset(INPUT_HANDLE, 0, N_INPUT_HANDLE * sizeof(INPUT_HANDLE[0]));
+    }
+    for (int i = 0; i < s->n_path; i++) {
+        int lit = nonzero_lit(s->path[i].cond);
+        clause(s->path[i].holds ? lit : -lit);
+    }
+    int lit = nonzero_lit(cond);
+    clause(holds ? lit : -lit);
+    if (!solve()) {
+        return NULL;
+    }
+    uint8_t* input = malloc(s->n_input + 1);
+    for (int i = 0; i < s->n_input; i++) {
+        input[i] = (i < N_INPUT_HANDLE && INPUT_HANDLE[i]) ? get_solution(INPUT_HANDLE[i], 0) : s->input[i];
+    }
+    return input;
+}
+
+/**** EXECUTION ****/
+
+static state_t** WORKLIST = NULL;
+static int N_WORKLIST = 0;
+
+static void print_input(const uint8_t* input, int n_input) {
+    printf("  input (%d bytes):", n_input);
+    for (int i = 0; i < n_input; i++) {
+        printf(" %02x", input[i]);
+    }
+    printf("  \"");
+    for (int i = 0; i < n_input; i++) {
+        putchar((input[i] >= 0x20 && input[i] < 0x7f) ? input[i] : '.');
+    }
+    printf("\"\n");
+}
+
+// Ends the path of 's' (without freeing it); 'why' says why, for a failing
+// path.
+static void finish(state_t* s, const char* why, const uint8_t* input) {
+    N_PATHS++;
+    if (!why) {
+        return;
+    }
+    N_FAILED++;
+    printf("path %ld: %s at pc %x after %ld instructions\n", N_PATHS, why, s->pc, s->steps);
+    print_input(input, s->n_input);
+}
+
+// The value of 'v' under the model of 's', constraining the path to it.
+static uint32_t concretize(state_t* s, value_t v) {
+    if (!v.t) {
+        return v.c;
+    }
+    uint32_t c = eval(v.t, s->input);
+    constrain(s, term_op(T_EQ, v.t, term_const(c)), true);
+    return c;
+}
+
+// Decides ('cond' != 0) for 's': the way its model goes, forking a path that
+// goes the other way if the solver finds one. Returns that child, with the
+// constraint added (or NULL), and the decision in 'holds'.
+static state_t* decide(state_t* s, term_t* cond, bool* holds) {
+    *holds = eval(cond, s->input) != 0;
+    uint8_t* other = feasible(s, cond, !*holds);
+    constrain(s, cond, *holds);
+    if (!other) {
+        return NULL;
+    }
+    state_t* child = fork_state(s);
+    child->path[child->n_path - 1].holds = !*holds;
+    free(child->input);
+    child->input = other;
+    return child;
+}
+
+static void write_reg(state_t* s, int reg, value_t v) {
+    if (reg != 0) {
+        s->regs[reg] = v;
+    }
+}
+
+static value_t alu(value_t a, value_t b, alu_op_t op) {
+    if (!a.t && !b.t) {
+        return (value_t){ alu_compute(a.c, b.c, op), NULL };
+    }
+    return value_of(term_op(alu_term(op), term_of(a), term_of(b)));
+}
+
+// Loads 'size' bytes at 'addr', little-endian, sign-extended if 'sext'.
+static value_t load(state_t* s, uint32_t addr, int size, bool sext) {
+    value_t bytes[4];
+    bool symbolic = false;
+    for (int i = 0; i < size; i++) {
+        bytes[i] = read_byte(s, addr + i);
+        symbolic |= bytes[i].t != NULL;
+    }
+    int shift = 32 - 8 * size;
+    if (!symbolic) {
+        uint32_t word = 0;
+        for (int i = 0; i < size; i++) {
+            word |= bytes[i].c << (8 * i);
+        }
+        return (value_t){ sext ? (uint32_t) ((int32_t) (word << shift) >> shift) : word, NULL };
+    }
+    term_t* word = term_const(0);
+    for (int i = 0; i < size; i++) {
+        word = term_op(T_OR, word, term_op(T_SLL, term_of(bytes[i]), term_const(8 * i)));
+    }
+    if (sext && shift) {
+        word = term_op(T_SRA, term_op(T_SLL, word, term_const(shift)), term_const(shift));
+    }
+    return value_of(word);
+}
+
+static void store(state_t* s, uint32_t addr, int size, value_t v) {
+    for (int i = 0; i < size; i++) {
+        if (!v.t) {
+            write_byte(s, addr + i, (value_t){ (v.c >> (8 * i)) & 0xff, NULL });
+            continue;
+        }
+        term_t* byte = term_byte(v.t, i);
+        if (!byte) {
+            byte = term_op(T_AND, term_op(T_SRL, v.t, term_const(8 * i)), term_const(0xff));
+        }
+        write_byte(s, addr + i, value_of(byte));
+    }
+}
+
+// The ecalls of syscall.c, plus SYSCALL_SYMBOLIC. Returns true if the path is
+// done.
+static bool ecall(state_t* s) {
+    int sysno = concretize(s, s->regs[REG_A7]);
+    uint32_t a0 = 0, a1 = 0, a2 = 0;
+    if (sysno != SYSCALL_EXIT) {
+        a0 = concretize(s, s->regs[REG_A0]);
+        a1 = concretize(s, s->regs[REG_A1]);
+        a2 = concretize(s, s->regs[REG_A2]);
+    }
+    switch (sysno) {
+        case SYSCALL_EXIT: {
+            // a symbolic status is a branch on whether it is 0
+            value_t status = s->regs[REG_A0];
+            static char why[64];
+            if (status.t) {
+                bool nonzero;
+                state_t* other = decide(s, status.t, &nonzero);
+                if (other) {
+                    uint32_t c = eval(status.t, other->input);
+                    snprintf(why, sizeof(why), "exit(%d)", (int32_t) c);
+                    finish(other, c ? why : NULL, other->input);
+                    free_state(other);
+                }
+                status.c = eval(status.t, s->input);
+            }
+            snprintf(why, sizeof(why), "exit(%d)", (int32_t) status.c);
+            finish(s, status.c ? why : NULL, s->input);
+            return true;
+        }
+        case SYSCALL_WRITE:
+            if (!in_memory(a1, a2)) {
+                finish(s, "bad write buffer", s->input);
+                return true;
+            }
+            for (uint32_t i = 0; i < a2; i++) {
+                value_t byte = read_byte(s, a1 + i);
+                if (VERBOSE) {
+                    putchar(byte.t ? eval(byte.t, s->input) : byte.c);
+                }
+            }
+            write_reg(s, REG_A0, (value_t){ a2, NULL });
+            return false;
+        case SYSCALL_BRK:
+            if (a0) {
+                s->brk = a0;
+            }
+            write_reg(s, REG_A0, (value_t){ s->brk, NULL });
+            return false;
+        case SYSCALL_CLOSE:
+            write_reg(s, REG_A0, (value_t){ 0, NULL });
+            return false;
+        case SYSCALL_FSTAT:
+            if (!in_memory(a1, 112)) {
+                finish(s, "bad fstat buffer", s->input);
+                return true;
+            }
+            for (uint32_t i = 0; i < 112; i++) {
+                write_byte(s, a1 + i, (value_t){ 0, NULL });
+            }
+            write_reg(s, REG_A0, (value_t){ 0, NULL });
+            return false;
+        case SYSCALL_SYMBOLIC:
+            if (!in_memory(a0, a1)) {
+                finish(s, "bad symbolic buffer", s->input);
+                return true;
+            }
+            // the bytes that are there are as good a model as any
+            s->input = realloc(s->input, s->n_input + a1 + 1);
+            for (uint32_t i = 0; i < a1; i++) {
+                value_t byte = read_byte(s, a0 + i);
+                s->input[s->n_input] = byte.t ? eval(byte.t, s->input) : byte.c;
+                write_byte(s, a0 + i, (value_t){ 0, term_new(T_INPUT, s->n_input, NULL, NULL) });
+                s->n_input++;
+            }
+            write_reg(s, REG_A0, (value_t){ 0, NULL });
+            return false;
+        default:
+            finish(s, "unknown syscall", s->input);
+            return true;
+    }
+}
+
+// Executes the next instruction of 's', pushing any path it forks onto the
+// worklist. Returns true if the path is done.
+static bool step(state_t* s) {
+    if (s->pc % 4 || !in_memory(s->pc, 4)) {
+        finish(s, "bad pc", s->input);
+        return true;
+    }
+    value_t fetched = load(s, s->pc, 4, false);
+    if (fetched.t) {
+        finish(s, "symbolic instruction", s->input);
+        return true;
+    }
+    uint32_t insn = fetched.c;
+    s->steps++;
+    N_STEPS++;
+
+    switch (insn) {
+        case INSN_ECALL:
+            if (ecall(s)) {
+                return true;
+            }
+            s->pc += 4;
+            return false;
+        case INSN_EBREAK:
+            finish(s, NULL, s->input);
+            return true;
+    }
+
+    uint32_t next = s->pc + 4;
+    value_t rs1 = s->regs[RS1(insn)];
+    value_t rs2 = s->regs[RS2(insn)];
+    switch (bits_get(insn, 6, 0)) {
+        case OP_RARITH: {
+            alu_op_t op = (FUNCT7(insn) << 3) | FUNCT3(insn);
+            if (!is_alu_op(op)) {
+                finish(s, "illegal instruction", s->input);
+                return true;
+            }
+            write_reg(s, RD(insn), alu(rs1, rs2, op));
+            break;
+        }
+        case OP_IARITH: {
+            alu_op_t op = iarith_op(insn);
+            if (!is_alu_op(op)) {
+                finish(s, "illegal instruction", s->input);
+                return true;
+            }
+            uint32_t imm = extract_imm(insn, IMM_I);
+            if (op == ALU_SLL || op == ALU_SRL || op == ALU_SRA) {
+                imm = SHAMT(insn);
+            }
+            write_reg(s, RD(insn), alu(rs1, (value_t){ imm, NULL }, op));
+            break;
+        }
+        case OP_BRANCH: {
+            if (FUNCT3(insn) == 0b010 || FUNCT3(insn) == 0b011) {
+                finish(s, "illegal instruction", s->input);
+                return true;
+            }
+            bool jump_if_zero;
+            value_t result = alu(rs1, rs2, branch_op(insn, &jump_if_zero));
+            uint32_t target = s->pc + extract_imm(insn, IMM_B);
+            bool nonzero = result.c != 0;
+            if (result.t) {
+                state_t* other = decide(s, result.t, &nonzero);
+                if (other) {
+                    other->pc = (nonzero == jump_if_zero) ? target : next;
+                    WORKLIST = realloc(WORKLIST, (N_WORKLIST + 1) * sizeof(WORKLIST[0]));
+                    WORKLIST[N_WORKLIST++] = other;
+                }
+            }
+            if (nonzero != jump_if_zero) {
+                next = target;
+            }
+            break;
+        }
+        case OP_LUI:
+            write_reg(s, RD(insn), (value_t){ extract_imm(insn, IMM_U), NULL });
+            break;
+        case OP_AUIPC:
+            write_reg(s, RD(insn), (value_t){ s->pc + extract_imm(insn, IMM_U), NULL });
+            break;
+        case OP_JAL:
+            write_reg(s, RD(insn), (value_t){ next, NULL });
+            next = s->pc + extract_imm(insn, IMM_J);
+            break;
+        case OP_JALR: {
+            uint32_t target = (concretize(s, rs1) + extract_imm(insn, IMM_I)) & ~1;
+            write_reg(s, RD(insn), (value_t){ next, NULL });
+            next = target;
+            break;
+        }
+        case OP_LOAD: {
+            static const int sizes[] = { 1, 2, 4, 0, 1, 2 };
+            uint32_t funct3 = FUNCT3(insn);
+            uint32_t addr = concretize(s, rs1) + extract_imm(insn, IMM_I);
+            if (funct3 > EXT_HALFU || !sizes[funct3]) {
+                finish(s, "illegal instruction", s->input);
+                return true;
+            }
+            if (!in_memory(addr, sizes[funct3])) {
+                finish(s, "bad load", s->input);
+                return true;
+            }
+            write_reg(s, RD(insn), load(s, addr, sizes[funct3], funct3 < EXT_BYTEU));
+            break;
+        }
+        case OP_STORE: {
+            uint32_t funct3 = FUNCT3(insn);
+            uint32_t addr = concretize(s, rs1) + extract_imm(insn, IMM_S);
+            if (funct3 > EXT_WORD) {
+                finish(s, "illegal instruction", s->input);
+                return true;
+            }
+            if (!in_memory(addr, 1 << funct3)) {
+                finish(s, "bad store", s->input);
+                return true;
+            }
+            store(s, addr, 1 << funct3, rs2);
+            break;
+        }
+        case OP_FENCE:
+            break;
+        default:
+            finish(s, "illegal instruction", s->input);
+            return true;
+    }
+    s->pc = next;
+    return false;
+}
+
+static void usage(const char* argv0) {
+    printf("usage: %s [-max-paths=N] [-max-steps=N] [-v] ELF\n", argv0);
+    printf("  -max-paths=N  stop after N paths (default: all)\n");
+    printf("  -max-steps=N  give up on a path after N instructions (default: %ld)\n", MAX_STEPS);
+    printf("  -v            print what the paths write\n");
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    char* file = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "-max-paths=", 11)) {
+            MAX_PATHS = atol(argv[i] + 11);
+        } else if (!strncmp(argv[i], "-max-steps=", 11)) {
+            MAX_STEPS = atol(argv[i] + 11);
+        } else if (!strcmp(argv[i], "-v")) {
+            VERBOSE = true;
+        } else if (argv[i][0] == '-' || file) {
+            usage(argv[0]);
+        } else {
+            file = argv[i];
+        }
+    }
+    if (!file) {
+        usage(argv[0]);
+    }
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        printf("symsim: file %s not found\n", file);
+        return 1;
+    }
+    struct stat st;
+    int status = fstat(fd, &st);
+    assert(status == 0);
+    char* fdata = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // load the image the way rvsim does, then run paths over it
+    machine_t m;
+    machine_new(&m, 0, 0x1000000);
+    machine_load(&m, fdata);
+    IMAGE = m.mem;
+    N_PAGES = IMAGE.size >> PAGE_BITS;
+
+    state_t* root = calloc(1, sizeof(*root));
+    root->pc = m.pc;
+    root->brk = m.brk;
+    for (int i = 0; i < 32; i++) {
+        root->regs[i] = (value_t){ m.regs[i], NULL };
+    }
+    root->pages = calloc(N_PAGES, sizeof(root->pages[0]));
+    root->input = malloc(1);
+    WORKLIST = malloc(sizeof(WORKLIST[0]));
+    WORKLIST[N_WORKLIST++] = root;
+
+    clock_t start = clock();
+    while (N_WORKLIST && (!MAX_PATHS || N_PATHS < MAX_PATHS)) {
+        state_t* s = WORKLIST[--N_WORKLIST];
+        while (!step(s)) {
+            if (s->steps >= MAX_STEPS) {
+                N_PATHS++;
+                printf("path %ld: gave up at pc %x after %ld instructions\n", N_PATHS, s->pc, s->steps);
+                break;
+            }
+        }
+        free_state(s);
+    }
+    double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("paths: %ld (%ld failing)%s\n", N_PATHS, N_FAILED, N_WORKLIST ? ", stopped early" : "");
+    printf("queries: %ld, terms: %d\n", N_QUERIES, N_TERMS);
+    printf("executed instructions: %ld (%.2f s)\n", N_STEPS, secs);
+
+    machine_free(&m);
+    munmap(fdata, st.st_size);
+    return N_FAILED != 0;
+}
@@ -0,0 +1,24 @@
+#include "symbolic.h"
+
+// Checks a packet: a 0x7e marker, a length, the payload, and a checksum byte
+// (the payload's sum) at the end. Exits with 1 for a well-formed "OK" packet,
+// which is the input symsim should come up with.
+int main() {
+    unsigned char pkt[8];
+    make_symbolic(pkt, sizeof(pkt));
+    if (pkt[0] != 0x7e) {
+        return 0;
+    }
+    unsigned len = pkt[1];
+    if (len > 5) {
+        return 0;
+    }
+    unsigned char sum = 0;
+    for (unsigned i = 0; i < len; i++) {
+        sum += pkt[2 + i];
+    }
+    if (len >= 2 && sum == pkt[7] && pkt[2] == 'O' && pkt[3] == 'K') {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Marks buf[0..size) as program input. Under symsim the bytes become
+// symbolic; under rvsim they keep whatever they hold.
+static inline void make_symbolic(void* buf, unsigned size) {
+    register long a0 asm("a0") = (long) buf;
+    register long a1 asm("a1") = size;
+    register long a7 asm("a7") = 1000;  // SYSCALL_SYMBOLIC
+    asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a7) : "memory");
+}